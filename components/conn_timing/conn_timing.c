@@ -0,0 +1,167 @@
+// components/conn_timing/conn_timing.c
+// Ring of recent connection attempts with a timestamp per phase. The newest
+// entry is the open attempt until it reaches CONN_TIMING_MQTT_SUBACK.
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "conn_timing.h"
+
+static const char *TAG = "CONN_TIMING";
+
+#define STEP_FROM_PREVIOUS CONN_TIMING_PHASE_MAX // collect(): measure from the phase reached before `to`
+
+static const char *const s_phase_names[CONN_TIMING_PHASE_MAX] = {
+    "WiFi start", "Scan", "Associated", "Got IP", "MQTT start", "TCP", "TLS", "CONNACK", "SUBACK",
+};
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static conn_timing_attempt_t s_ring[CONN_TIMING_HISTORY];
+static size_t s_head = 0;   // Slot of the next attempt
+static size_t s_count = 0;
+static bool s_open = false; // Newest attempt not complete yet
+
+static conn_timing_attempt_t *newest(void) {
+    return &s_ring[(s_head + CONN_TIMING_HISTORY - 1) % CONN_TIMING_HISTORY];
+}
+
+static void begin_locked(int64_t now) {
+    conn_timing_attempt_t *a = &s_ring[s_head];
+    memset(a, 0, sizeof(*a));
+    a->start_us = now;
+    s_head = (s_head + 1) % CONN_TIMING_HISTORY;
+    if (s_count < CONN_TIMING_HISTORY) {
+        s_count++;
+    }
+    s_open = true;
+}
+
+static void mark_locked(conn_timing_phase_t phase, int64_t now) {
+    if (!s_open) {
+        begin_locked(now);
+    }
+    conn_timing_attempt_t *a = newest();
+    if (CONN_TIMING_REACHED(a, phase)) {
+        // The step after this phase failed: forget the later phases of the failed try
+        a->retries++;
+        a->reached &= (uint16_t)((1u << phase) - 1);
+    }
+    int64_t elapsed_us = now - a->start_us;
+    a->at_us[phase] = elapsed_us > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed_us;
+    a->reached |= (uint16_t)(1u << phase);
+    if (phase == CONN_TIMING_MQTT_SUBACK) {
+        s_open = false;
+    }
+}
+
+void conn_timing_begin(void) {
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&s_lock);
+    begin_locked(now);
+    mark_locked(CONN_TIMING_WIFI_START, now);
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void conn_timing_mark(conn_timing_phase_t phase) {
+    if ((unsigned)phase >= CONN_TIMING_PHASE_MAX) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&s_lock);
+    mark_locked(phase, now);
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+size_t conn_timing_count(void) {
+    taskENTER_CRITICAL(&s_lock);
+    size_t count = s_count;
+    taskEXIT_CRITICAL(&s_lock);
+    return count;
+}
+
+esp_err_t conn_timing_get(size_t age, conn_timing_attempt_t *out) {
+    if (!out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    taskENTER_CRITICAL(&s_lock);
+    if (age < s_count) {
+        *out = s_ring[(s_head + CONN_TIMING_HISTORY - 1 - age) % CONN_TIMING_HISTORY];
+        ret = ESP_OK;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    return ret;
+}
+
+// Durations from `from` to `to` of the attempts that reached both, sorted ascending
+static size_t collect(conn_timing_phase_t from, conn_timing_phase_t to, uint32_t samples[CONN_TIMING_HISTORY]) {
+    conn_timing_attempt_t ring[CONN_TIMING_HISTORY];
+    taskENTER_CRITICAL(&s_lock);
+    size_t count = s_count;
+    for (size_t i = 0; i < count; i++) {
+        ring[i] = s_ring[(s_head + CONN_TIMING_HISTORY - 1 - i) % CONN_TIMING_HISTORY];
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        const conn_timing_attempt_t *a = &ring[i];
+        if (!CONN_TIMING_REACHED(a, to)) {
+            continue;
+        }
+        int start = (int)from;
+        if (from == STEP_FROM_PREVIOUS) {
+            for (start = (int)to - 1; start >= 0 && !CONN_TIMING_REACHED(a, start); start--) {
+            }
+        }
+        if (start < 0 || !CONN_TIMING_REACHED(a, start) || a->at_us[to] < a->at_us[start]) {
+            continue;
+        }
+        uint32_t d = a->at_us[to] - a->at_us[start];
+        size_t j = n++;
+        for (; j > 0 && samples[j - 1] > d; j--) { // Insertion sort, at most CONN_TIMING_HISTORY entries
+            samples[j] = samples[j - 1];
+        }
+        samples[j] = d;
+    }
+    return n;
+}
+
+static uint32_t nearest_rank(const uint32_t *sorted, size_t n, uint8_t percentile) {
+    size_t rank = ((size_t)percentile * n + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+esp_err_t conn_timing_percentile(conn_timing_phase_t from, conn_timing_phase_t to, uint8_t percentile,
+                                 uint32_t *out_us, size_t *samples) {
+    if (!out_us || (unsigned)from >= CONN_TIMING_PHASE_MAX || (unsigned)to >= CONN_TIMING_PHASE_MAX ||
+        from > to || percentile > 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t sorted[CONN_TIMING_HISTORY];
+    size_t n = collect(from, to, sorted);
+    if (samples) {
+        *samples = n;
+    }
+    if (n == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *out_us = nearest_rank(sorted, n, percentile);
+    return ESP_OK;
+}
+
+void conn_timing_log_summary(void) {
+    uint32_t sorted[CONN_TIMING_HISTORY];
+    for (int phase = CONN_TIMING_WIFI_START + 1; phase < CONN_TIMING_PHASE_MAX; phase++) {
+        size_t n = collect(STEP_FROM_PREVIOUS, (conn_timing_phase_t)phase, sorted);
+        if (n > 0) {
+            ESP_LOGI(TAG, "%-22s p50 %5u ms, p90 %5u ms (%u attempts)", s_phase_names[phase],
+                     (unsigned)(nearest_rank(sorted, n, 50) / 1000), (unsigned)(nearest_rank(sorted, n, 90) / 1000), (unsigned)n);
+        }
+    }
+    size_t n = collect(CONN_TIMING_WIFI_START, CONN_TIMING_MQTT_SUBACK, sorted);
+    if (n > 0) {
+        ESP_LOGI(TAG, "%-22s p50 %5u ms, p90 %5u ms (%u attempts)", "WiFi start to SUBACK",
+                 (unsigned)(nearest_rank(sorted, n, 50) / 1000), (unsigned)(nearest_rank(sorted, n, 90) / 1000), (unsigned)n);
+    }
+}
\ No newline at end of file
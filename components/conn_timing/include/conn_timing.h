@@ -0,0 +1,105 @@
+// components/conn_timing/include/conn_timing.h
+#ifndef CONN_TIMING_H
+#define CONN_TIMING_H
+
+#include <stdbool.h>
+#include <stddef.h> // For size_t
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * Timestamps of the phases of recent connection attempts, from WiFi start to
+ * the broker acknowledging our subscriptions, kept in a small RAM ring.
+ *
+ * An attempt starts with conn_timing_begin() (WiFi start or link loss) or with
+ * the first phase stamped after the previous attempt completed (e.g. an MQTT
+ * reconnect while WiFi stays up). Stamping a phase that the open attempt has
+ * already reached means the step before it failed and is being retried: the
+ * phase and all later ones are stamped again and `retries` counts up.
+ *
+ * For mqtts:// mqtt_comm runs the TLS transport itself and stamps the TCP
+ * connect (DNS included) and the TLS handshake separately. For plain mqtt://
+ * esp-mqtt does not report the steps, so DNS, TCP and CONNECT are one phase
+ * (CONN_TIMING_MQTT_START to CONN_TIMING_MQTT_CONNACK). DNS is skipped when
+ * mqtt_comm has a cached broker address.
+ *
+ * Safe to call from any task.
+ */
+
+#define CONN_TIMING_HISTORY 16 /*!< Attempts kept */
+
+/**
+ * @brief Connection phases, in the order they are normally reached.
+ */
+typedef enum {
+    CONN_TIMING_WIFI_START = 0, /*!< WiFi started or link lost; a connect (or scan) follows */
+    CONN_TIMING_WIFI_SCAN,      /*!< Scan for candidate APs done (skipped for a known AP) */
+    CONN_TIMING_WIFI_CONNECTED, /*!< Associated and authenticated (4-way handshake done) */
+    CONN_TIMING_GOT_IP,         /*!< DHCP lease or static address applied */
+    CONN_TIMING_MQTT_START,     /*!< esp-mqtt starts DNS lookup, TCP connect and TLS handshake */
+    CONN_TIMING_MQTT_TCP,       /*!< mqtts:// only: TCP connected (DNS included) */
+    CONN_TIMING_MQTT_TLS,       /*!< mqtts:// only: TLS handshake done */
+    CONN_TIMING_MQTT_CONNACK,   /*!< Broker accepted the connection (CONNECT round trip after TLS) */
+    CONN_TIMING_MQTT_SUBACK,    /*!< Subscriptions acknowledged (or held by the session); attempt complete */
+    CONN_TIMING_PHASE_MAX,
+} conn_timing_phase_t;
+
+/**
+ * @brief One connection attempt.
+ */
+typedef struct {
+    int64_t start_us;                        /*!< esp_timer time the attempt started */
+    uint32_t at_us[CONN_TIMING_PHASE_MAX];   /*!< Time of each reached phase, relative to start_us */
+    uint16_t reached;                        /*!< Bit (1 << phase) for each phase stamped */
+    uint16_t retries;                        /*!< Phases stamped again after a failure */
+} conn_timing_attempt_t;
+
+/** @brief True if the attempt reached the phase. */
+#define CONN_TIMING_REACHED(attempt, phase) (((attempt)->reached & (1u << (phase))) != 0)
+
+/**
+ * @brief Starts a new attempt at CONN_TIMING_WIFI_START. An open attempt is kept as it is (incomplete).
+ */
+void conn_timing_begin(void);
+
+/**
+ * @brief Stamps a phase of the open attempt with the current time.
+ *
+ * @param phase The phase reached.
+ */
+void conn_timing_mark(conn_timing_phase_t phase);
+
+/**
+ * @brief Number of attempts held (at most CONN_TIMING_HISTORY).
+ */
+size_t conn_timing_count(void);
+
+/**
+ * @brief Copies one attempt.
+ *
+ * @param age 0 for the newest (possibly still open) attempt, 1 for the one before, ...
+ * @param out Receives the attempt.
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG if out is NULL, ESP_ERR_NOT_FOUND if age >= conn_timing_count().
+ */
+esp_err_t conn_timing_get(size_t age, conn_timing_attempt_t *out);
+
+/**
+ * @brief Percentile of the time from one phase to another over the attempts that reached both.
+ *
+ * @param from Earlier phase.
+ * @param to Later phase.
+ * @param percentile 0..100 (nearest rank; 50 = median).
+ * @param out_us Receives the duration in microseconds.
+ * @param samples Optional, receives the number of attempts the percentile is taken over.
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG for bad arguments, ESP_ERR_NOT_FOUND if no attempt reached both phases.
+ */
+esp_err_t conn_timing_percentile(conn_timing_phase_t from, conn_timing_phase_t to, uint8_t percentile,
+                                 uint32_t *out_us, size_t *samples);
+
+/**
+ * @brief Logs median and 90th percentile of each phase (time since the phase reached before it)
+ *        and of the whole attempt, to see which step dominates.
+ */
+void conn_timing_log_summary(void);
+
+#endif // CONN_TIMING_H
\ No newline at end of file
@@ -0,0 +1,161 @@
+// components/dlog/dlog.c
+// Bounded multi-producer ring of fixed-size records (one sequence number per
+// slot): a writer claims a slot with one compare-and-swap on the head and
+// publishes it by advancing the slot's sequence, so tasks on both cores can
+// log without a lock. The single draining task frees slots the same way.
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "metrics.h"
+#include "dlog.h"
+
+static const char *TAG = "DLOG";
+
+typedef struct {
+    atomic_size_t seq; // == position: free for a writer; == position + 1: holds a record
+    dlog_record_t rec;
+} dlog_slot_t;
+
+static dlog_slot_t *s_slots = NULL;
+static size_t s_size = 0;  // Power of two
+static atomic_size_t s_head = 0;
+static size_t s_tail = 0;  // Draining task only
+static atomic_uint s_dropped = 0;
+static dlog_config_t s_config;
+static TaskHandle_t s_task_handle = NULL;
+
+void dlog_write(esp_log_level_t level, const char *tag, const char *fmt,
+                uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+    if (!s_slots) {
+        atomic_fetch_add_explicit(&s_dropped, 1, memory_order_relaxed);
+        return;
+    }
+    size_t pos = atomic_load_explicit(&s_head, memory_order_relaxed);
+    dlog_slot_t *slot;
+    while (1) {
+        slot = &s_slots[pos & (s_size - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            // Free: claim it (on failure pos is reloaded and we try the new head)
+            if (atomic_compare_exchange_weak_explicit(&s_head, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Still holds a record from the previous lap: ring full
+            atomic_fetch_add_explicit(&s_dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&s_head, memory_order_relaxed); // Claimed by another writer
+        }
+    }
+    slot->rec.time_us = esp_timer_get_time();
+    slot->rec.tag = tag;
+    slot->rec.fmt = fmt;
+    slot->rec.args[0] = a0;
+    slot->rec.args[1] = a1;
+    slot->rec.args[2] = a2;
+    slot->rec.args[3] = a3;
+    slot->rec.level = (uint8_t)level;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+size_t dlog_format(const dlog_record_t *rec, char *buf, size_t size) {
+    int n = snprintf(buf, size, rec->fmt, rec->args[0], rec->args[1], rec->args[2], rec->args[3]);
+    if (n < 0) {
+        buf[0] = '\0';
+        return 0;
+    }
+    return ((size_t)n < size) ? (size_t)n : size - 1;
+}
+
+void dlog_console_sink(const dlog_record_t *rec, void *ctx) {
+    static const char letters[] = "NEWIDV";
+    char msg[160];
+    dlog_format(rec, msg, sizeof(msg));
+    esp_log_level_t level = (esp_log_level_t)rec->level;
+    esp_log_write(level, rec->tag, "%c (%" PRIu32 ") %s: %s\n", letters[rec->level < 6 ? rec->level : 0],
+                  (uint32_t)(rec->time_us / 1000), rec->tag, msg);
+}
+
+uint32_t dlog_dropped(void) {
+    return atomic_load_explicit(&s_dropped, memory_order_relaxed);
+}
+
+static int32_t read_dropped(void *ctx) {
+    return (int32_t)dlog_dropped();
+}
+
+// Hands every published record to the sink, in order
+static void drain(void) {
+    while (1) {
+        dlog_slot_t *slot = &s_slots[s_tail & (s_size - 1)];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != s_tail + 1) {
+            return; // Empty, or the writer of this slot has not finished yet
+        }
+        dlog_record_t rec = slot->rec;
+        atomic_store_explicit(&slot->seq, s_tail + s_size, memory_order_release); // Free for the next lap
+        s_tail++;
+        s_config.sink(&rec, s_config.sink_ctx);
+    }
+}
+
+static void dlog_task(void *pvParameters) {
+    TickType_t interval = pdMS_TO_TICKS(s_config.flush_interval_ms);
+    while (1) {
+        vTaskDelay(interval > 0 ? interval : 1);
+        drain();
+    }
+}
+
+esp_err_t dlog_init(const dlog_config_t *config) {
+    if (!config) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_slots) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_config = *config;
+    if (!s_config.sink) {
+        s_config.sink = dlog_console_sink;
+    }
+    if (s_config.flush_interval_ms == 0) {
+        s_config.flush_interval_ms = 100;
+    }
+    if (s_config.task_priority == 0) {
+        s_config.task_priority = 1;
+    }
+    size_t size = 1;
+    while (size < (s_config.slots ? s_config.slots : 64)) {
+        size <<= 1;
+    }
+
+    dlog_slot_t *slots = calloc(size, sizeof(dlog_slot_t));
+    if (!slots) {
+        ESP_LOGE(TAG, "Failed to allocate %d log slots", (int)size);
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&slots[i].seq, i);
+    }
+    s_size = size;
+    s_tail = 0;
+    atomic_store_explicit(&s_head, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    s_slots = slots; // Writers start using the ring from here on
+    if (xTaskCreatePinnedToCore(dlog_task, "dlog", 4096, NULL, s_config.task_priority, &s_task_handle,
+                                s_config.task_core) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create dlog task");
+        s_slots = NULL; // Only called during startup, before any hot path runs
+        free(slots);
+        return ESP_FAIL;
+    }
+    metrics_gauge_fn("dlog.dropped", read_dropped, NULL);
+    ESP_LOGI(TAG, "Deferred log: %d slots, drained every %" PRIu32 " ms", (int)size, s_config.flush_interval_ms);
+    return ESP_OK;
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+// components/dlog/include/dlog.h
+#ifndef DLOG_H
+#define DLOG_H
+
+#include <stdint.h>
+#include <stddef.h> // For size_t
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "esp_log.h"
+
+/*
+ * Deferred binary logging for hot paths.
+ *
+ * DLOGI() and friends do not format anything: they store a timestamp, the
+ * format string pointer (which identifies the call site) and up to
+ * DLOG_MAX_ARGS raw 32-bit arguments in a lock-free ring. A low-priority task
+ * drains the ring and hands each record to a sink, which formats it to the
+ * console by default, or can ship it elsewhere (e.g. over MQTT).
+ *
+ * Arguments are captured by value as 32-bit words, so only integers and
+ * pointers to strings that outlive the record (string literals) may be
+ * passed; use ESP_LOGx for anything else. The format, the argument count and
+ * the argument types are checked at compile time, and calls above
+ * LOG_LOCAL_LEVEL are compiled out.
+ *
+ * When the ring is full the record is dropped and counted ("dlog.dropped"),
+ * the caller never waits.
+ */
+
+#define DLOG_MAX_ARGS 4
+
+/**
+ * @brief One captured log call.
+ */
+typedef struct {
+    int64_t time_us;              /*!< esp_timer time of the call */
+    const char *tag;
+    const char *fmt;              /*!< Format string, also identifies the call site */
+    uint32_t args[DLOG_MAX_ARGS]; /*!< Raw arguments, unused ones are 0 */
+    uint8_t level;                /*!< esp_log_level_t */
+} dlog_record_t;
+
+/**
+ * @brief Receives drained records, in the dlog task.
+ */
+typedef void (*dlog_sink_t)(const dlog_record_t *rec, void *ctx);
+
+/**
+ * @brief Configuration for the deferred logger.
+ */
+typedef struct {
+    size_t slots;                /*!< Ring capacity in records, rounded up to a power of two (0 = 64) */
+    UBaseType_t task_priority;   /*!< Priority of the draining task (0 = 1) */
+    BaseType_t task_core;        /*!< Core the task is pinned to (tskNO_AFFINITY for either) */
+    uint32_t flush_interval_ms;  /*!< How often the task drains the ring (0 = 100 ms) */
+    dlog_sink_t sink;            /*!< NULL: dlog_console_sink() */
+    void *sink_ctx;
+} dlog_config_t;
+
+/**
+ * @brief Allocates the ring and starts the draining task.
+ *        Records written before this are dropped.
+ */
+esp_err_t dlog_init(const dlog_config_t *config);
+
+/**
+ * @brief Stores a record. Use the DLOGx macros instead.
+ */
+void dlog_write(esp_log_level_t level, const char *tag, const char *fmt,
+                uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+
+/**
+ * @brief Formats a record's message (without level, time or tag).
+ *
+ * @return Length of the formatted message, truncated to size - 1.
+ */
+size_t dlog_format(const dlog_record_t *rec, char *buf, size_t size);
+
+/**
+ * @brief Default sink: prints the record through esp_log_write(), with the time it was captured.
+ */
+void dlog_console_sink(const dlog_record_t *rec, void *ctx);
+
+/**
+ * @brief Records dropped because the ring was full (or not yet allocated).
+ */
+uint32_t dlog_dropped(void);
+
+// Never called: lets the compiler check the format against the arguments
+static inline __attribute__((format(printf, 1, 2))) void dlog_check_format(const char *fmt, ...) {
+}
+
+#define DLOG_ARGS_(z, a, b, c, d, ...) \
+    (uint32_t)(uintptr_t)(a), (uint32_t)(uintptr_t)(b), (uint32_t)(uintptr_t)(c), (uint32_t)(uintptr_t)(d)
+
+// Number of arguments, up to 8
+#define DLOG_COUNT_(...) DLOG_COUNT_N_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define DLOG_COUNT_N_(z, a, b, c, d, e, f, g, h, n, ...) n
+
+// 1 if an argument survives the 32-bit capture: no floating point, nothing wider
+// than a pointer (32 bits on the target). `+ 0` decays arrays and promotes small integers.
+#define DLOG_ARG_OK_(x) _Generic((x) + 0, float: 0, double: 0, long double: 0, \
+                                 default: sizeof((x) + 0) <= sizeof(uintptr_t))
+#define DLOG_ARGS_OK_(z, a, b, c, d, ...) \
+    (DLOG_ARG_OK_(a) && DLOG_ARG_OK_(b) && DLOG_ARG_OK_(c) && DLOG_ARG_OK_(d))
+
+#define DLOG_LEVEL(level, tag, fmt, ...) do {                                                   \
+        if (LOG_LOCAL_LEVEL >= (level)) {                                                       \
+            _Static_assert(DLOG_COUNT_(__VA_ARGS__) <= DLOG_MAX_ARGS,                           \
+                           "DLOG: more than DLOG_MAX_ARGS arguments, use ESP_LOGx");             \
+            _Static_assert(DLOG_ARGS_OK_(0, ##__VA_ARGS__, 0, 0, 0, 0, 0),                      \
+                           "DLOG: floating-point or 64-bit argument, use ESP_LOGx");            \
+            if (0) {                                                                            \
+                dlog_check_format(fmt, ##__VA_ARGS__);                                          \
+            }                                                                                   \
+            dlog_write((level), (tag), (fmt), DLOG_ARGS_(0, ##__VA_ARGS__, 0, 0, 0, 0, 0));     \
+        }                                                                                       \
+    } while (0)
+
+#define DLOGE(tag, fmt, ...) DLOG_LEVEL(ESP_LOG_ERROR, tag, fmt, ##__VA_ARGS__)
+#define DLOGW(tag, fmt, ...) DLOG_LEVEL(ESP_LOG_WARN, tag, fmt, ##__VA_ARGS__)
+#define DLOGI(tag, fmt, ...) DLOG_LEVEL(ESP_LOG_INFO, tag, fmt, ##__VA_ARGS__)
+#define DLOGD(tag, fmt, ...) DLOG_LEVEL(ESP_LOG_DEBUG, tag, fmt, ##__VA_ARGS__)
+
+#endif // DLOG_H
\ No newline at end of file
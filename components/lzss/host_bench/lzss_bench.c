@@ -0,0 +1,166 @@
+// components/lzss/host_bench/lzss_bench.c
+// Compression ratio and throughput of the lzss codec on payloads shaped like
+// the bridge's uplink, plus a randomized round-trip check. Exits non-zero if
+// any stream fails to decode to its input.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lzss.h"
+
+#define MAX_PAYLOAD 4096
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} sink_buf_t;
+
+static bool sink_write(void *ctx, const uint8_t *data, size_t len) {
+    sink_buf_t *buf = (sink_buf_t *)ctx;
+    if (buf->len + len > buf->cap) {
+        return false;
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    return true;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Feeds `in` in chunks of `chunk` bytes, as mqtt_comm does with a payload
+static size_t compress(const uint8_t *in, size_t len, size_t chunk, uint8_t *out, size_t cap) {
+    static lzss_encoder_t enc;
+    sink_buf_t sink = { out, 0, cap };
+    lzss_encoder_init(&enc, sink_write, &sink);
+    for (size_t off = 0; off < len; off += chunk) {
+        size_t n = (len - off < chunk) ? len - off : chunk;
+        if (!lzss_encoder_feed(&enc, in + off, n)) {
+            return 0;
+        }
+    }
+    return lzss_encoder_finish(&enc) ? sink.len : 0;
+}
+
+static size_t decompress(const uint8_t *in, size_t len, size_t chunk, uint8_t *out, size_t cap) {
+    static lzss_decoder_t dec;
+    sink_buf_t sink = { out, 0, cap };
+    lzss_decoder_init(&dec, sink_write, &sink);
+    for (size_t off = 0; off < len; off += chunk) {
+        size_t n = (len - off < chunk) ? len - off : chunk;
+        if (!lzss_decoder_feed(&dec, in + off, n)) {
+            return 0;
+        }
+    }
+    return lzss_decoder_finish(&dec) ? sink.len : 0;
+}
+
+static bool round_trip(const uint8_t *in, size_t len, size_t chunk) {
+    static uint8_t packed[MAX_PAYLOAD * 2];
+    static uint8_t unpacked[MAX_PAYLOAD * 2];
+    size_t packed_len = compress(in, len, chunk, packed, sizeof(packed));
+    if (len > 0 && packed_len == 0) {
+        return false;
+    }
+    size_t unpacked_len = decompress(packed, packed_len, chunk, unpacked, sizeof(unpacked));
+    return unpacked_len == len && memcmp(in, unpacked, len) == 0;
+}
+
+// --- Sample payloads ---
+
+static size_t make_telemetry(uint8_t *buf, size_t target) {
+    size_t len = 0;
+    len += (size_t)snprintf((char *)buf, MAX_PAYLOAD, "{\"dev\":\"A4CF12B3C4D5\",\"readings\":[");
+    for (int i = 0; i == 0 || len + 96 < target; i++) {
+        len += (size_t)snprintf((char *)buf + len, MAX_PAYLOAD - len,
+                                "%s{\"t\":%d,\"temp\":%d.%d,\"hum\":%d,\"state\":\"ok\"}",
+                                i ? "," : "", 1700000000 + i * 5, 20 + rand() % 5, rand() % 10, 40 + rand() % 20);
+    }
+    len += (size_t)snprintf((char *)buf + len, MAX_PAYLOAD - len, "]}");
+    return len;
+}
+
+static size_t make_log_text(uint8_t *buf, size_t target) {
+    static const char *words[] = { "sensor", "value", "timeout", "retry", "link", "up", "down", "ok", "error", "frame" };
+    size_t len = 0;
+    while (len + 16 < target) {
+        len += (size_t)snprintf((char *)buf + len, MAX_PAYLOAD - len, "%s ", words[rand() % 10]);
+        if (rand() % 8 == 0) {
+            buf[len++] = '\n';
+        }
+    }
+    return len;
+}
+
+static size_t make_random(uint8_t *buf, size_t target) {
+    for (size_t i = 0; i < target; i++) {
+        buf[i] = (uint8_t)rand();
+    }
+    return target;
+}
+
+typedef struct {
+    const char *name;
+    size_t (*make)(uint8_t *buf, size_t target);
+} sample_t;
+
+int main(void) {
+    static const sample_t samples[] = {
+        { "JSON telemetry", make_telemetry },
+        { "text log", make_log_text },
+        { "random bytes", make_random },
+    };
+    static const size_t sizes[] = { 128, 512, 1024, 4000 };
+    static uint8_t in[MAX_PAYLOAD];
+    static uint8_t packed[MAX_PAYLOAD * 2];
+    static uint8_t unpacked[MAX_PAYLOAD * 2];
+    int failures = 0;
+    srand(1);
+
+    printf("%-16s %6s %7s %7s %10s %10s\n", "payload", "bytes", "packed", "ratio", "enc MB/s", "dec MB/s");
+    for (size_t s = 0; s < sizeof(samples) / sizeof(samples[0]); s++) {
+        for (size_t z = 0; z < sizeof(sizes) / sizeof(sizes[0]); z++) {
+            size_t len = samples[s].make(in, sizes[z]);
+            size_t packed_len = compress(in, len, len, packed, sizeof(packed));
+            if (!round_trip(in, len, len)) {
+                printf("%-16s %6zu  ROUND TRIP FAILED\n", samples[s].name, len);
+                failures++;
+                continue;
+            }
+            // Repeat until each measurement takes long enough to be stable
+            int iterations = (int)(4 * 1000 * 1000 / len);
+            double t0 = now_s();
+            for (int i = 0; i < iterations; i++) {
+                compress(in, len, len, packed, sizeof(packed));
+            }
+            double t1 = now_s();
+            for (int i = 0; i < iterations; i++) {
+                decompress(packed, packed_len, packed_len, unpacked, sizeof(unpacked));
+            }
+            double t2 = now_s();
+            double mb = (double)len * iterations / 1e6;
+            printf("%-16s %6zu %7zu %6.1f%% %10.1f %10.1f\n", samples[s].name, len, packed_len,
+                   100.0 * (double)packed_len / (double)len, mb / (t1 - t0), mb / (t2 - t1));
+        }
+    }
+
+    // Random lengths, contents and feed sizes, including empty and highly repetitive input
+    for (int i = 0; i < 20000; i++) {
+        size_t len = (size_t)(rand() % MAX_PAYLOAD);
+        int alphabet = 1 + rand() % 256;
+        for (size_t j = 0; j < len; j++) {
+            in[j] = (uint8_t)(rand() % alphabet);
+        }
+        size_t chunk = 1 + (size_t)(rand() % 300);
+        if (!round_trip(in, len, chunk)) {
+            printf("Round trip failed: %zu bytes, alphabet %d, chunks of %zu\n", len, alphabet, chunk);
+            failures++;
+        }
+    }
+    printf("Round trip: %d failures in 20000 random streams\n", failures);
+    return failures ? 1 : 0;
+}
\ No newline at end of file
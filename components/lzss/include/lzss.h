@@ -0,0 +1,111 @@
+// components/lzss/include/lzss.h
+#ifndef LZSS_H
+#define LZSS_H
+
+#include <stdbool.h>
+#include <stddef.h> // For size_t
+#include <stdint.h> // For uint8_t
+
+/*
+ * Small streaming LZSS codec for payload compression on constrained links.
+ *
+ * Stream format (same bit layout as heatshrink with window_sz2 = 8, lookahead_sz2 = 4):
+ *   - Bits are packed MSB first; the last byte is padded with zero bits.
+ *   - '1' + 8 bits               : literal byte.
+ *   - '0' + 8 bits + 4 bits      : back-reference; (distance - 1) then (length - 1).
+ *
+ * RAM use is fixed by the state structs below (no heap), independent of the
+ * amount of data streamed through them.
+ */
+
+#define LZSS_WINDOW_BITS    8
+#define LZSS_LOOKAHEAD_BITS 4
+#define LZSS_WINDOW_SIZE    (1 << LZSS_WINDOW_BITS)
+#define LZSS_LOOKAHEAD_SIZE (1 << LZSS_LOOKAHEAD_BITS)
+
+/**
+ * @brief Output sink used by the encoder and decoder.
+ *
+ * @param ctx User context given at init.
+ * @param data Produced bytes.
+ * @param len Number of produced bytes.
+ * @return true to continue, false to abort the stream (e.g. output full).
+ */
+typedef bool (*lzss_write_fn_t)(void *ctx, const uint8_t *data, size_t len);
+
+/**
+ * @brief Encoder state. Treat as opaque.
+ */
+typedef struct {
+    uint8_t buf[2 * LZSS_WINDOW_SIZE]; // History followed by not-yet-encoded input
+    uint16_t pos;                      // First not-yet-encoded byte in buf
+    uint16_t fill;                     // Bytes used in buf
+    uint8_t out[32];                   // Small output staging buffer
+    uint8_t out_len;
+    uint8_t bit_acc;
+    uint8_t bit_count;
+    bool failed;                       // Sink returned false
+    lzss_write_fn_t write;
+    void *ctx;
+} lzss_encoder_t;
+
+/**
+ * @brief Decoder state. Treat as opaque.
+ */
+typedef struct {
+    uint8_t window[LZSS_WINDOW_SIZE];
+    uint16_t head;
+    uint32_t bit_buf;
+    uint8_t bit_count;
+    uint8_t out[32];
+    uint8_t out_len;
+    bool failed;
+    lzss_write_fn_t write;
+    void *ctx;
+} lzss_decoder_t;
+
+/**
+ * @brief Prepares an encoder for a new stream.
+ *
+ * @param enc Encoder state.
+ * @param write Sink receiving the compressed bytes.
+ * @param ctx Passed through to write.
+ */
+void lzss_encoder_init(lzss_encoder_t *enc, lzss_write_fn_t write, void *ctx);
+
+/**
+ * @brief Feeds uncompressed input to the encoder.
+ *
+ * Can be called any number of times; output is produced as input arrives.
+ *
+ * @return false if the sink aborted the stream.
+ */
+bool lzss_encoder_feed(lzss_encoder_t *enc, const uint8_t *data, size_t len);
+
+/**
+ * @brief Encodes any remaining input and flushes the final partial byte.
+ *
+ * @return false if the sink aborted the stream.
+ */
+bool lzss_encoder_finish(lzss_encoder_t *enc);
+
+/**
+ * @brief Prepares a decoder for a new stream.
+ */
+void lzss_decoder_init(lzss_decoder_t *dec, lzss_write_fn_t write, void *ctx);
+
+/**
+ * @brief Feeds compressed input to the decoder.
+ *
+ * @return false if the sink aborted the stream.
+ */
+bool lzss_decoder_feed(lzss_decoder_t *dec, const uint8_t *data, size_t len);
+
+/**
+ * @brief Flushes decoded bytes still held in the decoder.
+ *
+ * @return false if the sink aborted the stream.
+ */
+bool lzss_decoder_finish(lzss_decoder_t *dec);
+
+#endif // LZSS_H
\ No newline at end of file
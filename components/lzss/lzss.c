@@ -0,0 +1,192 @@
+// components/lzss/lzss.c
+#include <string.h>
+#include "lzss.h" // Include own header
+
+// A back-reference costs 1 + 8 + 4 bits, a literal 9 bits: only matches of
+// two or more bytes save space.
+#define LZSS_MIN_MATCH 2
+
+// --- Bit output shared by encoder and decoder staging ---
+
+static void enc_flush_out(lzss_encoder_t *enc) {
+    if (enc->out_len > 0 && !enc->failed) {
+        if (!enc->write(enc->ctx, enc->out, enc->out_len)) {
+            enc->failed = true;
+        }
+    }
+    enc->out_len = 0;
+}
+
+static void enc_put_byte(lzss_encoder_t *enc, uint8_t byte) {
+    enc->out[enc->out_len++] = byte;
+    if (enc->out_len == sizeof(enc->out)) {
+        enc_flush_out(enc);
+    }
+}
+
+static void enc_put_bits(lzss_encoder_t *enc, uint32_t value, uint8_t count) {
+    while (count--) {
+        enc->bit_acc = (uint8_t)((enc->bit_acc << 1) | ((value >> count) & 1));
+        if (++enc->bit_count == 8) {
+            enc_put_byte(enc, enc->bit_acc);
+            enc->bit_acc = 0;
+            enc->bit_count = 0;
+        }
+    }
+}
+
+// --- Encoder ---
+
+void lzss_encoder_init(lzss_encoder_t *enc, lzss_write_fn_t write, void *ctx) {
+    memset(enc, 0, sizeof(*enc));
+    enc->write = write;
+    enc->ctx = ctx;
+}
+
+// Encodes buffered input, keeping a full lookahead unless finishing.
+static void enc_process(lzss_encoder_t *enc, bool finishing) {
+    while (!enc->failed && enc->pos < enc->fill) {
+        uint16_t avail = enc->fill - enc->pos;
+        if (!finishing && avail < LZSS_LOOKAHEAD_SIZE) {
+            break;
+        }
+        uint16_t max_len = avail < LZSS_LOOKAHEAD_SIZE ? avail : LZSS_LOOKAHEAD_SIZE;
+        uint16_t start = enc->pos > LZSS_WINDOW_SIZE ? enc->pos - LZSS_WINDOW_SIZE : 0;
+        const uint8_t *cur = &enc->buf[enc->pos];
+        uint16_t best_len = 0;
+        uint16_t best_dist = 0;
+
+        // Newest candidates first so equal-length matches get the shortest distance.
+        // Matches may run into the lookahead; the decoder copies byte by byte.
+        for (int cand = enc->pos - 1; cand >= start; cand--) {
+            const uint8_t *p = &enc->buf[cand];
+            if (p[0] != cur[0] || p[best_len] != cur[best_len]) {
+                continue;
+            }
+            uint16_t len = 1;
+            while (len < max_len && p[len] == cur[len]) {
+                len++;
+            }
+            if (len > best_len) {
+                best_len = len;
+                best_dist = (uint16_t)(enc->pos - cand);
+                if (len == max_len) {
+                    break;
+                }
+            }
+        }
+
+        if (best_len >= LZSS_MIN_MATCH) {
+            enc_put_bits(enc, 0, 1);
+            enc_put_bits(enc, best_dist - 1, LZSS_WINDOW_BITS);
+            enc_put_bits(enc, best_len - 1, LZSS_LOOKAHEAD_BITS);
+            enc->pos += best_len;
+        } else {
+            enc_put_bits(enc, 1, 1);
+            enc_put_bits(enc, *cur, 8);
+            enc->pos++;
+        }
+    }
+}
+
+// Drops history older than one window to make room for more input.
+static void enc_slide(lzss_encoder_t *enc) {
+    if (enc->pos <= LZSS_WINDOW_SIZE) {
+        return;
+    }
+    uint16_t shift = enc->pos - LZSS_WINDOW_SIZE;
+    memmove(enc->buf, enc->buf + shift, enc->fill - shift);
+    enc->pos -= shift;
+    enc->fill -= shift;
+}
+
+bool lzss_encoder_feed(lzss_encoder_t *enc, const uint8_t *data, size_t len) {
+    while (len > 0 && !enc->failed) {
+        enc_slide(enc);
+        size_t room = sizeof(enc->buf) - enc->fill;
+        size_t chunk = len < room ? len : room;
+        memcpy(enc->buf + enc->fill, data, chunk);
+        enc->fill += (uint16_t)chunk;
+        data += chunk;
+        len -= chunk;
+        enc_process(enc, false);
+    }
+    return !enc->failed;
+}
+
+bool lzss_encoder_finish(lzss_encoder_t *enc) {
+    enc_process(enc, true);
+    if (enc->bit_count > 0 && !enc->failed) {
+        enc_put_byte(enc, (uint8_t)(enc->bit_acc << (8 - enc->bit_count)));
+        enc->bit_acc = 0;
+        enc->bit_count = 0;
+    }
+    enc_flush_out(enc);
+    return !enc->failed;
+}
+
+// --- Decoder ---
+
+static void dec_flush_out(lzss_decoder_t *dec) {
+    if (dec->out_len > 0 && !dec->failed) {
+        if (!dec->write(dec->ctx, dec->out, dec->out_len)) {
+            dec->failed = true;
+        }
+    }
+    dec->out_len = 0;
+}
+
+static void dec_emit(lzss_decoder_t *dec, uint8_t byte) {
+    dec->window[dec->head++ & (LZSS_WINDOW_SIZE - 1)] = byte;
+    dec->out[dec->out_len++] = byte;
+    if (dec->out_len == sizeof(dec->out)) {
+        dec_flush_out(dec);
+    }
+}
+
+static uint32_t dec_take_bits(lzss_decoder_t *dec, uint8_t count) {
+    dec->bit_count -= count;
+    return (dec->bit_buf >> dec->bit_count) & ((1u << count) - 1);
+}
+
+void lzss_decoder_init(lzss_decoder_t *dec, lzss_write_fn_t write, void *ctx) {
+    memset(dec, 0, sizeof(*dec));
+    dec->write = write;
+    dec->ctx = ctx;
+}
+
+bool lzss_decoder_feed(lzss_decoder_t *dec, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len && !dec->failed; i++) {
+        dec->bit_buf = (dec->bit_buf << 8) | data[i];
+        dec->bit_count += 8;
+
+        // Decode every complete token; the zero padding of the final byte is
+        // always shorter than a token and is left unused.
+        while (dec->bit_count > 0 && !dec->failed) {
+            bool literal = (dec->bit_buf >> (dec->bit_count - 1)) & 1;
+            if (literal) {
+                if (dec->bit_count < 1 + 8) {
+                    break;
+                }
+                dec_take_bits(dec, 1);
+                dec_emit(dec, (uint8_t)dec_take_bits(dec, 8));
+            } else {
+                if (dec->bit_count < 1 + LZSS_WINDOW_BITS + LZSS_LOOKAHEAD_BITS) {
+                    break;
+                }
+                dec_take_bits(dec, 1);
+                uint16_t dist = (uint16_t)dec_take_bits(dec, LZSS_WINDOW_BITS) + 1;
+                uint16_t count = (uint16_t)dec_take_bits(dec, LZSS_LOOKAHEAD_BITS) + 1;
+                while (count--) {
+                    dec_emit(dec, dec->window[(uint16_t)(dec->head - dist) & (LZSS_WINDOW_SIZE - 1)]);
+                }
+            }
+        }
+    }
+    return !dec->failed;
+}
+
+bool lzss_decoder_finish(lzss_decoder_t *dec) {
+    dec_flush_out(dec);
+    return !dec->failed;
+}
\ No newline at end of file
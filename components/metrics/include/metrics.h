@@ -0,0 +1,97 @@
+// components/metrics/include/metrics.h
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stddef.h> // For size_t
+#include <stdint.h>
+
+/*
+ * Runtime metrics registry: counters, gauges and histograms that components
+ * register once and update from any task, serialized as compact JSON for the
+ * device stats topic.
+ *
+ * Counters and histograms keep one shard per core, so an update is a single
+ * relaxed atomic add on memory the other core does not write: no lock and no
+ * contention. Shards are summed when a snapshot is taken.
+ *
+ * Snapshots are delta encoded: only metrics whose value changed since the last
+ * serialized snapshot are included (with their current value, so a lost
+ * message only delays an update), plus every metric in a periodic full one.
+ * A snapshot larger than the caller's buffer is split into several messages;
+ * only the last part of a full snapshot is marked full.
+ *
+ * All update functions accept NULL (registry full) and then do nothing.
+ */
+
+#define METRICS_MAX 64            /*!< Metrics that can be registered */
+#define METRICS_HIST_BUCKETS 8    /*!< Histogram buckets, the last one without upper bound */
+
+typedef struct metric metric_t;
+
+/**
+ * @brief Reads a gauge when a snapshot is taken (see metrics_gauge_fn()).
+ */
+typedef int32_t (*metrics_read_fn_t)(void *ctx);
+
+/**
+ * @brief Registers a counter, or returns the one already registered under this name.
+ *
+ * @param name Static string, e.g. "uart.rx_bytes".
+ * @return The counter, or NULL if the registry is full.
+ */
+metric_t *metrics_counter(const char *name);
+
+/**
+ * @brief Registers a gauge set with metrics_set().
+ */
+metric_t *metrics_gauge(const char *name);
+
+/**
+ * @brief Registers a gauge whose value is read by `fn` at snapshot time.
+ *        `fn` runs in the task that serializes and must not block.
+ */
+metric_t *metrics_gauge_fn(const char *name, metrics_read_fn_t fn, void *ctx);
+
+/**
+ * @brief Registers a histogram.
+ *
+ * @param name Static string.
+ * @param bounds Static array of ascending upper bounds (inclusive), one per bucket but the last.
+ * @param count Entries in bounds (at most METRICS_HIST_BUCKETS - 1).
+ */
+metric_t *metrics_histogram(const char *name, const uint32_t *bounds, size_t count);
+
+/** @brief Adds to a counter. */
+void metrics_add(metric_t *m, uint32_t n);
+
+/** @brief Adds 1 to a counter. */
+static inline void metrics_inc(metric_t *m) {
+    metrics_add(m, 1);
+}
+
+/** @brief Sets a gauge. */
+void metrics_set(metric_t *m, int32_t value);
+
+/** @brief Counts a value into its histogram bucket. */
+void metrics_observe(metric_t *m, uint32_t value);
+
+/**
+ * @brief Serializes the changed (or, with `full`, all) metrics.
+ *
+ * Format: {"seq":N,"up":<uptime s>,"full":0|1,"m":{"name":value,"hist":[b0,...],...}}
+ * If not all metrics fit in `size`, `*more` is set: send this part and call
+ * again with `full` false for the next one. A full snapshot carries "full":1
+ * in its last part only, so a consumer knows when it has seen every metric.
+ *
+ * Call from one task only.
+ *
+ * @param buf Output buffer.
+ * @param size Size of buf.
+ * @param full Start a full snapshot (include unchanged metrics too).
+ * @param more Set to true if another part follows.
+ * @return Length written (without NUL), or 0 if nothing changed.
+ */
+size_t metrics_serialize(char *buf, size_t size, bool full, bool *more);
+
+#endif // METRICS_H
\ No newline at end of file
@@ -0,0 +1,186 @@
+// components/metrics/metrics.c
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "metrics.h"
+
+typedef enum {
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM,
+} metric_type_t;
+
+struct metric {
+    const char *name;
+    metric_type_t type;
+    uint8_t values;                  // Serialized values: 1, or the bucket count of a histogram
+    const uint32_t *bounds;
+    metrics_read_fn_t read_fn;
+    void *read_ctx;
+    atomic_int gauge;
+    atomic_uint shard[portNUM_PROCESSORS][METRICS_HIST_BUCKETS]; // Counter: [core][0]
+    uint32_t sent[METRICS_HIST_BUCKETS]; // Values in the last snapshot, serializing task only
+    bool ever_sent;
+};
+
+static metric_t s_metrics[METRICS_MAX];
+static atomic_size_t s_count = 0;
+static portMUX_TYPE s_register_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_seq = 0;
+static size_t s_full_next = 0; // Metric a full snapshot continues from (0 = none in progress)
+
+static metric_t *register_metric(const char *name, metric_type_t type, const uint32_t *bounds, size_t bound_count,
+                                 metrics_read_fn_t fn, void *ctx) {
+    if (!name || bound_count >= METRICS_HIST_BUCKETS) {
+        return NULL;
+    }
+    metric_t *m = NULL;
+    taskENTER_CRITICAL(&s_register_lock);
+    size_t count = atomic_load_explicit(&s_count, memory_order_relaxed);
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(s_metrics[i].name, name) == 0) {
+            m = &s_metrics[i]; // Registered before, e.g. by an earlier init of the component
+            break;
+        }
+    }
+    if (!m && count < METRICS_MAX) {
+        m = &s_metrics[count];
+        m->name = name;
+        m->type = type;
+        m->bounds = bounds;
+        m->values = (type == METRIC_HISTOGRAM) ? (uint8_t)(bound_count + 1) : 1;
+        m->read_fn = fn;
+        m->read_ctx = ctx;
+        atomic_store_explicit(&s_count, count + 1, memory_order_release);
+    }
+    taskEXIT_CRITICAL(&s_register_lock);
+    return (m && m->type == type) ? m : NULL;
+}
+
+metric_t *metrics_counter(const char *name) {
+    return register_metric(name, METRIC_COUNTER, NULL, 0, NULL, NULL);
+}
+
+metric_t *metrics_gauge(const char *name) {
+    return register_metric(name, METRIC_GAUGE, NULL, 0, NULL, NULL);
+}
+
+metric_t *metrics_gauge_fn(const char *name, metrics_read_fn_t fn, void *ctx) {
+    return register_metric(name, METRIC_GAUGE, NULL, 0, fn, ctx);
+}
+
+metric_t *metrics_histogram(const char *name, const uint32_t *bounds, size_t count) {
+    return bounds ? register_metric(name, METRIC_HISTOGRAM, bounds, count, NULL, NULL) : NULL;
+}
+
+void metrics_add(metric_t *m, uint32_t n) {
+    if (m) {
+        // Only tasks on this core touch this shard; atomic because they can preempt each other
+        atomic_fetch_add_explicit(&m->shard[xPortGetCoreID()][0], n, memory_order_relaxed);
+    }
+}
+
+void metrics_set(metric_t *m, int32_t value) {
+    if (m) {
+        atomic_store_explicit(&m->gauge, value, memory_order_relaxed);
+    }
+}
+
+void metrics_observe(metric_t *m, uint32_t value) {
+    if (!m) {
+        return;
+    }
+    uint8_t bucket = 0;
+    while (bucket < m->values - 1 && value > m->bounds[bucket]) {
+        bucket++;
+    }
+    atomic_fetch_add_explicit(&m->shard[xPortGetCoreID()][bucket], 1, memory_order_relaxed);
+}
+
+// Current values of a metric, shards summed
+static void read_metric(metric_t *m, uint32_t out[METRICS_HIST_BUCKETS]) {
+    if (m->type == METRIC_GAUGE) {
+        out[0] = (uint32_t)(m->read_fn ? m->read_fn(m->read_ctx) : atomic_load_explicit(&m->gauge, memory_order_relaxed));
+        return;
+    }
+    for (uint8_t v = 0; v < m->values; v++) {
+        out[v] = 0;
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            out[v] += atomic_load_explicit(&m->shard[core][v], memory_order_relaxed);
+        }
+    }
+}
+
+static size_t format_values(const metric_t *m, const uint32_t *values, char *buf, size_t size) {
+    int n;
+    if (m->type == METRIC_GAUGE) {
+        n = snprintf(buf, size, "\"%s\":%ld", m->name, (long)(int32_t)values[0]);
+    } else if (m->type == METRIC_COUNTER) {
+        n = snprintf(buf, size, "\"%s\":%lu", m->name, (unsigned long)values[0]);
+    } else {
+        n = snprintf(buf, size, "\"%s\":[", m->name);
+        for (uint8_t v = 0; v < m->values && n > 0 && (size_t)n < size; v++) {
+            n += snprintf(buf + n, size - (size_t)n, v ? ",%lu" : "%lu", (unsigned long)values[v]);
+        }
+        if (n > 0 && (size_t)n < size) {
+            n += snprintf(buf + n, size - (size_t)n, "]");
+        }
+    }
+    return (n > 0 && (size_t)n < size) ? (size_t)n : 0; // 0: did not fit
+}
+
+size_t metrics_serialize(char *buf, size_t size, bool full, bool *more) {
+    *more = false;
+    size_t count = atomic_load_explicit(&s_count, memory_order_acquire);
+    size_t first = full ? 0 : s_full_next;
+    full = full || s_full_next > 0; // Continues a full snapshot split by the previous call
+    // "full" is patched in once the part is known to be the last one
+    int n = snprintf(buf, size, "{\"seq\":%lu,\"up\":%lu,\"full\":0,\"m\":{", (unsigned long)s_seq,
+                     (unsigned long)(esp_timer_get_time() / 1000000));
+    if (n <= 0 || (size_t)n + 3 > size) {
+        return 0;
+    }
+    size_t len = (size_t)n;
+    size_t written = 0;
+    s_full_next = 0;
+    for (size_t i = first; i < count; i++) {
+        metric_t *m = &s_metrics[i];
+        uint32_t values[METRICS_HIST_BUCKETS];
+        read_metric(m, values);
+        if (!full && m->ever_sent && memcmp(values, m->sent, m->values * sizeof(uint32_t)) == 0) {
+            continue; // Unchanged
+        }
+        size_t sep = (written > 0) ? 1 : 0; // ','
+        size_t room = size - len - 3;       // Keep space for "}}" and the NUL
+        size_t entry = (room > sep) ? format_values(m, values, buf + len + sep, room - sep + 1) : 0;
+        if (entry == 0) {
+            if (written == 0) {
+                continue; // Too large for any part: skipped rather than retried forever
+            }
+            // Changed metrics are still changed on the next call; a full snapshot resumes here
+            s_full_next = full ? i : 0;
+            *more = true;
+            break;
+        }
+        if (sep) {
+            buf[len] = ',';
+        }
+        len += sep + entry;
+        written++;
+        memcpy(m->sent, values, m->values * sizeof(uint32_t));
+        m->ever_sent = true;
+    }
+    if (written == 0 && !full) {
+        return 0;
+    }
+    if (full && !*more) {
+        char *flag = strstr(buf, "\"full\":0");
+        flag[sizeof("\"full\":") - 1] = '1';
+    }
+    len += (size_t)snprintf(buf + len, size - len, "}}");
+    s_seq++;
+    return len;
+}
\ No newline at end of file
@@ -0,0 +1,167 @@
+// components/mqtt_comm/host_sim/reconnect_storm.c
+// Reconnect storm: a fleet loses the broker at the same moment, the broker is
+// down for a while and then accepts a limited number of connects per second.
+// Compares esp-mqtt's fixed reconnect interval, exponential backoff without
+// jitter and the full-jitter backoff of mqtt_comm_backoff.h (the firmware code).
+// Exits non-zero if the full-jitter run does not reconnect every device or
+// hits the recovering broker harder than lockstep reconnects.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "mqtt_comm_backoff.h"
+
+#define BASE_MS 1000      // APP_MQTT_RECONNECT_BASE_MS
+#define MAX_MS 60000      // APP_MQTT_RECONNECT_MAX_MS
+#define FIXED_MS 10000    // esp-mqtt's default reconnect_timeout_ms
+#define HORIZON_MS (30 * 60 * 1000)
+
+typedef enum {
+    STRATEGY_FIXED,
+    STRATEGY_EXPONENTIAL,
+    STRATEGY_FULL_JITTER,
+} strategy_t;
+
+static const char *const s_strategy_names[] = { "fixed 10 s", "exponential", "full jitter" };
+
+typedef struct {
+    uint32_t next_ms;  // Time of the next attempt
+    uint32_t attempt;  // Consecutive failures
+    bool connected;
+} device_t;
+
+typedef struct {
+    uint32_t attempts;
+    uint32_t rejected;
+    uint32_t peak_per_s;     // Most attempts within one second
+    uint32_t peak_up_per_s;  // Same, once the broker is back: the load it has to absorb
+    uint32_t p99_ms;         // Time until 99% of the fleet is connected
+    uint32_t all_ms;         // Time until every device is connected (0 = never)
+} result_t;
+
+static uint32_t s_rng = 2463534242u;
+
+static uint32_t xorshift32(void) {
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static uint32_t next_delay(strategy_t strategy, uint32_t attempt) {
+    switch (strategy) {
+        case STRATEGY_FIXED:
+            return FIXED_MS;
+        case STRATEGY_EXPONENTIAL:
+            return mqtt_comm_backoff_window_ms(BASE_MS, MAX_MS, attempt);
+        case STRATEGY_FULL_JITTER:
+        default:
+            return mqtt_comm_backoff_delay_ms(BASE_MS, MAX_MS, attempt, xorshift32());
+    }
+}
+
+static result_t simulate(strategy_t strategy, uint32_t devices, uint32_t outage_ms, uint32_t accepts_per_s) {
+    result_t res = { 0 };
+    device_t *fleet = calloc(devices, sizeof(device_t));
+    if (!fleet) {
+        fprintf(stderr, "out of memory\n");
+        exit(2);
+    }
+    // Everyone sees the disconnect at t = 0 and schedules its first attempt
+    for (uint32_t i = 0; i < devices; i++) {
+        fleet[i].next_ms = next_delay(strategy, fleet[i].attempt++);
+    }
+
+    uint32_t connected = 0;
+    uint32_t second_attempts = 0;
+    uint32_t second_accepts = 0;
+    for (uint32_t now = 0; now < HORIZON_MS && connected < devices; now++) {
+        if (now % 1000 == 0) {
+            if (second_attempts > res.peak_per_s) res.peak_per_s = second_attempts;
+            if (now > outage_ms && second_attempts > res.peak_up_per_s) res.peak_up_per_s = second_attempts;
+            second_attempts = 0;
+            second_accepts = 0;
+        }
+        for (uint32_t i = 0; i < devices; i++) {
+            device_t *dev = &fleet[i];
+            if (dev->connected || dev->next_ms != now) {
+                continue;
+            }
+            res.attempts++;
+            second_attempts++;
+            if (now >= outage_ms && second_accepts < accepts_per_s) {
+                second_accepts++;
+                dev->connected = true;
+                connected++;
+                if (connected * 100 >= devices * 99 && res.p99_ms == 0) res.p99_ms = now;
+                if (connected == devices) res.all_ms = now;
+            } else {
+                res.rejected++;
+                uint32_t delay = next_delay(strategy, dev->attempt++);
+                dev->next_ms = now + (delay > 0 ? delay : 1); // The firmware timer fires no earlier than the next tick either
+            }
+        }
+    }
+    if (second_attempts > res.peak_per_s) res.peak_per_s = second_attempts;
+    if (second_attempts > res.peak_up_per_s) res.peak_up_per_s = second_attempts;
+    free(fleet);
+    return res;
+}
+
+// The delay never leaves [0, window] and the window saturates at MAX_MS
+static bool check_bounds(void) {
+    for (uint32_t attempt = 0; attempt < 64; attempt++) {
+        uint32_t window = mqtt_comm_backoff_window_ms(BASE_MS, MAX_MS, attempt);
+        if (window > MAX_MS || (attempt < 6 && window != (uint32_t)BASE_MS << attempt)) {
+            fprintf(stderr, "bad window %u for attempt %u\n", window, attempt);
+            return false;
+        }
+        for (int i = 0; i < 1000; i++) {
+            if (mqtt_comm_backoff_delay_ms(BASE_MS, MAX_MS, attempt, xorshift32()) > window) {
+                fprintf(stderr, "delay above window for attempt %u\n", attempt);
+                return false;
+            }
+        }
+    }
+    return mqtt_comm_backoff_delay_ms(BASE_MS, MAX_MS, 3, UINT32_MAX) <= 8000;
+}
+
+int main(int argc, char **argv) {
+    uint32_t devices = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 1000;
+    uint32_t outage_s = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 30;
+    uint32_t accepts_per_s = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : 50;
+    if (devices == 0 || accepts_per_s == 0) {
+        fprintf(stderr, "usage: %s [devices>0] [outage_s] [accepts_per_s>0]\n", argv[0]);
+        return 2;
+    }
+
+    bool ok = check_bounds();
+    printf("%u devices, broker down %u s, then accepts %u connects/s (backoff %u..%u ms)\n\n",
+           devices, outage_s, accepts_per_s, BASE_MS, MAX_MS);
+    printf("%-12s %10s %10s %8s %10s %12s %12s\n", "strategy", "attempts", "rejected", "peak/s", "peak up/s",
+           "99% up (s)", "all up (s)");
+    result_t results[3];
+    for (int s = STRATEGY_FIXED; s <= STRATEGY_FULL_JITTER; s++) {
+        results[s] = simulate((strategy_t)s, devices, outage_s * 1000, accepts_per_s);
+        const result_t *r = &results[s];
+        printf("%-12s %10u %10u %8u %10u %12.1f ", s_strategy_names[s], r->attempts, r->rejected, r->peak_per_s,
+               r->peak_up_per_s, r->p99_ms / 1000.0);
+        if (r->all_ms) {
+            printf("%12.1f\n", r->all_ms / 1000.0);
+        } else {
+            printf("%12s\n", "never");
+        }
+    }
+
+    const result_t *jitter = &results[STRATEGY_FULL_JITTER];
+    if (jitter->all_ms == 0) {
+        fprintf(stderr, "full jitter did not reconnect every device\n");
+        ok = false;
+    }
+    if (jitter->peak_up_per_s > results[STRATEGY_FIXED].peak_up_per_s ||
+        jitter->peak_up_per_s > results[STRATEGY_EXPONENTIAL].peak_up_per_s) {
+        fprintf(stderr, "full jitter hits the recovered broker harder than lockstep reconnects\n");
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -3,16 +3,175 @@
 #define MQTT_COMM_H
 
 #include "esp_err.h"
+#include <stdbool.h>
 #include <stddef.h> // For size_t
+#include <stdint.h>
+
+#define MQTT_COMM_TOPIC_MAX_LEN 128     /*!< Longest topic (incl. terminator) handled by the internal stages */
+#define MQTT_COMM_BATCH_MAX_TOPICS 8    /*!< Topics that can have an open batch / a per-topic window at once */
+#define MQTT_COMM_TOPIC_ALIAS_SLOTS 16  /*!< Upper bound for mqtt_comm_config_t.topic_alias_max */
+#define MQTT_COMM_LATENCY_BUCKETS 16    /*!< Buckets of the PUBACK latency histogram */
+#define MQTT_COMM_ROUTE_MAX 32          /*!< Subscription routes that can be registered */
+#define MQTT_COMM_ROUTE_MAX_NODES 128   /*!< Topic levels (trie nodes) shared by all route filters */
+#define MQTT_COMM_DEDUP_TOPICS 32       /*!< Topics whose last payload hash is remembered for deduplication */
+#define MQTT_COMM_RATE_TOPICS 16        /*!< Topics with their own rate-limit bucket (least recently used ones are recycled) */
+
+/**
+ * @brief Flags for mqtt_comm_publish_ex().
+ */
+#define MQTT_COMM_PUB_FLAG_NONE     0x00
+#define MQTT_COMM_PUB_FLAG_NO_BATCH 0x01 /*!< Publish immediately, never coalesce */
+#define MQTT_COMM_PUB_FLAG_NO_COMPRESS 0x02 /*!< Never compress this payload */
+#define MQTT_COMM_PUB_FLAG_NO_RATE_LIMIT 0x04 /*!< Bypass the rate limiter (and do not consume its tokens) */
+#define MQTT_COMM_PUB_FLAG_NO_DEDUP 0x08 /*!< Publish even if the payload repeats the last one on the topic */
+
+/**
+ * @brief Payload layout used when several messages are coalesced into one publish.
+ */
+typedef enum {
+    MQTT_COMM_BATCH_FORMAT_NDJSON,     /*!< Payloads joined with '\n' */
+    MQTT_COMM_BATCH_FORMAT_JSON_ARRAY, /*!< Payloads wrapped as "[p1,p2,...]" (each payload must be a JSON value) */
+} mqtt_comm_batch_format_t;
+
+/**
+ * @brief Coalescing window for a topic.
+ *
+ * Messages are gathered until either the window expires or the next
+ * message would make the payload exceed max_bytes, then sent as one PUBLISH.
+ * Only QoS 0, non-retained messages are coalesced: a QoS 1 message needs its
+ * own PUBACK, so it is always sent on its own. The bridge's UART uplink
+ * publishes at QoS 1 and is therefore never batched.
+ */
+typedef struct {
+    uint32_t window_ms;               /*!< Max time the first message of a batch may wait (0 disables coalescing) */
+    size_t max_bytes;                 /*!< Max size of the coalesced payload */
+    mqtt_comm_batch_format_t format;  /*!< How messages are joined */
+} mqtt_comm_batch_config_t;
+
+/**
+ * @brief What happens to a message that exceeds its rate limit.
+ */
+typedef enum {
+    MQTT_COMM_RATE_POLICY_DROP = 0, /*!< The message is dropped (publish returns ESP_ERR_NOT_ALLOWED) */
+    MQTT_COMM_RATE_POLICY_DELAY,    /*!< The publishing task waits for a token, up to max_delay_ms, then drops */
+    MQTT_COMM_RATE_POLICY_COALESCE, /*!< QoS 0: only the newest message per topic is kept and sent when a token is
+                                         available (and the client is connected). QoS 1 is handled as DELAY */
+} mqtt_comm_rate_policy_t;
+
+/**
+ * @brief Token-bucket rate limits, applied before all other publish stages.
+ *
+ * Every message takes one token from its topic's bucket and one from the
+ * global bucket. A bucket holds up to `burst` tokens and gains `rate` tokens
+ * per second. A rate of 0 disables that bucket.
+ */
+typedef struct {
+    uint32_t topic_rate;      /*!< Messages per second per topic (0 = no per-topic limit) */
+    uint32_t topic_burst;     /*!< Per-topic bucket size (0 for topic_rate) */
+    uint32_t global_rate;     /*!< Messages per second over all topics (0 = no global limit) */
+    uint32_t global_burst;    /*!< Global bucket size (0 for global_rate) */
+    mqtt_comm_rate_policy_t policy; /*!< Handling of messages over the limit */
+    uint32_t max_delay_ms;    /*!< DELAY, and QoS 1 under COALESCE: longest wait before the message is dropped */
+} mqtt_comm_rate_limit_config_t;
+
+/**
+ * @brief How messages larger than the client's input buffer are delivered.
+ */
+typedef enum {
+    MQTT_COMM_RX_MODE_REASSEMBLE = 0, /*!< Fragments are collected and delivered as one message (up to rx_max_len) */
+    MQTT_COMM_RX_MODE_STREAM,         /*!< Each fragment is delivered as it arrives, see mqtt_comm_message_t.offset */
+} mqtt_comm_rx_mode_t;
+
+/**
+ * @brief An incoming MQTT message, as passed to route handlers.
+ *
+ * In MQTT_COMM_RX_MODE_STREAM a large message is delivered in several calls,
+ * each carrying the topic and the next part of the payload; the message is
+ * complete when offset + data_len == total_len.
+ */
+typedef struct {
+    const char *topic;   /*!< Topic (not null-terminated) */
+    size_t topic_len;    /*!< Length of the topic */
+    const char *data;    /*!< Payload, or the current fragment of it (not null-terminated) */
+    size_t data_len;     /*!< Length of data */
+    size_t offset;       /*!< Position of data within the whole payload (0 unless streaming a fragment) */
+    size_t total_len;    /*!< Length of the whole payload */
+    int qos;             /*!< QoS the message was delivered with */
+    bool retain;         /*!< Retained message */
+} mqtt_comm_message_t;
+
+/**
+ * @brief Handler for messages matching a route. Runs in the MQTT client task.
+ *
+ * @param msg The received message; only valid during the call.
+ * @param ctx User context registered with the route.
+ */
+typedef void (*mqtt_comm_route_handler_t)(const mqtt_comm_message_t *msg, void *ctx);
+
+/**
+ * @brief A subscription and the handler its messages are routed to.
+ *
+ * The filter may use the '+' (single level) and '#' (remaining levels) wildcards.
+ * A message matching several routes is passed to each of them.
+ */
+typedef struct {
+    const char *filter;                 /*!< Topic filter (copied at init) */
+    int qos;                            /*!< Maximum QoS requested for the subscription */
+    mqtt_comm_route_handler_t handler;  /*!< Called for each matching message */
+    void *ctx;                          /*!< Passed to handler */
+} mqtt_comm_route_t;
+
+/**
+ * @brief MQTT protocol version used to talk to the broker.
+ */
+typedef enum {
+    MQTT_COMM_PROTOCOL_V3_1_1 = 0, /*!< MQTT 3.1.1 (default) */
+    MQTT_COMM_PROTOCOL_V5,         /*!< MQTT 5.0, requires CONFIG_MQTT_PROTOCOL_5 */
+} mqtt_comm_protocol_t;
 
 /**
  * @brief MQTT communication configuration structure.
  */
 typedef struct {
     const char *broker_uri;     /*!< Full MQTT broker URI (e.g., "mqtt://host.com:1883") */
-    const char *client_id;      /*!< MQTT client ID (NULL for default based on MAC) */
+    const char *client_id;      /*!< MQTT client ID (NULL for default based on MAC, kept in NVS with persistent_session) */
     const char *username;       /*!< MQTT username (NULL if no authentication) */
     const char *password;       /*!< MQTT password (NULL if no authentication) */
+    const char *ca_cert_pem;    /*!< mqtts://: pinned CA or server certificate (PEM, null-terminated). Only this
+                                     certificate is trusted, so the handshake does not search a certificate bundle. */
+    bool use_crt_bundle;        /*!< mqtts:// without ca_cert_pem: verify against the ESP x509 certificate bundle */
+    const char *tls_common_name; /*!< Name the server certificate must match, if not the URI host (NULL = URI host) */
+    bool broker_discovery;      /*!< Opt-in: if DNS cannot resolve the URI host, resolve it via mDNS (_mqtt._tcp, or _secure-mqtt._tcp
+                                     for mqtts://). Only an answer from that same host (or host.local) is accepted */
+    uint32_t broker_cache_ttl_s; /*!< Resolve the broker in the background and connect to the cached IP (RAM and NVS),
+                                      refreshed after this time (0 = off, or 3600 with broker_discovery; at most one day) */
+    bool dedup;                 /*!< Suppress a publish whose payload equals the last one sent on its topic */
+    uint32_t dedup_max_quiet_ms; /*!< Dedup: repeat an unchanged payload after this long anyway (0 = never) */
+    mqtt_comm_rate_limit_config_t rate_limit; /*!< Publish rate limits (all rates 0 = off) */
+    mqtt_comm_batch_config_t batch; /*!< Default coalescing window for all topics (window_ms = 0: off unless set per topic) */
+    size_t compress_min_len;    /*!< LZSS-compress payloads of at least this many bytes (0 = compression off) */
+    const char *compress_topic_suffix; /*!< Appended to the topic of compressed messages (NULL for "/lz") */
+    mqtt_comm_protocol_t protocol; /*!< Protocol version */
+    uint16_t topic_alias_max;   /*!< MQTT 5: topic aliases assigned to recently used topics (0 = off, max MQTT_COMM_TOPIC_ALIAS_SLOTS).
+                                     Should not exceed the broker's Topic Alias Maximum; it is lowered automatically if the broker refuses an alias.
+                                     Only QoS 0 publishes use aliases: esp-mqtt may resend a stored QoS > 0 packet on a
+                                     later connection, where its alias is unknown. See alias_hits / alias_ineligible in mqtt_comm_stats_t. */
+    uint32_t message_expiry_s;  /*!< MQTT 5: Message Expiry Interval set on every publish (0 = messages never expire) */
+    bool persistent_session;    /*!< Ask the broker to keep the session (subscriptions, undelivered QoS > 0 messages) while offline.
+                                     Needs a stable client ID and nvs_flash_init() before mqtt_comm_init(). */
+    uint32_t session_expiry_s;  /*!< MQTT 5: how long the broker keeps a persistent session after a disconnect (0 for 1 day) */
+    uint16_t receive_maximum;   /*!< MQTT 5: QoS > 0 messages the broker may have in flight towards us (0 = broker default, 65535).
+                                     A message is acknowledged when its handler returns, so a handler that waits slows the broker down. */
+    uint32_t reconnect_base_ms; /*!< Reconnect backoff: first window; doubles per failed attempt, delay drawn uniformly from it
+                                     (0 = esp-mqtt's fixed reconnect interval) */
+    uint32_t reconnect_max_ms;  /*!< Reconnect backoff: largest window */
+    uint32_t retransmit_timeout_ms; /*!< Resend interval for unacknowledged QoS > 0 messages (0 for the esp-mqtt default, 1000 ms) */
+    const mqtt_comm_route_t *routes; /*!< Subscription table, sent as one SUBSCRIBE after every connect
+                                          (filters still held by a resumed session are skipped; may be NULL) */
+    size_t route_count;         /*!< Number of entries in routes (max MQTT_COMM_ROUTE_MAX) */
+    int buffer_size;            /*!< Client input/output buffer (0 for the esp-mqtt default, 1024); larger messages arrive in fragments */
+    mqtt_comm_rx_mode_t rx_mode; /*!< Delivery of fragmented incoming messages */
+    size_t rx_max_len;          /*!< Reassembly: largest message accepted, allocated once at init (0 for 4096). Larger ones are dropped. */
     // Add LWT parameters if needed:
     // const char *lwt_topic;
     // const char *lwt_msg;
@@ -20,6 +179,67 @@ typedef struct {
     // int lwt_retain;
 } mqtt_comm_config_t;
 
+/**
+ * @brief Uplink compression counters (see mqtt_comm_get_compress_stats()).
+ *
+ * Ratio = bytes_out / bytes_in, encoder throughput = bytes_attempted / encode_time_us.
+ */
+typedef struct {
+    uint32_t attempts;        /*!< Payloads that were run through the encoder */
+    uint32_t compressed;      /*!< Payloads sent compressed (the rest did not shrink) */
+    uint64_t bytes_attempted; /*!< Input bytes of all attempts */
+    uint64_t bytes_in;        /*!< Input bytes of payloads sent compressed */
+    uint64_t bytes_out;       /*!< Output bytes of payloads sent compressed */
+    uint64_t encode_time_us;  /*!< Time spent in the encoder for all attempts */
+} mqtt_comm_compress_stats_t;
+
+/**
+ * @brief Rate limiter counters (see mqtt_comm_get_rate_stats()).
+ */
+typedef struct {
+    uint32_t passed;          /*!< Messages that got a token (including coalesced ones sent later) */
+    uint32_t delayed;         /*!< Messages the publishing task had to wait for */
+    uint32_t coalesced;       /*!< Messages held back to be sent when a token is available */
+    uint32_t replaced;        /*!< Held-back messages overwritten by a newer one on the same topic */
+    uint32_t dropped;         /*!< Messages discarded for exceeding the limit */
+    uint32_t evicted;         /*!< Per-topic buckets recycled for another topic (table full) */
+    uint32_t pending;         /*!< Messages currently held back */
+} mqtt_comm_rate_stats_t;
+
+/**
+ * @brief Publish delivery statistics (see mqtt_comm_get_stats()).
+ *
+ * Only QoS > 0 publishes are timed, from the publish call to the matching PUBACK.
+ */
+typedef struct {
+    uint32_t latency_hist[MQTT_COMM_LATENCY_BUCKETS]; /*!< Bucket 0: < 1 ms, bucket i: [2^(i-1), 2^i) ms, last bucket open-ended */
+    uint32_t latency_min_us;  /*!< Fastest acknowledged publish */
+    uint32_t latency_max_us;  /*!< Slowest acknowledged publish */
+    uint64_t latency_sum_us;  /*!< Sum of all latencies (mean = sum / acked) */
+    uint32_t published;       /*!< QoS > 0 publishes handed to the client */
+    uint32_t acked;           /*!< Publishes confirmed by the broker */
+    uint32_t in_flight;       /*!< Publishes waiting for their acknowledgement */
+    uint32_t retransmits;     /*!< Estimated resends: one per retransmit timeout waited, plus one per reconnect */
+    uint32_t expired;         /*!< Messages dropped from the outbox before being acknowledged */
+    uint32_t untracked;       /*!< Acks that could not be matched (or publishes evicted from the in-flight table) */
+    int outbox_size;          /*!< Bytes currently held in the esp-mqtt outbox */
+    uint32_t rx_fragmented;   /*!< Incoming messages that arrived in several fragments */
+    uint32_t rx_dropped;      /*!< Incoming messages dropped (too large, topic too long or fragment lost) */
+    uint32_t subscribe_time_us; /*!< Last connect: time from CONNACK until all routes were subscribed (0 if the session held them) */
+    uint32_t connects;        /*!< Successful connections */
+    uint32_t connect_time_us; /*!< Last connect: time from starting the attempt (TCP, TLS, CONNECT) to CONNACK */
+    uint32_t connect_time_min_us; /*!< Fastest connect */
+    uint32_t connect_time_max_us; /*!< Slowest connect */
+    uint32_t tls_handshakes;  /*!< mqtts://: completed TLS handshakes */
+    uint32_t tls_resumptions; /*!< Handshakes that offered the previous session ticket */
+    uint32_t tls_handshake_us; /*!< Last TLS handshake, from TCP connected to handshake done */
+    uint32_t tls_handshake_max_us; /*!< Slowest TLS handshake */
+    uint32_t dedup_suppressed; /*!< Publishes skipped because the payload had not changed */
+    uint32_t alias_hits;      /*!< MQTT 5: publishes sent with an alias instead of the topic */
+    uint32_t alias_bytes_saved; /*!< MQTT 5: bytes those publishes saved (topic length minus the 3-byte alias property) */
+    uint32_t alias_ineligible; /*!< MQTT 5: publishes that had to carry the full topic (QoS > 0 or enqueued) */
+} mqtt_comm_stats_t;
+
 /**
  * @brief MQTT connection status enumeration.
  */
@@ -40,6 +260,9 @@ typedef void (*mqtt_conn_status_callback_t)(mqtt_conn_status_t status);
 /**
  * @brief Callback function type for received MQTT messages.
  *
+ * Receives messages that did not match any registered route. In
+ * MQTT_COMM_RX_MODE_STREAM, fragments of a large message are passed one by one.
+ *
  * @param topic Pointer to the topic string.
  * @param topic_len Length of the topic string.
  * @param data Pointer to the payload data.
@@ -56,7 +279,7 @@ typedef void (*mqtt_comm_data_callback_t)(const char *topic, size_t topic_len, c
  *
  * @param config Pointer to the MQTT configuration structure.
  * @param status_cb Pointer to the callback function for connection status changes.
- * @param data_cb Pointer to the callback function for incoming subscribed messages.
+ * @param data_cb Pointer to the callback function for incoming messages not handled by a route.
  * @return esp_err_t ESP_OK on success, or an error code if client init fails.
  */
 esp_err_t mqtt_comm_init(const mqtt_comm_config_t *config,
@@ -81,6 +304,48 @@ esp_err_t mqtt_comm_init(const mqtt_comm_config_t *config,
  */
 esp_err_t mqtt_comm_publish(const char *topic, const char *data, int len, int qos, int retain);
 
+/**
+ * @brief Publishes a message, with control over the optional publish stages.
+ *
+ * Same as mqtt_comm_publish(), but `flags` (MQTT_COMM_PUB_FLAG_*) can be used to
+ * bypass stages such as coalescing for individual messages.
+ * A publish suppressed as a duplicate (mqtt_comm_config_t.dedup) returns ESP_OK.
+ * When the message is absorbed into a batch, ESP_OK means it was accepted into
+ * the batch; the actual PUBLISH happens when the batch is flushed.
+ *
+ * @param topic The topic string to publish to.
+ * @param data Pointer to the payload data.
+ * @param len Length of the payload data, or -1 for a null-terminated string.
+ * @param qos QoS level (0, 1, or 2). QoS > 0 is never coalesced.
+ * @param retain Retain flag (0 or 1). Retained messages are never coalesced.
+ * @param flags Bitmask of MQTT_COMM_PUB_FLAG_* values.
+ * @return esp_err_t ESP_OK on success, ESP_FAIL if client not connected or publish fails,
+ *         ESP_ERR_INVALID_ARG if arguments are invalid,
+ *         ESP_ERR_NOT_ALLOWED if the message was dropped by the rate limiter.
+ */
+esp_err_t mqtt_comm_publish_ex(const char *topic, const char *data, int len, int qos, int retain, uint32_t flags);
+
+/**
+ * @brief Sets the coalescing window for a single topic.
+ *
+ * Overrides the default window from mqtt_comm_config_t for this exact topic.
+ * Passing a config with window_ms = 0 disables coalescing for the topic.
+ * Must be called after mqtt_comm_init().
+ *
+ * @param topic Exact topic string (no wildcards).
+ * @param cfg Window for the topic.
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if arguments are invalid
+ *         or the component is not initialized, ESP_ERR_NO_MEM if the per-topic table is full.
+ */
+esp_err_t mqtt_comm_batch_set_topic(const char *topic, const mqtt_comm_batch_config_t *cfg);
+
+/**
+ * @brief Publishes all pending batches immediately.
+ *
+ * @return esp_err_t ESP_OK if every pending batch was published, ESP_FAIL otherwise.
+ */
+esp_err_t mqtt_comm_batch_flush(void);
+
 /**
  * @brief Subscribes to an MQTT topic.
  *
@@ -108,6 +373,38 @@ esp_err_t mqtt_comm_subscribe(const char *topic, int qos);
  */
 esp_err_t mqtt_comm_unsubscribe(const char *topic);
 
+/**
+ * @brief Reads the uplink compression counters.
+ *
+ * @param out Destination for the counters.
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if out is NULL.
+ */
+esp_err_t mqtt_comm_get_compress_stats(mqtt_comm_compress_stats_t *out);
+
+/**
+ * @brief Reads the rate limiter counters.
+ *
+ * @param out Destination for the counters (all 0 if rate limiting is off).
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if out is NULL.
+ */
+esp_err_t mqtt_comm_get_rate_stats(mqtt_comm_rate_stats_t *out);
+
+/**
+ * @brief Reads the publish delivery statistics (latency histogram, in-flight, outbox).
+ *
+ * @param out Destination for the statistics.
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if out is NULL.
+ */
+esp_err_t mqtt_comm_get_stats(mqtt_comm_stats_t *out);
+
+/**
+ * @brief Tells the component that the network (IP) is back.
+ *
+ * With reconnect backoff enabled this resets the backoff and reconnects
+ * immediately. Safe to call at any time, e.g. from the WiFi GOT_IP callback.
+ */
+void mqtt_comm_notify_network_up(void);
+
 /**
  * @brief Checks if the MQTT client is currently connected to the broker.
  *
@@ -124,4 +421,16 @@ bool mqtt_comm_is_connected(void);
  */
 esp_err_t mqtt_comm_deinit(void);
 
+/**
+ * @brief FNV-1a hash used to key per-topic tables (also by the application).
+ */
+static inline uint32_t mqtt_comm_hash32(const char *data, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
 #endif // MQTT_COMM_H
\ No newline at end of file
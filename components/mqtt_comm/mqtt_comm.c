@@ -1,12 +1,20 @@
 // components/mqtt_comm/mqtt_comm.c
 #include <string.h>
 #include <stdlib.h> // For malloc if default client ID needed
+#include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_wifi.h" // For MAC address -> client ID
+#include "conn_timing.h"
+#include "dlog.h"
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+#include "esp_crt_bundle.h"
+#endif
 #include "mqtt_client.h"
 #include "mqtt_comm.h" // Include own header
+#include "mqtt_comm_priv.h"
 
 static const char *TAG = "MQTT_COMM";
 
@@ -18,6 +26,15 @@ static SemaphoreHandle_t s_client_mutex = NULL; // Protects s_client handle and
 static volatile bool s_is_connected = false;
 static bool s_is_initialized = false; // Tracks if init was called successfully
 static char* s_default_client_id = NULL; // Store generated client ID if needed
+static mqtt_comm_protocol_t s_protocol = MQTT_COMM_PROTOCOL_V3_1_1;
+static uint32_t s_message_expiry_s = 0;
+static bool s_was_connected = false; // A connection existed before the current one
+static int64_t s_connected_us = 0;   // Time of the last CONNACK (MQTT task only)
+static int64_t s_connect_start_us = 0; // Start of the current connection attempt (MQTT task only)
+static bool s_persistent_session = false;
+
+#define CLIENT_ID_MAX_LEN 64
+#define DEFAULT_SESSION_EXPIRY_S (24 * 60 * 60)
 
 // Forward declaration
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data);
@@ -33,6 +50,54 @@ static char* generate_default_client_id() {
     return client_id;
 }
 
+// Client ID used when none is configured. With a persistent session it is
+// kept in NVS, as the broker finds the session by client ID.
+static char* default_client_id(bool persistent) {
+    if (persistent) {
+        char *client_id = malloc(CLIENT_ID_MAX_LEN);
+        if (client_id && mqtt_comm_session_load_client_id(client_id, CLIENT_ID_MAX_LEN) == ESP_OK) {
+            return client_id;
+        }
+        free(client_id);
+    }
+    char *client_id = generate_default_client_id();
+    if (client_id && persistent) {
+        mqtt_comm_session_save_client_id(client_id);
+    }
+    return client_id;
+}
+
+static void deinit_stages(void) {
+    mqtt_comm_dedup_init(false, 0); // Forgets all payload hashes
+    mqtt_comm_ratelimit_deinit();
+    mqtt_comm_batch_deinit();
+    mqtt_comm_compress_deinit();
+    mqtt_comm_rx_deinit();
+    mqtt_comm_router_deinit();
+}
+
+// Optional publish stages, in publish-path order, then the receive side.
+// Every *_deinit() is safe on a stage that was never initialized.
+static esp_err_t init_stages(const mqtt_comm_config_t *config) {
+    mqtt_comm_dedup_init(config->dedup, config->dedup_max_quiet_ms);
+    esp_err_t ret = mqtt_comm_ratelimit_init(&config->rate_limit);
+    if (ret == ESP_OK) {
+        ret = mqtt_comm_batch_init(&config->batch);
+    }
+    if (ret == ESP_OK) {
+        ret = mqtt_comm_compress_init(config->compress_min_len, config->compress_topic_suffix);
+    }
+    if (ret == ESP_OK) {
+        ret = mqtt_comm_rx_init(config->rx_mode, config->rx_max_len);
+    }
+    if (ret == ESP_OK) {
+        ret = mqtt_comm_router_init(config->routes, config->route_count);
+    }
+    if (ret != ESP_OK) {
+        deinit_stages();
+    }
+    return ret;
+}
 
 esp_err_t mqtt_comm_init(const mqtt_comm_config_t *config,
                          mqtt_conn_status_callback_t status_cb,
@@ -57,7 +122,7 @@ esp_err_t mqtt_comm_init(const mqtt_comm_config_t *config,
 
     const char* client_id_to_use = config->client_id;
     if (!client_id_to_use) {
-        s_default_client_id = generate_default_client_id();
+        s_default_client_id = default_client_id(config->persistent_session);
         if (!s_default_client_id) {
              ESP_LOGE(TAG, "Failed to generate default client ID");
              vSemaphoreDelete(s_client_mutex);
@@ -73,12 +138,84 @@ esp_err_t mqtt_comm_init(const mqtt_comm_config_t *config,
         .credentials.client_id = client_id_to_use,
         .credentials.username = config->username,
         .credentials.authentication.password = config->password,
+        .broker.verification.certificate = config->ca_cert_pem,
+        .broker.verification.common_name = config->tls_common_name,
+        .session.message_retransmit_timeout = (int)config->retransmit_timeout_ms,
+        .session.disable_clean_session = config->persistent_session,
+        .network.disable_auto_reconnect = (config->reconnect_base_ms > 0), // mqtt_comm_reconnect.c takes over
+        .buffer.size = config->buffer_size,
         // Add LWT config here if needed from config struct
     };
+    if (!config->ca_cert_pem && config->use_crt_bundle) {
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+        mqtt_cfg.broker.verification.crt_bundle_attach = esp_crt_bundle_attach;
+#else
+        ESP_LOGW(TAG, "Certificate bundle requested but CONFIG_MBEDTLS_CERTIFICATE_BUNDLE is not enabled");
+#endif
+    }
+    if (mqtt_comm_discovery_init(config->broker_uri, config->broker_discovery, config->broker_cache_ttl_s) == ESP_OK &&
+        !config->tls_common_name && mqtt_comm_discovery_tls_host()) {
+        // The URI will hold an IP address, the certificate still names the host
+        mqtt_cfg.broker.verification.common_name = mqtt_comm_discovery_tls_host();
+    }
+    if (strncmp(config->broker_uri, "mqtts://", 8) == 0) {
+        // Our own TLS transport: times TCP and TLS separately and resumes sessions.
+        // It is verified with the same certificate settings as above.
+        mqtt_cfg.network.transport = mqtt_comm_tls_transport_create(config, mqtt_cfg.broker.verification.common_name);
+        if (!mqtt_cfg.network.transport) {
+            ESP_LOGW(TAG, "Falling back to esp-mqtt's SSL transport");
+        }
+    }
+    mqtt_comm_stats_init(config->retransmit_timeout_ms ? config->retransmit_timeout_ms : 1000);
+    s_was_connected = false;
+
+    s_protocol = config->protocol;
+    s_message_expiry_s = config->message_expiry_s;
+    if (s_protocol == MQTT_COMM_PROTOCOL_V5) {
+#if CONFIG_MQTT_PROTOCOL_5
+        mqtt_cfg.session.protocol_ver = MQTT_PROTOCOL_V_5;
+        mqtt_comm_alias_init(config->topic_alias_max);
+        ESP_LOGI(TAG, "Using MQTT 5 (topic aliases: %d, message expiry: %" PRIu32 " s)",
+                 config->topic_alias_max, s_message_expiry_s);
+#else
+        ESP_LOGE(TAG, "MQTT 5 requested but CONFIG_MQTT_PROTOCOL_5 is not enabled");
+        if (s_default_client_id) {
+            free(s_default_client_id);
+            s_default_client_id = NULL;
+        }
+        vSemaphoreDelete(s_client_mutex);
+        s_client_mutex = NULL;
+        return ESP_ERR_NOT_SUPPORTED;
+#endif
+    }
+
+    s_persistent_session = config->persistent_session;
+    esp_err_t ret = init_stages(config);
+    if (ret == ESP_OK && s_persistent_session) {
+        // Same routes as when the stored session was set up: if the broker resumes
+        // it, no SUBSCRIBE is needed at all
+        uint32_t table_hash = mqtt_comm_router_table_hash();
+        if (table_hash != 0 && table_hash == mqtt_comm_session_load_sub_hash()) {
+            mqtt_comm_router_mark_subscribed();
+        }
+    }
+    if (ret != ESP_OK) {
+        if (s_default_client_id) {
+            free(s_default_client_id);
+            s_default_client_id = NULL;
+        }
+        vSemaphoreDelete(s_client_mutex);
+        s_client_mutex = NULL;
+        return ret;
+    }
 
     s_client = esp_mqtt_client_init(&mqtt_cfg);
     if (s_client == NULL) {
         ESP_LOGE(TAG, "Failed to initialize MQTT client");
+        if (mqtt_cfg.network.transport) {
+            esp_transport_destroy(mqtt_cfg.network.transport);
+        }
+        deinit_stages();
         if (s_default_client_id) {
             free(s_default_client_id);
             s_default_client_id = NULL;
@@ -88,11 +225,47 @@ esp_err_t mqtt_comm_init(const mqtt_comm_config_t *config,
         return ESP_FAIL;
     }
 
-    esp_err_t ret = esp_mqtt_client_register_event(s_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+    ret = mqtt_comm_reconnect_init(s_client, config->reconnect_base_ms, config->reconnect_max_ms);
+    if (ret == ESP_OK) {
+        ret = mqtt_comm_discovery_start(s_client);
+    }
+    if (ret != ESP_OK) {
+        mqtt_comm_discovery_deinit();
+        mqtt_comm_reconnect_deinit();
+        esp_mqtt_client_destroy(s_client);
+        s_client = NULL;
+        deinit_stages();
+        if (s_default_client_id) {
+            free(s_default_client_id);
+            s_default_client_id = NULL;
+        }
+        vSemaphoreDelete(s_client_mutex);
+        s_client_mutex = NULL;
+        return ret;
+    }
+
+#if CONFIG_MQTT_PROTOCOL_5
+    if (s_protocol == MQTT_COMM_PROTOCOL_V5 && (config->receive_maximum > 0 || s_persistent_session)) {
+        esp_mqtt5_connection_property_config_t connect_props = {
+            .receive_maximum = config->receive_maximum,
+            // With MQTT 5 a session ends at disconnect unless it has an expiry interval
+            .session_expiry_interval = s_persistent_session ?
+                (config->session_expiry_s ? config->session_expiry_s : DEFAULT_SESSION_EXPIRY_S) : 0,
+        };
+        if (esp_mqtt5_client_set_connect_property(s_client, &connect_props) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to set MQTT 5 connect properties");
+        }
+    }
+#endif
+
+    ret = esp_mqtt_client_register_event(s_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to register MQTT event handler: %s", esp_err_to_name(ret));
         esp_mqtt_client_destroy(s_client);
         s_client = NULL;
+        mqtt_comm_discovery_deinit();
+        mqtt_comm_reconnect_deinit();
+        deinit_stages();
          if (s_default_client_id) {
             free(s_default_client_id);
             s_default_client_id = NULL;
@@ -108,6 +281,9 @@ esp_err_t mqtt_comm_init(const mqtt_comm_config_t *config,
         // No need to unregister handler, destroy cleans up
         esp_mqtt_client_destroy(s_client);
         s_client = NULL;
+        mqtt_comm_discovery_deinit();
+        mqtt_comm_reconnect_deinit();
+        deinit_stages();
          if (s_default_client_id) {
             free(s_default_client_id);
             s_default_client_id = NULL;
@@ -123,16 +299,122 @@ esp_err_t mqtt_comm_init(const mqtt_comm_config_t *config,
 }
 
 esp_err_t mqtt_comm_publish(const char *topic, const char *data, int len, int qos, int retain) {
+    return mqtt_comm_publish_ex(topic, data, len, qos, retain, MQTT_COMM_PUB_FLAG_NONE);
+}
+
+// Publish stages after deduplication: rate limiting, coalescing, then the output side.
+// The dedup key is recorded by whichever stage actually hands the payload to the client.
+static esp_err_t publish_stages(const char *topic, const char *data, size_t data_len, int qos, int retain, uint32_t flags,
+                                const mqtt_comm_dedup_key_t *dedup_key) {
+    if (!(flags & MQTT_COMM_PUB_FLAG_NO_RATE_LIMIT)) {
+        esp_err_t ret = mqtt_comm_ratelimit_offer(topic, data, data_len, qos, retain, flags, dedup_key);
+        if (ret != ESP_ERR_NOT_SUPPORTED) {
+            return ret;
+        }
+    }
+
+    // Coalescing only applies to fire-and-forget messages
+    if (qos == 0 && !retain && !(flags & MQTT_COMM_PUB_FLAG_NO_BATCH)) {
+        if (!s_is_connected) {
+            ESP_LOGW(TAG, "MQTT not connected, cannot publish to topic '%s'", topic);
+            return ESP_FAIL;
+        }
+        esp_err_t ret = mqtt_comm_batch_offer(topic, data, data_len, dedup_key);
+        if (ret != ESP_ERR_NOT_SUPPORTED) {
+            return ret;
+        }
+    }
+    esp_err_t ret = mqtt_comm_publish_final(topic, data, data_len, qos, retain, flags, false);
+    if (ret == ESP_OK) {
+        mqtt_comm_dedup_record(dedup_key); // Only a payload that went out suppresses its repeats
+    }
+    return ret;
+}
+
+esp_err_t mqtt_comm_publish_ex(const char *topic, const char *data, int len, int qos, int retain, uint32_t flags) {
     if (!s_is_initialized || !topic || (!data && len != 0)) {
         return ESP_ERR_INVALID_ARG;
     }
 
+    size_t data_len = (len < 0) ? strlen(data) : (size_t)len;
+
+    mqtt_comm_dedup_key_t dedup_key = { 0 };
+    if (!(flags & MQTT_COMM_PUB_FLAG_NO_DEDUP) &&
+        mqtt_comm_dedup_is_duplicate(topic, data, data_len, &dedup_key)) {
+        ESP_LOGD(TAG, "Unchanged payload on '%s', not published", topic);
+        return ESP_OK;
+    }
+    return publish_stages(topic, data, data_len, qos, retain, flags, &dedup_key);
+}
+
+esp_err_t mqtt_comm_publish_final(const char *topic, const char *data, size_t len,
+                                  int qos, int retain, uint32_t flags, bool enqueue) {
+    if (!(flags & MQTT_COMM_PUB_FLAG_NO_COMPRESS)) {
+        esp_err_t ret = mqtt_comm_compress_publish(topic, data, len, qos, retain, enqueue);
+        if (ret != ESP_ERR_NOT_SUPPORTED) {
+            return ret;
+        }
+    }
+    return mqtt_comm_publish_direct(topic, data, (int)len, qos, retain, enqueue);
+}
+
+#if CONFIG_MQTT_PROTOCOL_5
+// Must be called with s_client_mutex held
+static int publish_v5(const char *topic, const char *data, int len, int qos, int retain, bool enqueue) {
+    // Only packets written straight to the socket use the short alias-only form.
+    // Stored packets (QoS > 0, enqueued) can be replayed on a later connection,
+    // where the alias no longer exists.
+    bool announce = false;
+    uint16_t alias = (qos == 0 && !enqueue) ? mqtt_comm_alias_get(topic, &announce) : 0;
+
+    esp_mqtt5_publish_property_config_t property = {
+        .message_expiry_interval = s_message_expiry_s,
+        .topic_alias = alias,
+    };
+    esp_mqtt5_client_set_publish_property(s_client, &property);
+    const char *wire_topic = (alias && !announce) ? "" : topic;
+    if (qos > 0 || enqueue || (alias && !announce)) {
+        mqtt_comm_stats_on_alias(alias != 0, strlen(topic)); // Shows what aliasing saves on real traffic
+    }
+    int msg_id = enqueue ? esp_mqtt_client_enqueue(s_client, wire_topic, data, len, qos, retain, true)
+                         : esp_mqtt_client_publish(s_client, wire_topic, data, len, qos, retain);
+    if (msg_id != -1) {
+        if (announce) {
+            mqtt_comm_alias_confirm(alias);
+        }
+    } else if (announce) {
+        // A new alias that fails is most likely above the broker's Topic Alias Maximum:
+        // stop using it and retry without alias
+        mqtt_comm_alias_limit(alias - 1);
+        property.topic_alias = 0;
+        esp_mqtt5_client_set_publish_property(s_client, &property);
+        msg_id = esp_mqtt_client_publish(s_client, topic, data, len, qos, retain);
+    }
+    return msg_id;
+}
+#endif
+
+esp_err_t mqtt_comm_publish_direct(const char *topic, const char *data, int len, int qos, int retain, bool enqueue) {
     esp_err_t result = ESP_FAIL;
     if (xSemaphoreTake(s_client_mutex, pdMS_TO_TICKS(100)) == pdTRUE) { // Wait briefly
         if (s_is_connected && s_client) {
-            int msg_id = esp_mqtt_client_publish(s_client, topic, data, len, qos, retain);
+            int64_t start_us = esp_timer_get_time();
+            int msg_id;
+#if CONFIG_MQTT_PROTOCOL_5
+            if (s_protocol == MQTT_COMM_PROTOCOL_V5) {
+                msg_id = publish_v5(topic, data, len, qos, retain, enqueue);
+            } else
+#endif
+            {
+                msg_id = enqueue ? esp_mqtt_client_enqueue(s_client, topic, data, len, qos, retain, true)
+                                 : esp_mqtt_client_publish(s_client, topic, data, len, qos, retain);
+            }
             if (msg_id != -1) {
                 ESP_LOGD(TAG, "Publish queued successfully to topic '%s', msg_id=%d", topic, msg_id);
+                if (qos > 0 && msg_id > 0) {
+                    // The PUBACK may already have been handled; stats settle that case
+                    mqtt_comm_stats_on_publish(msg_id, start_us);
+                }
                 result = ESP_OK;
             } else {
                 ESP_LOGE(TAG, "Failed to queue publish message to topic '%s'", topic);
@@ -206,6 +488,28 @@ esp_err_t mqtt_comm_unsubscribe(const char *topic) {
     return result;
 }
 
+int mqtt_comm_outbox_size(void) {
+    int size = 0;
+    if (s_client_mutex && xSemaphoreTake(s_client_mutex, pdMS_TO_TICKS(50)) == pdTRUE) {
+        if (s_client) {
+            size = esp_mqtt_client_get_outbox_size(s_client);
+        }
+        xSemaphoreGive(s_client_mutex);
+    }
+    return size;
+}
+
+void mqtt_comm_notify_network_up(void) {
+    if (!s_is_initialized || s_is_connected) {
+        return;
+    }
+    mqtt_comm_reconnect_now();
+}
+
+bool mqtt_comm_connected_nowait(void) {
+    return s_is_connected; // Word-sized: a read without the mutex is atomic, at worst one event stale
+}
+
 bool mqtt_comm_is_connected(void) {
     // Reading volatile bool is generally atomic, but mutex ensures consistency
     // if read happens during a state change in the event handler.
@@ -227,6 +531,11 @@ esp_err_t mqtt_comm_deinit(void) {
     ESP_LOGI(TAG, "Deinitializing MQTT client...");
     esp_err_t ret = ESP_OK;
 
+    mqtt_comm_batch_flush(); // Hand pending batches to the client before it stops
+    mqtt_comm_reconnect_deinit(); // No reconnect may fire into a destroyed client
+    mqtt_comm_discovery_deinit();
+    mqtt_comm_tls_deinit();
+
     if (xSemaphoreTake(s_client_mutex, pdMS_TO_TICKS(500)) == pdTRUE) { // Wait longer for mutex during deinit
         if (s_client) {
             ret = esp_mqtt_client_stop(s_client); // Stop first
@@ -245,6 +554,8 @@ esp_err_t mqtt_comm_deinit(void) {
     }
 
 
+    deinit_stages();
+
     if (s_client_mutex) {
         vSemaphoreDelete(s_client_mutex);
         s_client_mutex = NULL;
@@ -262,6 +573,12 @@ esp_err_t mqtt_comm_deinit(void) {
 }
 
 
+void mqtt_comm_deliver(const mqtt_comm_message_t *msg) {
+    if (mqtt_comm_router_dispatch(msg) == 0 && s_data_callback) {
+        s_data_callback(msg->topic, msg->topic_len, msg->data, msg->data_len);
+    }
+}
+
 // --- Internal Event Handler ---
 
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data) {
@@ -271,14 +588,39 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     switch ((esp_mqtt_event_id_t)event_id) {
         case MQTT_EVENT_BEFORE_CONNECT:
              ESP_LOGI(TAG, "MQTT_EVENT_BEFORE_CONNECT");
+             s_connect_start_us = esp_timer_get_time();
+             conn_timing_mark(CONN_TIMING_MQTT_START);
              // Could set status to connecting here if desired
              break;
         case MQTT_EVENT_CONNECTED:
-            ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
+            ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED (session present: %d)", event->session_present);
             if (xSemaphoreTake(s_client_mutex, portMAX_DELAY) == pdTRUE) {
                 s_is_connected = true;
+#if CONFIG_MQTT_PROTOCOL_5
+                mqtt_comm_alias_reset(); // New connection: no alias is known to the broker yet
+#endif
                 xSemaphoreGive(s_client_mutex);
             }
+            if (s_was_connected) {
+                mqtt_comm_stats_on_reconnect();
+            }
+            s_was_connected = true;
+            mqtt_comm_reconnect_on_connected();
+            mqtt_comm_discovery_on_connected();
+            mqtt_comm_ratelimit_on_connected();
+            // Subscribe directly on the event's client: taking s_client_mutex here
+            // could deadlock against a publisher waiting for the client's own lock.
+            s_connected_us = esp_timer_get_time();
+            conn_timing_mark(CONN_TIMING_MQTT_CONNACK);
+            if (s_connect_start_us) {
+                // TCP + TLS handshake + CONNECT/CONNACK (the TLS part is in tls_handshake_us)
+                mqtt_comm_stats_on_connected(s_connected_us - s_connect_start_us);
+                ESP_LOGI(TAG, "Connected in %" PRId64 " ms", (s_connected_us - s_connect_start_us) / 1000);
+            }
+            if (mqtt_comm_router_subscribe_all(client, event->session_present) == 0) {
+                mqtt_comm_stats_on_subscribed(0);
+                conn_timing_mark(CONN_TIMING_MQTT_SUBACK); // Nothing to subscribe: ready now
+            }
             if (s_status_callback) s_status_callback(MQTT_CONN_STATUS_CONNECTED);
             break;
         case MQTT_EVENT_DISCONNECTED:
@@ -287,24 +629,40 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
                 s_is_connected = false;
                  xSemaphoreGive(s_client_mutex);
             }
+            mqtt_comm_discovery_on_disconnected();
+            mqtt_comm_reconnect_on_disconnected();
             if (s_status_callback) s_status_callback(MQTT_CONN_STATUS_DISCONNECTED);
             break;
         case MQTT_EVENT_SUBSCRIBED:
             ESP_LOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
+            // event->data holds the SUBACK return codes
+            if (mqtt_comm_router_on_suback(event->msg_id, (const uint8_t *)event->data, (size_t)event->data_len)) {
+                int64_t elapsed_us = esp_timer_get_time() - s_connected_us;
+                conn_timing_mark(CONN_TIMING_MQTT_SUBACK);
+                mqtt_comm_stats_on_subscribed(elapsed_us);
+                ESP_LOGI(TAG, "Subscriptions restored %" PRId64 " ms after CONNACK", elapsed_us / 1000);
+                if (s_persistent_session && mqtt_comm_router_all_subscribed()) {
+                    mqtt_comm_session_save_sub_hash(mqtt_comm_router_table_hash());
+                }
+            }
             break;
         case MQTT_EVENT_UNSUBSCRIBED:
             ESP_LOGI(TAG, "MQTT_EVENT_UNSUBSCRIBED, msg_id=%d", event->msg_id);
             break;
         case MQTT_EVENT_PUBLISHED:
-            ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+            ESP_LOGD(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+            mqtt_comm_stats_on_ack(event->msg_id);
+            break;
+        case MQTT_EVENT_DELETED:
+            ESP_LOGW(TAG, "MQTT_EVENT_DELETED (expired in outbox), msg_id=%d", event->msg_id);
+            mqtt_comm_stats_on_deleted(event->msg_id);
             break;
         case MQTT_EVENT_DATA:
-            ESP_LOGI(TAG, "MQTT_EVENT_DATA");
+            DLOGI(TAG, "MQTT_EVENT_DATA, msg_id=%d, %d bytes", event->msg_id, event->data_len);
             ESP_LOGD(TAG, "TOPIC=%.*s", event->topic_len, event->topic);
-            ESP_LOGD(TAG, "DATA=%.*s", event->data_len, event->data);
-            if (s_data_callback) {
-                s_data_callback(event->topic, event->topic_len, event->data, event->data_len);
-            }
+            ESP_LOGD(TAG, "DATA=%.*s (offset %d of %d)", event->data_len, event->data,
+                     event->current_data_offset, event->total_data_len);
+            mqtt_comm_rx_on_data(event);
             break;
         case MQTT_EVENT_ERROR:
             ESP_LOGE(TAG, "MQTT_EVENT_ERROR");
@@ -0,0 +1,83 @@
+// components/mqtt_comm/mqtt_comm_alias.c
+// MQTT 5 topic alias table. Alias N is bound to slot N-1; when all slots are
+// taken the least recently used topic gives up its alias.
+#include <string.h>
+#include "esp_log.h"
+#include "mqtt_comm_priv.h"
+
+static const char *TAG = "MQTT_ALIAS";
+
+typedef struct {
+    uint32_t hash;
+    uint32_t last_used;   // Value of s_use_clock at last use (0 = slot empty)
+    bool announced;       // Broker knows the mapping on the current connection
+    char topic[MQTT_COMM_TOPIC_MAX_LEN];
+} alias_slot_t;
+
+// All access happens with the client mutex held (from mqtt_comm_publish_direct
+// and the connection event handler), so no lock of its own.
+static alias_slot_t s_slots[MQTT_COMM_TOPIC_ALIAS_SLOTS];
+static uint16_t s_alias_max = 0;
+static uint32_t s_use_clock = 0;
+
+void mqtt_comm_alias_init(uint16_t alias_max) {
+    if (alias_max > MQTT_COMM_TOPIC_ALIAS_SLOTS) {
+        ESP_LOGW(TAG, "Topic alias max %d capped to %d", alias_max, MQTT_COMM_TOPIC_ALIAS_SLOTS);
+        alias_max = MQTT_COMM_TOPIC_ALIAS_SLOTS;
+    }
+    s_alias_max = alias_max;
+    s_use_clock = 0;
+    memset(s_slots, 0, sizeof(s_slots));
+}
+
+uint16_t mqtt_comm_alias_get(const char *topic, bool *announce) {
+    *announce = false;
+    if (s_alias_max == 0 || strlen(topic) >= MQTT_COMM_TOPIC_MAX_LEN) {
+        return 0;
+    }
+
+    uint32_t hash = mqtt_comm_hash32(topic, strlen(topic));
+    int lru = 0;
+    for (int i = 0; i < s_alias_max; i++) {
+        alias_slot_t *slot = &s_slots[i];
+        if (slot->last_used && slot->hash == hash && strcmp(slot->topic, topic) == 0) {
+            slot->last_used = ++s_use_clock;
+            *announce = !slot->announced;
+            return (uint16_t)(i + 1);
+        }
+        if (slot->last_used < s_slots[lru].last_used) {
+            lru = i;
+        }
+    }
+
+    // Miss: rebind the least recently used (or an empty) slot. The new
+    // mapping must be sent with the full topic once.
+    alias_slot_t *slot = &s_slots[lru];
+    slot->hash = hash;
+    slot->last_used = ++s_use_clock;
+    slot->announced = false;
+    strlcpy(slot->topic, topic, sizeof(slot->topic));
+    *announce = true;
+    ESP_LOGD(TAG, "Alias %d -> '%s'", lru + 1, topic);
+    return (uint16_t)(lru + 1);
+}
+
+void mqtt_comm_alias_confirm(uint16_t alias) {
+    if (alias > 0 && alias <= s_alias_max) {
+        s_slots[alias - 1].announced = true;
+    }
+}
+
+void mqtt_comm_alias_limit(uint16_t alias_max) {
+    if (alias_max < s_alias_max) {
+        ESP_LOGW(TAG, "Broker rejected alias %d, limiting topic aliases to %d", alias_max + 1, alias_max);
+        s_alias_max = alias_max;
+    }
+}
+
+void mqtt_comm_alias_reset(void) {
+    // Aliases are scoped to a network connection
+    for (int i = 0; i < MQTT_COMM_TOPIC_ALIAS_SLOTS; i++) {
+        s_slots[i].announced = false;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,337 @@
+// components/mqtt_comm/mqtt_comm_batch.c
+// Optional publish coalescing stage: gathers small QoS 0 messages per topic
+// for up to window_ms / max_bytes and sends them as a single PUBLISH.
+// Batches whose window ran out are sent by the flush task, which takes the
+// buffer out of its slot and publishes it without holding the batch mutex.
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mqtt_comm_priv.h"
+
+static const char *TAG = "MQTT_BATCH";
+
+typedef struct {
+    char topic[MQTT_COMM_TOPIC_MAX_LEN];
+    mqtt_comm_batch_config_t cfg;
+} batch_rule_t;
+
+typedef struct {
+    char topic[MQTT_COMM_TOPIC_MAX_LEN];
+    mqtt_comm_batch_config_t cfg;
+    char *buf;              // cfg.max_bytes bytes, kept between batches (NULL once handed to the flush task)
+    size_t len;
+    uint32_t count;         // Messages in the open batch (0 = slot idle/reusable)
+    mqtt_comm_dedup_key_t dedup; // Newest message in the batch, recorded once the batch is sent
+    int64_t deadline_us;    // esp_timer time at which the open batch must be sent
+} batch_slot_t;
+
+static mqtt_comm_batch_config_t s_default_cfg;
+static batch_rule_t s_rules[MQTT_COMM_BATCH_MAX_TOPICS];
+static int s_rule_count = 0;
+static batch_slot_t s_slots[MQTT_COMM_BATCH_MAX_TOPICS];
+static SemaphoreHandle_t s_batch_mutex = NULL;
+static TaskHandle_t s_flush_task_handle = NULL;
+static SemaphoreHandle_t s_flush_done = NULL; // Given by the flush task right before it exits
+static volatile bool s_flush_stop = false;
+
+// Must be called with s_batch_mutex held
+static const mqtt_comm_batch_config_t *lookup_config(const char *topic) {
+    for (int i = 0; i < s_rule_count; i++) {
+        if (strcmp(s_rules[i].topic, topic) == 0) {
+            return &s_rules[i].cfg;
+        }
+    }
+    return &s_default_cfg;
+}
+
+// Must be called with s_batch_mutex held
+static esp_err_t flush_slot(batch_slot_t *slot) {
+    if (slot->count == 0) {
+        return ESP_OK;
+    }
+    if (slot->cfg.format == MQTT_COMM_BATCH_FORMAT_JSON_ARRAY) {
+        slot->buf[slot->len++] = ']'; // Space for this is reserved on append
+    }
+    ESP_LOGD(TAG, "Flushing %" PRIu32 " msgs (%d bytes) to '%s'", slot->count, (int)slot->len, slot->topic);
+    // Enqueue only: the batch mutex is held, other publishers must not wait on the network
+    esp_err_t ret = mqtt_comm_publish_final(slot->topic, slot->buf, slot->len, 0, 0, MQTT_COMM_PUB_FLAG_NONE, true);
+    if (ret == ESP_OK) {
+        mqtt_comm_dedup_record(&slot->dedup);
+    } else {
+        ESP_LOGW(TAG, "Dropping batch of %" PRIu32 " msgs for '%s'", slot->count, slot->topic);
+    }
+    slot->len = 0;
+    slot->count = 0;
+    return ret;
+}
+
+// Must be called with s_batch_mutex held. Wakes the flush task to re-plan.
+static void wake_flush_task(void) {
+    if (s_flush_task_handle) {
+        xTaskNotifyGive(s_flush_task_handle);
+    }
+}
+
+// Must be called with s_batch_mutex held. Takes one batch whose window ran out,
+// buffer included (its slot allocates a new one when reused). Returns the time
+// until the next batch is due otherwise (INT64_MAX if none is open).
+static int64_t take_due(int64_t now, char *topic, char **buf, size_t *len, uint32_t *count,
+                        mqtt_comm_dedup_key_t *dedup) {
+    int64_t earliest = INT64_MAX;
+    for (int i = 0; i < MQTT_COMM_BATCH_MAX_TOPICS; i++) {
+        batch_slot_t *slot = &s_slots[i];
+        if (slot->count == 0) {
+            continue;
+        }
+        if (slot->deadline_us > now) {
+            earliest = slot->deadline_us - now < earliest ? slot->deadline_us - now : earliest;
+            continue;
+        }
+        if (slot->cfg.format == MQTT_COMM_BATCH_FORMAT_JSON_ARRAY) {
+            slot->buf[slot->len++] = ']'; // Space for this is reserved on append
+        }
+        strlcpy(topic, slot->topic, MQTT_COMM_TOPIC_MAX_LEN);
+        *buf = slot->buf;
+        *len = slot->len;
+        *count = slot->count;
+        *dedup = slot->dedup;
+        slot->buf = NULL;
+        slot->len = 0;
+        slot->count = 0;
+        return 0;
+    }
+    return earliest;
+}
+
+// Sends batches as their windows run out. The publish happens outside the
+// mutex, so offers are never held up by the network or by compression.
+static void flush_task(void *pvParameters) {
+    char topic[MQTT_COMM_TOPIC_MAX_LEN];
+    while (!s_flush_stop) {
+        char *buf = NULL;
+        size_t len = 0;
+        uint32_t count = 0;
+        mqtt_comm_dedup_key_t dedup = { 0 };
+        xSemaphoreTake(s_batch_mutex, portMAX_DELAY);
+        int64_t wait = take_due(esp_timer_get_time(), topic, &buf, &len, &count, &dedup);
+        xSemaphoreGive(s_batch_mutex);
+        if (buf) {
+            ESP_LOGD(TAG, "Flushing %" PRIu32 " msgs (%d bytes) to '%s'", count, (int)len, topic);
+            esp_err_t ret = mqtt_comm_publish_final(topic, buf, len, 0, 0, MQTT_COMM_PUB_FLAG_NONE, false);
+            if (ret == ESP_OK) {
+                mqtt_comm_dedup_record(&dedup);
+            } else {
+                ESP_LOGW(TAG, "Dropping batch of %" PRIu32 " msgs for '%s'", count, topic);
+            }
+            free(buf);
+            continue;
+        }
+        // Sleep until the next window ends or a new batch is opened
+        TickType_t ticks = wait == INT64_MAX ? portMAX_DELAY : pdMS_TO_TICKS(wait / 1000);
+        ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1);
+    }
+    xSemaphoreGive(s_flush_done);
+    vTaskDelete(NULL);
+}
+
+// Must be called with s_batch_mutex held. Returns NULL if no slot is available.
+static batch_slot_t *acquire_slot(const char *topic, const mqtt_comm_batch_config_t *cfg) {
+    batch_slot_t *target = NULL;
+    for (int i = 0; i < MQTT_COMM_BATCH_MAX_TOPICS; i++) {
+        batch_slot_t *slot = &s_slots[i];
+        if (slot->buf && strcmp(slot->topic, topic) == 0) {
+            if (slot->count > 0) {
+                return slot; // Open batch for this topic
+            }
+            target = slot;
+            break;
+        }
+        if (!target && slot->count == 0) {
+            target = slot;
+        }
+    }
+    if (!target) {
+        return NULL;
+    }
+    // Idle slot: (re)configure it for this topic's current window
+    if (!target->buf || target->cfg.max_bytes != cfg->max_bytes) {
+        char *buf = realloc(target->buf, cfg->max_bytes);
+        if (!buf) {
+            return NULL;
+        }
+        target->buf = buf;
+    }
+    strlcpy(target->topic, topic, sizeof(target->topic));
+    target->cfg = *cfg;
+    target->len = 0;
+    return target;
+}
+
+esp_err_t mqtt_comm_batch_init(const mqtt_comm_batch_config_t *default_cfg) {
+    s_default_cfg = *default_cfg;
+    s_rule_count = 0;
+    memset(s_slots, 0, sizeof(s_slots));
+
+    s_batch_mutex = xSemaphoreCreateMutex();
+    if (s_batch_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create batch mutex");
+        return ESP_FAIL;
+    }
+
+    s_flush_stop = false;
+    s_flush_done = xSemaphoreCreateBinary();
+    if (!s_flush_done ||
+        xTaskCreate(flush_task, "mqtt_batch", 3072, NULL, 5, &s_flush_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create batch flush task");
+        if (s_flush_done) {
+            vSemaphoreDelete(s_flush_done);
+            s_flush_done = NULL;
+        }
+        vSemaphoreDelete(s_batch_mutex);
+        s_batch_mutex = NULL;
+        return ESP_FAIL;
+    }
+    if (s_default_cfg.window_ms > 0) {
+        ESP_LOGI(TAG, "Default coalescing window: %" PRIu32 " ms / %d bytes",
+                 s_default_cfg.window_ms, (int)s_default_cfg.max_bytes);
+    }
+    return ESP_OK;
+}
+
+esp_err_t mqtt_comm_batch_offer(const char *topic, const char *data, size_t len, const mqtt_comm_dedup_key_t *key) {
+    if (!s_batch_mutex || len == 0 || strlen(topic) >= MQTT_COMM_TOPIC_MAX_LEN) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (xSemaphoreTake(s_batch_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        ESP_LOGW(TAG, "Could not obtain batch mutex, publishing directly.");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    esp_err_t ret = ESP_ERR_NOT_SUPPORTED;
+    const mqtt_comm_batch_config_t *cfg = lookup_config(topic);
+    batch_slot_t *slot = NULL;
+    bool json = (cfg->format == MQTT_COMM_BATCH_FORMAT_JSON_ARRAY);
+
+    // A message that can never fit a batch on its own is sent as-is
+    if (cfg->window_ms == 0 || len + (json ? 2 : 0) > cfg->max_bytes) {
+        goto out;
+    }
+    slot = acquire_slot(topic, cfg);
+    if (!slot) {
+        goto out;
+    }
+
+    // Separator ('\n' or ',' / '[') plus, for JSON, room for the closing ']'
+    size_t needed = (slot->count > 0 || json ? 1 : 0) + len + (json ? 1 : 0);
+    if (slot->count > 0 && slot->len + needed > slot->cfg.max_bytes) {
+        flush_slot(slot); // Size limit reached: send what we have, start a new batch
+    }
+
+    if (slot->count == 0) {
+        if (json) {
+            slot->buf[slot->len++] = '[';
+        }
+        slot->deadline_us = esp_timer_get_time() + (int64_t)slot->cfg.window_ms * 1000;
+    } else {
+        slot->buf[slot->len++] = json ? ',' : '\n';
+    }
+    memcpy(slot->buf + slot->len, data, len);
+    slot->len += len;
+    slot->count++;
+    slot->dedup = *key;
+
+    if (slot->count == 1) {
+        wake_flush_task(); // New deadline
+    }
+    ret = ESP_OK;
+
+out:
+    xSemaphoreGive(s_batch_mutex);
+    return ret;
+}
+
+esp_err_t mqtt_comm_batch_set_topic(const char *topic, const mqtt_comm_batch_config_t *cfg) {
+    if (!s_batch_mutex || !topic || !cfg || strlen(topic) >= MQTT_COMM_TOPIC_MAX_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (xSemaphoreTake(s_batch_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        ESP_LOGE(TAG, "Could not obtain batch mutex for set_topic.");
+        return ESP_FAIL;
+    }
+
+    esp_err_t ret = ESP_OK;
+    int idx = -1;
+    for (int i = 0; i < s_rule_count; i++) {
+        if (strcmp(s_rules[i].topic, topic) == 0) {
+            idx = i;
+            break;
+        }
+    }
+    if (idx < 0) {
+        if (s_rule_count >= MQTT_COMM_BATCH_MAX_TOPICS) {
+            ESP_LOGE(TAG, "Per-topic batch table full, cannot add '%s'", topic);
+            ret = ESP_ERR_NO_MEM;
+            goto out;
+        }
+        idx = s_rule_count++;
+        strlcpy(s_rules[idx].topic, topic, sizeof(s_rules[idx].topic));
+    }
+    s_rules[idx].cfg = *cfg;
+
+    // An open batch keeps its old layout; send it so the new window applies cleanly
+    for (int i = 0; i < MQTT_COMM_BATCH_MAX_TOPICS; i++) {
+        if (s_slots[i].buf && strcmp(s_slots[i].topic, topic) == 0) {
+            flush_slot(&s_slots[i]);
+        }
+    }
+    ESP_LOGI(TAG, "Coalescing for '%s': %" PRIu32 " ms / %d bytes", topic, cfg->window_ms, (int)cfg->max_bytes);
+
+out:
+    xSemaphoreGive(s_batch_mutex);
+    return ret;
+}
+
+esp_err_t mqtt_comm_batch_flush(void) {
+    if (!s_batch_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (xSemaphoreTake(s_batch_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        ESP_LOGE(TAG, "Could not obtain batch mutex for flush.");
+        return ESP_FAIL;
+    }
+    esp_err_t result = ESP_OK;
+    for (int i = 0; i < MQTT_COMM_BATCH_MAX_TOPICS; i++) {
+        if (flush_slot(&s_slots[i]) != ESP_OK) {
+            result = ESP_FAIL;
+        }
+    }
+    xSemaphoreGive(s_batch_mutex);
+    return result;
+}
+
+void mqtt_comm_batch_deinit(void) {
+    if (!s_batch_mutex) {
+        return;
+    }
+    if (s_flush_task_handle) {
+        s_flush_stop = true;
+        xTaskNotifyGive(s_flush_task_handle);
+        xSemaphoreTake(s_flush_done, portMAX_DELAY); // Lets a publish in progress finish
+        s_flush_task_handle = NULL;
+        vSemaphoreDelete(s_flush_done);
+        s_flush_done = NULL;
+    }
+    // The client is already stopped at this point, so pending batches are discarded
+    for (int i = 0; i < MQTT_COMM_BATCH_MAX_TOPICS; i++) {
+        free(s_slots[i].buf);
+    }
+    memset(s_slots, 0, sizeof(s_slots));
+    s_rule_count = 0;
+    vSemaphoreDelete(s_batch_mutex);
+    s_batch_mutex = NULL;
+}
\ No newline at end of file
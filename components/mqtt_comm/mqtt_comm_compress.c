@@ -0,0 +1,127 @@
+// components/mqtt_comm/mqtt_comm_compress.c
+// Optional uplink compression stage: large payloads are LZSS-compressed and
+// published under "<topic><suffix>" so subscribers know to decode them.
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lzss.h"
+#include "mqtt_comm_priv.h"
+
+static const char *TAG = "MQTT_COMPRESS";
+
+#define DEFAULT_TOPIC_SUFFIX "/lz"
+
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+} compress_out_t;
+
+static size_t s_min_len = 0;
+static const char *s_topic_suffix = DEFAULT_TOPIC_SUFFIX;
+static SemaphoreHandle_t s_compress_mutex = NULL; // Protects s_encoder and s_stats
+static lzss_encoder_t s_encoder; // Fixed-size state (~600 bytes), kept off the caller's stack
+static mqtt_comm_compress_stats_t s_stats;
+
+static bool write_out(void *ctx, const uint8_t *data, size_t len) {
+    compress_out_t *out = ctx;
+    if (out->len + len > out->cap) {
+        return false; // Output would not be smaller than the input: give up early
+    }
+    memcpy(out->buf + out->len, data, len);
+    out->len += len;
+    return true;
+}
+
+esp_err_t mqtt_comm_compress_init(size_t min_len, const char *topic_suffix) {
+    s_min_len = min_len;
+    s_topic_suffix = topic_suffix ? topic_suffix : DEFAULT_TOPIC_SUFFIX;
+    memset(&s_stats, 0, sizeof(s_stats));
+    if (s_min_len == 0) {
+        return ESP_OK; // Stage disabled, nothing to allocate
+    }
+
+    s_compress_mutex = xSemaphoreCreateMutex();
+    if (s_compress_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create compress mutex");
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Compressing payloads >= %d bytes (topic suffix '%s')", (int)s_min_len, s_topic_suffix);
+    return ESP_OK;
+}
+
+esp_err_t mqtt_comm_compress_publish(const char *topic, const char *data, size_t len,
+                                     int qos, int retain, bool enqueue) {
+    if (!s_compress_mutex || len < s_min_len || len < 2) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    char z_topic[MQTT_COMM_TOPIC_MAX_LEN];
+    int topic_len = snprintf(z_topic, sizeof(z_topic), "%s%s", topic, s_topic_suffix);
+    if (topic_len < 0 || topic_len >= (int)sizeof(z_topic)) {
+        ESP_LOGW(TAG, "Topic '%s' too long for suffix, sending uncompressed", topic);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    // Only worth sending if strictly smaller than the original
+    compress_out_t out = { .buf = malloc(len - 1), .cap = len - 1, .len = 0 };
+    if (!out.buf) {
+        ESP_LOGW(TAG, "No memory for compression buffer (%d bytes)", (int)(len - 1));
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (xSemaphoreTake(s_compress_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        ESP_LOGW(TAG, "Could not obtain compress mutex, sending uncompressed.");
+        free(out.buf);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    lzss_encoder_init(&s_encoder, write_out, &out);
+    bool ok = lzss_encoder_feed(&s_encoder, (const uint8_t *)data, len) &&
+              lzss_encoder_finish(&s_encoder);
+    s_stats.encode_time_us += (uint64_t)(esp_timer_get_time() - start_us);
+    s_stats.attempts++;
+    s_stats.bytes_attempted += len;
+    if (ok) {
+        s_stats.compressed++;
+        s_stats.bytes_in += len;
+        s_stats.bytes_out += out.len;
+    }
+    xSemaphoreGive(s_compress_mutex);
+
+    esp_err_t ret = ESP_ERR_NOT_SUPPORTED;
+    if (ok) {
+        ESP_LOGD(TAG, "'%s': %d -> %d bytes", topic, (int)len, (int)out.len);
+        ret = mqtt_comm_publish_direct(z_topic, out.buf, (int)out.len, qos, retain, enqueue);
+    }
+    free(out.buf);
+    return ret;
+}
+
+esp_err_t mqtt_comm_get_compress_stats(mqtt_comm_compress_stats_t *out) {
+    if (!out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_compress_mutex) {
+        memset(out, 0, sizeof(*out));
+        return ESP_OK;
+    }
+    if (xSemaphoreTake(s_compress_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        return ESP_FAIL;
+    }
+    *out = s_stats;
+    xSemaphoreGive(s_compress_mutex);
+    return ESP_OK;
+}
+
+void mqtt_comm_compress_deinit(void) {
+    if (s_compress_mutex) {
+        vSemaphoreDelete(s_compress_mutex);
+        s_compress_mutex = NULL;
+    }
+    s_min_len = 0;
+}
\ No newline at end of file
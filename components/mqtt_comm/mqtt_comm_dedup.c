@@ -0,0 +1,90 @@
+// components/mqtt_comm/mqtt_comm_dedup.c
+// Optional publish-on-change stage: remembers a 64-bit hash of the last payload
+// sent on each topic and suppresses a publish that repeats it, unless
+// max_quiet_ms has passed since the topic was last sent (heartbeat).
+//
+// Entries hold only hashes (topic and payload), so the table stays small and
+// a lookup costs one pass over the payload plus a short probe under a spinlock.
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mqtt_comm_priv.h"
+
+static const char *TAG = "MQTT_DEDUP";
+
+typedef struct {
+    uint64_t topic_hash;   // 0 = entry unused
+    uint64_t payload_hash;
+    int64_t sent_us;       // Last time this topic was actually published
+} dedup_entry_t;
+
+static dedup_entry_t s_entries[MQTT_COMM_DEDUP_TOPICS];
+static bool s_enabled = false;
+static int64_t s_max_quiet_us = 0;
+static portMUX_TYPE s_dedup_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void mqtt_comm_dedup_init(bool enabled, uint32_t max_quiet_ms) {
+    taskENTER_CRITICAL(&s_dedup_lock);
+    memset(s_entries, 0, sizeof(s_entries));
+    s_enabled = enabled;
+    s_max_quiet_us = (int64_t)max_quiet_ms * 1000;
+    taskEXIT_CRITICAL(&s_dedup_lock);
+    if (enabled) {
+        ESP_LOGI(TAG, "Suppressing repeated payloads (heartbeat every %" PRIu32 " ms)", max_quiet_ms);
+    }
+}
+
+// Must be called with s_dedup_lock held. Returns the entry for the topic, or
+// the slot to use for it (an empty one, else the least recently sent one).
+static dedup_entry_t *lookup_entry(uint64_t topic_hash) {
+    uint32_t start = (uint32_t)(topic_hash % MQTT_COMM_DEDUP_TOPICS);
+    dedup_entry_t *oldest = NULL;
+    for (uint32_t i = 0; i < MQTT_COMM_DEDUP_TOPICS; i++) {
+        dedup_entry_t *entry = &s_entries[(start + i) % MQTT_COMM_DEDUP_TOPICS];
+        if (entry->topic_hash == topic_hash || entry->topic_hash == 0) {
+            return entry; // Entries are never removed, so the probe sequence ends at an empty one
+        }
+        if (!oldest || entry->sent_us < oldest->sent_us) {
+            oldest = entry;
+        }
+    }
+    return oldest;
+}
+
+bool mqtt_comm_dedup_is_duplicate(const char *topic, const char *data, size_t len, mqtt_comm_dedup_key_t *key) {
+    key->topic_hash = 0;
+    if (!s_enabled) {
+        return false;
+    }
+    key->topic_hash = mqtt_comm_hash64(topic, strlen(topic));
+    key->topic_hash = key->topic_hash ? key->topic_hash : 1;
+    key->payload_hash = mqtt_comm_hash64(data, len);
+
+    int64_t now = esp_timer_get_time();
+    bool duplicate = false;
+    taskENTER_CRITICAL(&s_dedup_lock);
+    dedup_entry_t *entry = lookup_entry(key->topic_hash);
+    if (entry->topic_hash == key->topic_hash && entry->payload_hash == key->payload_hash) {
+        duplicate = (s_max_quiet_us == 0 || now - entry->sent_us < s_max_quiet_us);
+    }
+    taskEXIT_CRITICAL(&s_dedup_lock);
+    if (duplicate) {
+        mqtt_comm_stats_on_dedup_suppressed();
+    }
+    return duplicate;
+}
+
+void mqtt_comm_dedup_record(const mqtt_comm_dedup_key_t *key) {
+    if (key->topic_hash == 0) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&s_dedup_lock);
+    dedup_entry_t *entry = lookup_entry(key->topic_hash);
+    entry->topic_hash = key->topic_hash;
+    entry->payload_hash = key->payload_hash;
+    entry->sent_us = now;
+    taskEXIT_CRITICAL(&s_dedup_lock);
+}
\ No newline at end of file
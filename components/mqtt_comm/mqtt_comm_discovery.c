@@ -0,0 +1,271 @@
+// components/mqtt_comm/mqtt_comm_discovery.c
+// Broker address discovery and caching.
+//
+// A background task resolves the configured broker host (regular DNS first;
+// with broker_discovery also mDNS, accepting only an answer for that same host)
+// and points the client URI at the resulting IP address. An mDNS answer for any
+// other host is ignored, so a device on the LAN cannot redirect the client. Reconnects therefore connect straight to the cached
+// address with no lookup on the critical path. The address is also kept in
+// NVS, so the first connect after boot skips the lookup as well. If the cached
+// address stops working, the client falls back to the configured URI and the
+// task looks the broker up again.
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/netdb.h"
+#include "mdns.h"
+#include "mqtt_comm_priv.h"
+
+static const char *TAG = "MQTT_DISCOVERY";
+
+#define HOST_MAX_LEN 64
+#define URI_MAX_LEN 96
+#define MDNS_QUERY_TIMEOUT_MS 2000
+#define MAX_CACHED_FAILURES 3       // Connect failures before the cached address is dropped
+#define RETRY_INTERVAL_MS (30 * 1000) // Next lookup when nothing was found
+#define MAX_TTL_S (24 * 60 * 60)    // Keeps ttl_s * 1000 within 32 bits
+
+static char s_configured_uri[URI_MAX_LEN];
+static char s_scheme[8];            // "mqtt" or "mqtts"
+static char s_host[HOST_MAX_LEN];
+static uint16_t s_port = 0;
+static bool s_use_mdns = false;
+static uint32_t s_ttl_s = 0;
+static bool s_enabled = false;
+
+static esp_mqtt_client_handle_t s_client = NULL;
+static TaskHandle_t s_discovery_task_handle = NULL;
+static uint32_t s_active_ip = 0;    // Address in the client URI, network byte order (0 = configured URI)
+static uint16_t s_active_port = 0;
+static volatile uint32_t s_failures = 0;
+static volatile bool s_stop = false; // Asks the task to exit
+static SemaphoreHandle_t s_task_done = NULL; // Given by the task right before it exits
+static bool s_mdns_owned = false;   // mdns_init() was ours, so mdns_free() is too
+
+// Splits "scheme://host[:port][/...]"; only plain MQTT over TCP or TLS is handled
+static bool parse_uri(const char *uri) {
+    const char *host = strstr(uri, "://");
+    if (!host || (size_t)(host - uri) >= sizeof(s_scheme)) {
+        return false;
+    }
+    memcpy(s_scheme, uri, (size_t)(host - uri));
+    s_scheme[host - uri] = '\0';
+    bool tls = (strcmp(s_scheme, "mqtts") == 0);
+    if (!tls && strcmp(s_scheme, "mqtt") != 0) {
+        return false;
+    }
+
+    host += 3;
+    size_t host_len = strcspn(host, ":/");
+    if (host_len == 0 || host_len >= sizeof(s_host) || strchr(host, '@')) {
+        return false;
+    }
+    memcpy(s_host, host, host_len);
+    s_host[host_len] = '\0';
+    s_port = tls ? 8883 : 1883;
+    if (host[host_len] == ':') {
+        s_port = (uint16_t)atoi(host + host_len + 1);
+    }
+    return strlcpy(s_configured_uri, uri, sizeof(s_configured_uri)) < sizeof(s_configured_uri);
+}
+
+esp_err_t mqtt_comm_discovery_init(const char *uri, bool use_mdns, uint32_t cache_ttl_s) {
+    s_enabled = false;
+    if (!use_mdns && cache_ttl_s == 0) {
+        return ESP_OK;
+    }
+    if (!parse_uri(uri)) {
+        ESP_LOGW(TAG, "Broker URI '%s' not supported for discovery/caching", uri);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    s_use_mdns = use_mdns;
+    s_ttl_s = cache_ttl_s ? cache_ttl_s : 3600;
+    if (s_ttl_s > MAX_TTL_S) {
+        s_ttl_s = MAX_TTL_S;
+    }
+    s_enabled = true;
+    return ESP_OK;
+}
+
+const char *mqtt_comm_discovery_tls_host(void) {
+    return (s_enabled && strcmp(s_scheme, "mqtts") == 0) ? s_host : NULL;
+}
+
+static void apply_address(uint32_t ip, uint16_t port) {
+    char uri[URI_MAX_LEN];
+    const uint8_t *b = (const uint8_t *)&ip;
+    if (ip) {
+        snprintf(uri, sizeof(uri), "%s://%u.%u.%u.%u:%u", s_scheme, b[0], b[1], b[2], b[3], port);
+    } else {
+        strlcpy(uri, s_configured_uri, sizeof(uri));
+    }
+    esp_err_t ret = esp_mqtt_client_set_uri(s_client, uri); // Used from the next connect on
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to set broker URI '%s': %s", uri, esp_err_to_name(ret));
+        return;
+    }
+    s_active_ip = ip;
+    s_active_port = port;
+    s_failures = 0;
+    mqtt_comm_session_save_broker(ip, port);
+    ESP_LOGI(TAG, "Broker address: %s", uri);
+}
+
+// mDNS host names carry no ".local" suffix; the configured host may or may not
+static bool is_configured_host(const char *hostname) {
+    if (!hostname) {
+        return false;
+    }
+    size_t len = strlen(hostname);
+    return strcasecmp(s_host, hostname) == 0 ||
+           (strncasecmp(s_host, hostname, len) == 0 && strcasecmp(s_host + len, ".local") == 0);
+}
+
+static bool lookup_mdns(uint32_t *ip, uint16_t *port, uint32_t *ttl_s) {
+    const char *service = (strcmp(s_scheme, "mqtts") == 0) ? "_secure-mqtt" : "_mqtt";
+    mdns_result_t *results = NULL;
+    if (mdns_query_ptr(service, "_tcp", MDNS_QUERY_TIMEOUT_MS, 4, &results) != ESP_OK) {
+        return false;
+    }
+    bool found = false;
+    for (mdns_result_t *r = results; r && !found; r = r->next) {
+        if (!is_configured_host(r->hostname)) {
+            ESP_LOGD(TAG, "mDNS: ignoring broker on '%s'", r->hostname ? r->hostname : "?");
+            continue;
+        }
+        for (mdns_ip_addr_t *a = r->addr; a; a = a->next) {
+            if (a->addr.type == ESP_IPADDR_TYPE_V4 && a->addr.u_addr.ip4.addr != 0) {
+                *ip = a->addr.u_addr.ip4.addr;
+                *port = r->port;
+                if (r->ttl > 0 && r->ttl < *ttl_s) {
+                    *ttl_s = r->ttl;
+                }
+                ESP_LOGI(TAG, "mDNS: broker '%s' found on %s", r->instance_name ? r->instance_name : "?", r->hostname);
+                found = true;
+                break;
+            }
+        }
+    }
+    mdns_query_results_free(results);
+    return found;
+}
+
+static bool lookup_dns(uint32_t *ip, uint16_t *port) {
+    const struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(s_host, NULL, &hints, &res) != 0 || !res) {
+        return false;
+    }
+    *ip = ((struct sockaddr_in *)res->ai_addr)->sin_addr.s_addr;
+    *port = s_port;
+    freeaddrinfo(res);
+    return true;
+}
+
+static void discovery_task(void *pvParameters) {
+    if (s_use_mdns) {
+        esp_err_t ret = mdns_init();
+        s_mdns_owned = (ret == ESP_OK);
+        if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) { // INVALID_STATE: already running
+            ESP_LOGW(TAG, "mdns_init failed: %s, using DNS only", esp_err_to_name(ret));
+            s_use_mdns = false;
+        }
+    }
+
+    while (!s_stop) {
+        if (s_active_ip && s_failures >= MAX_CACHED_FAILURES) {
+            ESP_LOGW(TAG, "Cached broker address failed %d times, reverting to '%s'", MAX_CACHED_FAILURES, s_configured_uri);
+            apply_address(0, 0);
+        }
+
+        uint32_t ip = 0;
+        uint16_t port = 0;
+        uint32_t ttl_s = s_ttl_s;
+        int64_t start_us = esp_timer_get_time();
+        // The configured host through DNS first; mDNS only if DNS cannot resolve it
+        bool found = lookup_dns(&ip, &port) || (s_use_mdns && lookup_mdns(&ip, &port, &ttl_s));
+        ESP_LOGD(TAG, "Lookup took %" PRId64 " ms", (esp_timer_get_time() - start_us) / 1000);
+        if (s_stop) {
+            break; // The client may be gone already
+        }
+
+        if (found && (ip != s_active_ip || port != s_active_port)) {
+            apply_address(ip, port);
+        } else if (!found) {
+            ESP_LOGW(TAG, "Broker lookup failed, retrying in %d s", RETRY_INTERVAL_MS / 1000);
+        }
+        // Refresh when the entry expires, or earlier if the address stops working
+        ulTaskNotifyTake(pdTRUE, found ? pdMS_TO_TICKS(ttl_s * 1000) : pdMS_TO_TICKS(RETRY_INTERVAL_MS));
+    }
+
+    if (s_mdns_owned) {
+        mdns_free();
+        s_mdns_owned = false;
+    }
+    xSemaphoreGive(s_task_done);
+    vTaskDelete(NULL);
+}
+
+esp_err_t mqtt_comm_discovery_start(esp_mqtt_client_handle_t client) {
+    if (!s_enabled) {
+        return ESP_OK;
+    }
+    s_client = client;
+    s_active_ip = 0;
+    s_active_port = 0;
+    s_failures = 0;
+    s_stop = false;
+
+    uint32_t ip = 0;
+    uint16_t port = 0;
+    if (mqtt_comm_session_load_broker(&ip, &port) == ESP_OK && ip != 0) {
+        apply_address(ip, port); // First connect uses the stored address, checked by the task
+    }
+
+    s_task_done = xSemaphoreCreateBinary();
+    if (!s_task_done ||
+        xTaskCreate(discovery_task, "mqtt_discovery", 4096, NULL, 5, &s_discovery_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create discovery task");
+        if (s_task_done) {
+            vSemaphoreDelete(s_task_done);
+            s_task_done = NULL;
+        }
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+void mqtt_comm_discovery_on_connected(void) {
+    s_failures = 0;
+}
+
+void mqtt_comm_discovery_on_disconnected(void) {
+    if (s_discovery_task_handle && s_active_ip && ++s_failures >= MAX_CACHED_FAILURES) {
+        xTaskNotifyGive(s_discovery_task_handle);
+    }
+}
+
+void mqtt_comm_discovery_deinit(void) {
+    if (s_discovery_task_handle) {
+        // Let the task finish a lookup in progress (mdns_query_ptr, getaddrinfo)
+        // instead of deleting it while it holds their locks or memory
+        s_stop = true;
+        xTaskNotifyGive(s_discovery_task_handle);
+        xSemaphoreTake(s_task_done, portMAX_DELAY);
+        s_discovery_task_handle = NULL;
+        vSemaphoreDelete(s_task_done);
+        s_task_done = NULL;
+    }
+    s_client = NULL;
+    s_enabled = false;
+}
\ No newline at end of file
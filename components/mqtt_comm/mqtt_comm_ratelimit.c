@@ -0,0 +1,411 @@
+// components/mqtt_comm/mqtt_comm_ratelimit.c
+// Optional rate-limiting stage at the head of the publish path.
+//
+// Token buckets (rate tokens/s, burst tokens, one token per message) are kept
+// per topic and for the whole client. A message needs a token from both. The
+// per-topic buckets live in a small open-addressing table keyed by the topic
+// hash; when it is full, the least recently used idle entry is recycled.
+// A message over its limit is dropped, delayed (the calling task waits up to
+// max_delay_ms) or, with coalesce-latest, parked as the newest value of its
+// topic and sent by the release task as soon as a token is available and the
+// client is connected. Only QoS 0 messages are coalesced: replacing a QoS 1
+// message would lose it after the caller was told it was accepted, so QoS 1
+// messages over the limit are delayed instead.
+// While the client is offline no tokens are spent: messages pass through to
+// the publish path (which reports the failure) and parked ones stay parked.
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "metrics.h"
+#include "mqtt_comm_priv.h"
+
+static const char *TAG = "MQTT_RATE";
+
+#define MILLI_TOKENS 1000 // Token counts are kept in 1/1000 token for exact refills
+
+typedef struct {
+    uint32_t milli;      // Tokens available, in 1/1000
+    int64_t refill_us;   // Time of the last refill
+} bucket_t;
+
+typedef struct {
+    char topic[MQTT_COMM_TOPIC_MAX_LEN]; // Empty = slot unused
+    uint32_t hash;
+    bucket_t bucket;
+    int64_t last_used_us;
+    char *pending;       // Coalesce-latest: newest message waiting for a token (NULL if none)
+    size_t pending_len;
+    int pending_qos;
+    int pending_retain;
+    uint32_t pending_flags;
+    mqtt_comm_dedup_key_t pending_dedup; // Recorded once the parked message is published
+} rate_slot_t;
+
+static mqtt_comm_rate_limit_config_t s_config;
+static bool s_enabled = false;
+static rate_slot_t s_slots[MQTT_COMM_RATE_TOPICS];
+static bucket_t s_global;
+static mqtt_comm_rate_stats_t s_stats;
+static SemaphoreHandle_t s_rate_mutex = NULL; // Protects the slots, s_global and s_stats
+static TaskHandle_t s_release_task_handle = NULL;
+static SemaphoreHandle_t s_release_done = NULL; // Given by the release task right before it exits
+static volatile bool s_release_stop = false;
+
+static metric_t *s_m_passed;
+static metric_t *s_m_coalesced;
+static metric_t *s_m_replaced;
+static metric_t *s_m_dropped;
+
+static void bucket_reset(bucket_t *b, uint32_t burst, int64_t now) {
+    b->milli = burst * MILLI_TOKENS;
+    b->refill_us = now;
+}
+
+static void bucket_refill(bucket_t *b, uint32_t rate, uint32_t burst, int64_t now) {
+    // rate tokens/s = rate milli-tokens/ms; whole milliseconds only, so no fraction is lost
+    int64_t elapsed_ms = (now - b->refill_us) / 1000;
+    if (elapsed_ms <= 0) {
+        return;
+    }
+    uint64_t milli = b->milli + (uint64_t)elapsed_ms * rate;
+    uint64_t cap = (uint64_t)burst * MILLI_TOKENS;
+    b->milli = (uint32_t)(milli > cap ? cap : milli);
+    b->refill_us += elapsed_ms * 1000;
+}
+
+// Time until the bucket holds a whole token (0 = now)
+static int64_t bucket_wait_us(const bucket_t *b, uint32_t rate) {
+    if (rate == 0 || b->milli >= MILLI_TOKENS) {
+        return 0;
+    }
+    return (int64_t)(MILLI_TOKENS - b->milli) * 1000 / rate + 1000;
+}
+
+// Must be called with s_rate_mutex held. Returns NULL if all slots hold pending messages.
+static rate_slot_t *lookup_slot(const char *topic, uint32_t hash, int64_t now) {
+    uint32_t start = hash % MQTT_COMM_RATE_TOPICS;
+    rate_slot_t *victim = NULL;
+    for (uint32_t i = 0; i < MQTT_COMM_RATE_TOPICS; i++) {
+        rate_slot_t *slot = &s_slots[(start + i) % MQTT_COMM_RATE_TOPICS];
+        if (slot->topic[0] == '\0') {
+            victim = slot; // Topics are never removed, so the probe sequence ends here
+            break;
+        }
+        if (slot->hash == hash && strcmp(slot->topic, topic) == 0) {
+            return slot;
+        }
+        if (!slot->pending && (!victim || slot->last_used_us < victim->last_used_us)) {
+            victim = slot;
+        }
+    }
+    if (!victim) {
+        return NULL;
+    }
+    if (victim->topic[0] != '\0') {
+        s_stats.evicted++;
+    }
+    strlcpy(victim->topic, topic, sizeof(victim->topic));
+    victim->hash = hash;
+    bucket_reset(&victim->bucket, s_config.topic_burst, now);
+    return victim;
+}
+
+// Must be called with s_rate_mutex held. Time until both buckets allow a message.
+static int64_t wait_us(rate_slot_t *slot, int64_t now) {
+    int64_t wait = 0;
+    if (s_config.global_rate) {
+        bucket_refill(&s_global, s_config.global_rate, s_config.global_burst, now);
+        wait = bucket_wait_us(&s_global, s_config.global_rate);
+    }
+    if (slot && s_config.topic_rate) {
+        bucket_refill(&slot->bucket, s_config.topic_rate, s_config.topic_burst, now);
+        int64_t topic_wait = bucket_wait_us(&slot->bucket, s_config.topic_rate);
+        wait = topic_wait > wait ? topic_wait : wait;
+    }
+    return wait;
+}
+
+// Must be called with s_rate_mutex held, after wait_us() returned 0
+static void take_token(rate_slot_t *slot) {
+    if (s_config.global_rate) {
+        s_global.milli -= MILLI_TOKENS;
+    }
+    if (slot && s_config.topic_rate) {
+        slot->bucket.milli -= MILLI_TOKENS;
+    }
+}
+
+// Must be called with s_rate_mutex held. Wakes the release task to re-plan.
+static void wake_release_task(void) {
+    if (s_release_task_handle) {
+        xTaskNotifyGive(s_release_task_handle);
+    }
+}
+
+// Must be called with s_rate_mutex held. Detaches one parked message that may go
+// now, charging its tokens. Returns the time until the next one is due otherwise
+// (INT64_MAX if nothing is parked).
+static int64_t take_due(int64_t now, char *topic, char **data, size_t *len, int *qos, int *retain, uint32_t *flags,
+                        mqtt_comm_dedup_key_t *dedup) {
+    int64_t earliest = INT64_MAX;
+    for (int i = 0; i < MQTT_COMM_RATE_TOPICS; i++) {
+        rate_slot_t *slot = &s_slots[i];
+        if (!slot->pending) {
+            continue;
+        }
+        int64_t wait = wait_us(slot, now);
+        if (wait > 0) {
+            earliest = wait < earliest ? wait : earliest;
+            continue;
+        }
+        take_token(slot);
+        s_stats.passed++;
+        metrics_inc(s_m_passed);
+        strlcpy(topic, slot->topic, MQTT_COMM_TOPIC_MAX_LEN);
+        *data = slot->pending;
+        *len = slot->pending_len;
+        *qos = slot->pending_qos;
+        *retain = slot->pending_retain;
+        *flags = slot->pending_flags;
+        *dedup = slot->pending_dedup;
+        slot->pending = NULL;
+        return 0;
+    }
+    return earliest;
+}
+
+// Sends parked messages as their tokens come in. The publish happens outside
+// the mutex, so offers are never held up by the network.
+static void release_task(void *pvParameters) {
+    char topic[MQTT_COMM_TOPIC_MAX_LEN];
+    while (!s_release_stop) {
+        int64_t wait = INT64_MAX;
+        char *data = NULL;
+        size_t len = 0;
+        int qos = 0;
+        int retain = 0;
+        uint32_t flags = 0;
+        mqtt_comm_dedup_key_t dedup = { 0 };
+        if (mqtt_comm_connected_nowait()) { // Offline: keep everything parked, spend no tokens
+            xSemaphoreTake(s_rate_mutex, portMAX_DELAY);
+            wait = take_due(esp_timer_get_time(), topic, &data, &len, &qos, &retain, &flags, &dedup);
+            xSemaphoreGive(s_rate_mutex);
+        }
+        if (data) {
+            esp_err_t ret = mqtt_comm_publish_final(topic, data, len, qos, retain, flags, false);
+            if (ret == ESP_OK) {
+                mqtt_comm_dedup_record(&dedup);
+            } else {
+                ESP_LOGW(TAG, "Dropping coalesced message for '%s'", topic);
+            }
+            free(data);
+            continue;
+        }
+        // Sleep until the next token, a new parked message or a (re)connect
+        TickType_t ticks = wait == INT64_MAX ? portMAX_DELAY : pdMS_TO_TICKS(wait / 1000);
+        ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1);
+    }
+    xSemaphoreGive(s_release_done);
+    vTaskDelete(NULL);
+}
+
+// Metrics reader: must not block, so the slots are scanned without the mutex
+static int32_t read_pending(void *ctx) {
+    int32_t pending = 0;
+    for (int i = 0; i < MQTT_COMM_RATE_TOPICS; i++) {
+        pending += s_slots[i].pending ? 1 : 0;
+    }
+    return pending;
+}
+
+void mqtt_comm_ratelimit_on_connected(void) {
+    if (s_release_task_handle) {
+        xTaskNotifyGive(s_release_task_handle); // Parked messages can go now
+    }
+}
+
+esp_err_t mqtt_comm_ratelimit_init(const mqtt_comm_rate_limit_config_t *config) {
+    s_config = *config;
+    s_enabled = (config->topic_rate > 0 || config->global_rate > 0);
+    if (!s_enabled) {
+        return ESP_OK;
+    }
+    if (s_config.topic_burst == 0) {
+        s_config.topic_burst = s_config.topic_rate;
+    }
+    if (s_config.global_burst == 0) {
+        s_config.global_burst = s_config.global_rate;
+    }
+    memset(s_slots, 0, sizeof(s_slots));
+    memset(&s_stats, 0, sizeof(s_stats));
+    bucket_reset(&s_global, s_config.global_burst, esp_timer_get_time());
+
+    s_rate_mutex = xSemaphoreCreateMutex();
+    if (s_rate_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create rate limiter mutex");
+        return ESP_FAIL;
+    }
+    if (s_config.policy == MQTT_COMM_RATE_POLICY_COALESCE) {
+        s_release_stop = false;
+        s_release_done = xSemaphoreCreateBinary();
+        if (!s_release_done ||
+            xTaskCreate(release_task, "mqtt_rate", 3072, NULL, 5, &s_release_task_handle) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create rate limiter release task");
+            if (s_release_done) {
+                vSemaphoreDelete(s_release_done);
+                s_release_done = NULL;
+            }
+            vSemaphoreDelete(s_rate_mutex);
+            s_rate_mutex = NULL;
+            return ESP_FAIL;
+        }
+    }
+    s_m_passed = metrics_counter("mqtt.rate_passed");
+    s_m_coalesced = metrics_counter("mqtt.rate_coalesced");
+    s_m_replaced = metrics_counter("mqtt.rate_replaced");
+    s_m_dropped = metrics_counter("mqtt.rate_dropped");
+    metrics_gauge_fn("mqtt.rate_pending", read_pending, NULL);
+    ESP_LOGI(TAG, "Rate limit: %" PRIu32 "/s (burst %" PRIu32 ") per topic, %" PRIu32 "/s (burst %" PRIu32 ") total, policy %d",
+             s_config.topic_rate, s_config.topic_burst, s_config.global_rate, s_config.global_burst, s_config.policy);
+    return ESP_OK;
+}
+
+esp_err_t mqtt_comm_ratelimit_offer(const char *topic, const char *data, size_t len, int qos, int retain, uint32_t flags,
+                                    const mqtt_comm_dedup_key_t *key) {
+    if (!s_enabled || !s_rate_mutex) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    // Not mqtt_comm_is_connected(): under load its mutex is busy and it would report
+    // offline, letting the flood through unlimited
+    if (!mqtt_comm_connected_nowait()) {
+        return ESP_ERR_NOT_SUPPORTED; // Would fail anyway: no token is spent on it
+    }
+    if (xSemaphoreTake(s_rate_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        // Fail closed: publishing unchecked would defeat the limiter
+        ESP_LOGW(TAG, "Could not obtain rate limiter mutex, dropping message for '%s'", topic);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    esp_err_t ret = ESP_ERR_NOT_SUPPORTED;
+    bool coalesce = (s_config.policy == MQTT_COMM_RATE_POLICY_COALESCE && qos == 0);
+    bool delay = (s_config.policy == MQTT_COMM_RATE_POLICY_DELAY ||
+                  (s_config.policy == MQTT_COMM_RATE_POLICY_COALESCE && qos > 0));
+    int64_t now = esp_timer_get_time();
+    int64_t deadline = now + (int64_t)s_config.max_delay_ms * 1000;
+    // Topics too long for the table share the global bucket only
+    rate_slot_t *slot = (strlen(topic) < MQTT_COMM_TOPIC_MAX_LEN) ?
+                        lookup_slot(topic, mqtt_comm_hash32(topic, strlen(topic)), now) : NULL;
+    if (slot) {
+        slot->last_used_us = now;
+    }
+
+    int64_t wait = wait_us(slot, now);
+    if (wait > 0 && delay && now + wait <= deadline) {
+        s_stats.delayed++;
+        while (wait > 0 && now + wait <= deadline) {
+            xSemaphoreGive(s_rate_mutex);
+            vTaskDelay(pdMS_TO_TICKS(wait / 1000) > 0 ? pdMS_TO_TICKS(wait / 1000) : 1);
+            xSemaphoreTake(s_rate_mutex, portMAX_DELAY);
+            now = esp_timer_get_time();
+            // The slot may have been recycled for another topic meanwhile
+            slot = slot && strcmp(slot->topic, topic) == 0 ? slot : NULL;
+            wait = wait_us(slot, now);
+        }
+    }
+
+    if (wait == 0 && !(slot && slot->pending && coalesce)) {
+        if (slot && slot->pending) {
+            // A QoS 1 message supersedes the parked QoS 0 value, which would arrive after it
+            free(slot->pending);
+            slot->pending = NULL;
+            s_stats.replaced++;
+            metrics_inc(s_m_replaced);
+        }
+        take_token(slot);
+        s_stats.passed++;
+        metrics_inc(s_m_passed);
+        goto out; // Caller publishes (ESP_ERR_NOT_SUPPORTED)
+    }
+
+    if (coalesce && slot) {
+        char *copy = malloc(len > 0 ? len : 1);
+        if (!copy) {
+            s_stats.dropped++;
+            metrics_inc(s_m_dropped);
+            ret = ESP_ERR_NO_MEM;
+            goto out;
+        }
+        memcpy(copy, data, len);
+        if (slot->pending) {
+            free(slot->pending);
+            s_stats.replaced++; // The previous value was never sent
+            metrics_inc(s_m_replaced);
+        } else {
+            s_stats.coalesced++;
+            metrics_inc(s_m_coalesced);
+        }
+        slot->pending = copy;
+        slot->pending_len = len;
+        slot->pending_qos = qos;
+        slot->pending_retain = retain;
+        slot->pending_flags = flags;
+        slot->pending_dedup = *key;
+        wake_release_task();
+        ret = ESP_OK;
+        goto out;
+    }
+
+    s_stats.dropped++;
+    metrics_inc(s_m_dropped);
+    ESP_LOGD(TAG, "Rate limit exceeded, dropping message for '%s'", topic);
+    ret = ESP_ERR_NOT_ALLOWED;
+
+out:
+    xSemaphoreGive(s_rate_mutex);
+    return ret;
+}
+
+esp_err_t mqtt_comm_get_rate_stats(mqtt_comm_rate_stats_t *out) {
+    if (!out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_rate_mutex) {
+        memset(out, 0, sizeof(*out));
+        return ESP_OK;
+    }
+    if (xSemaphoreTake(s_rate_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        return ESP_FAIL;
+    }
+    *out = s_stats;
+    out->pending = 0;
+    for (int i = 0; i < MQTT_COMM_RATE_TOPICS; i++) {
+        out->pending += s_slots[i].pending ? 1 : 0;
+    }
+    xSemaphoreGive(s_rate_mutex);
+    return ESP_OK;
+}
+
+void mqtt_comm_ratelimit_deinit(void) {
+    if (s_release_task_handle) {
+        s_release_stop = true;
+        xTaskNotifyGive(s_release_task_handle);
+        xSemaphoreTake(s_release_done, portMAX_DELAY); // Lets a publish in progress finish
+        s_release_task_handle = NULL;
+        vSemaphoreDelete(s_release_done);
+        s_release_done = NULL;
+    }
+    if (s_rate_mutex) {
+        vSemaphoreDelete(s_rate_mutex);
+        s_rate_mutex = NULL;
+    }
+    for (int i = 0; i < MQTT_COMM_RATE_TOPICS; i++) {
+        free(s_slots[i].pending);
+        s_slots[i].pending = NULL;
+    }
+    s_enabled = false;
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+// components/mqtt_comm/mqtt_comm_reconnect.c
+// Reconnect policy replacing esp-mqtt's fixed reconnect_timeout_ms.
+//
+// Delays follow "full jitter" exponential backoff: after the n-th consecutive
+// failure the next attempt is made after random(0, min(max, base * 2^n)).
+// Devices that lost the broker at the same moment therefore spread their
+// attempts over the whole window instead of reconnecting in lockstep.
+// When the network comes back (GOT_IP) the backoff is reset and the client
+// reconnects at once, since the previous failures were not the broker's.
+// The delay math lives in mqtt_comm_backoff.h; host_sim/ replays a reconnect
+// storm with it.
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "mqtt_comm_priv.h"
+#include "mqtt_comm_backoff.h"
+
+static const char *TAG = "MQTT_RECONNECT";
+
+static esp_timer_handle_t s_reconnect_timer = NULL;
+static esp_mqtt_client_handle_t s_client = NULL;
+static uint32_t s_base_ms = 0;
+static uint32_t s_max_ms = 0;
+static uint32_t s_attempt = 0; // Consecutive failed attempts
+static portMUX_TYPE s_reconnect_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void reconnect_timer_cb(void *arg) {
+    ESP_LOGI(TAG, "Reconnecting (attempt %" PRIu32 ")", s_attempt + 1);
+    esp_err_t ret = esp_mqtt_client_reconnect(s_client);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "esp_mqtt_client_reconnect failed: %s", esp_err_to_name(ret));
+    }
+}
+
+esp_err_t mqtt_comm_reconnect_init(esp_mqtt_client_handle_t client, uint32_t base_ms, uint32_t max_ms) {
+    s_client = client;
+    s_base_ms = base_ms;
+    s_max_ms = max_ms > base_ms ? max_ms : base_ms;
+    s_attempt = 0;
+    if (base_ms == 0) {
+        return ESP_OK; // esp-mqtt's own fixed-interval reconnect is used
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = reconnect_timer_cb,
+        .name = "mqtt_reconnect",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &s_reconnect_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create reconnect timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ESP_LOGI(TAG, "Reconnect backoff %" PRIu32 "..%" PRIu32 " ms with full jitter", s_base_ms, s_max_ms);
+    return ESP_OK;
+}
+
+void mqtt_comm_reconnect_on_connected(void) {
+    taskENTER_CRITICAL(&s_reconnect_lock);
+    s_attempt = 0;
+    taskEXIT_CRITICAL(&s_reconnect_lock);
+}
+
+void mqtt_comm_reconnect_on_disconnected(void) {
+    if (!s_reconnect_timer || esp_timer_is_active(s_reconnect_timer)) {
+        return;
+    }
+    taskENTER_CRITICAL(&s_reconnect_lock);
+    uint32_t attempt = s_attempt++;
+    taskEXIT_CRITICAL(&s_reconnect_lock);
+
+    uint32_t delay_ms = mqtt_comm_backoff_delay_ms(s_base_ms, s_max_ms, attempt, esp_random());
+    ESP_LOGI(TAG, "Next attempt in %" PRIu32 " ms (window %" PRIu32 " ms)", delay_ms,
+             mqtt_comm_backoff_window_ms(s_base_ms, s_max_ms, attempt));
+    esp_timer_start_once(s_reconnect_timer, (uint64_t)delay_ms * 1000);
+}
+
+void mqtt_comm_reconnect_now(void) {
+    if (!s_reconnect_timer) {
+        return;
+    }
+    taskENTER_CRITICAL(&s_reconnect_lock);
+    s_attempt = 0;
+    taskEXIT_CRITICAL(&s_reconnect_lock);
+    // Through the timer, so the reconnect always runs in the same context
+    esp_timer_stop(s_reconnect_timer);
+    esp_timer_start_once(s_reconnect_timer, 0);
+}
+
+void mqtt_comm_reconnect_deinit(void) {
+    if (s_reconnect_timer) {
+        esp_timer_stop(s_reconnect_timer);
+        esp_timer_delete(s_reconnect_timer);
+        s_reconnect_timer = NULL;
+    }
+    s_client = NULL;
+    s_base_ms = 0;
+}
\ No newline at end of file
@@ -0,0 +1,328 @@
+// components/mqtt_comm/mqtt_comm_router.c
+// Subscription registry and incoming-message router.
+//
+// Route filters are stored as a topic trie with one node per filter level.
+// Literal children are found through a single hash table keyed by
+// (parent node, level), '+' and '#' children hang directly off their parent.
+// Matching a topic therefore costs O(levels) table lookups, independent of
+// the number of routes. The registry is built once in mqtt_comm_init() and is
+// read-only afterwards, so the MQTT task can match without locking.
+//
+// The route filters double as the subscription table: after CONNACK all
+// filters the session does not already hold go out in one SUBSCRIBE packet.
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "mqtt_client.h"
+#include "mqtt_comm_priv.h"
+
+static const char *TAG = "MQTT_ROUTER";
+
+#define NO_INDEX -1
+#define CHILD_SLOTS (2 * MQTT_COMM_ROUTE_MAX_NODES) // Load factor <= 0.5
+#define MAX_MATCH_DEPTH 32
+
+typedef struct {
+    const char *level;   // Points into the owning route's filter copy
+    uint16_t level_len;
+    int16_t plus_child;  // '+' child node
+    int16_t hash_child;  // '#' child node
+    int16_t first_route; // Routes whose filter ends at this node
+} trie_node_t;
+
+typedef struct {
+    int16_t parent;
+    int16_t child;       // NO_INDEX = empty slot
+    uint32_t hash;
+} child_slot_t;
+
+typedef struct {
+    char *filter;
+    int qos;
+    mqtt_comm_route_handler_t handler;
+    void *ctx;
+    int16_t next;        // Next route ending at the same node
+    bool subscribed;     // Acknowledged by the broker in the current session
+} route_entry_t;
+
+static trie_node_t s_nodes[MQTT_COMM_ROUTE_MAX_NODES];
+static int s_node_count = 0;
+static child_slot_t s_children[CHILD_SLOTS];
+static route_entry_t s_routes[MQTT_COMM_ROUTE_MAX];
+static int s_route_count = 0;
+
+// Outstanding SUBSCRIBE (MQTT task only)
+static int s_sub_msg_id = -1;
+static int16_t s_sub_routes[MQTT_COMM_ROUTE_MAX]; // Route index of each topic in the packet
+static int s_sub_count = 0;
+
+static int16_t new_node(const char *level, uint16_t level_len) {
+    if (s_node_count >= MQTT_COMM_ROUTE_MAX_NODES) {
+        return NO_INDEX;
+    }
+    trie_node_t *node = &s_nodes[s_node_count];
+    node->level = level;
+    node->level_len = level_len;
+    node->plus_child = NO_INDEX;
+    node->hash_child = NO_INDEX;
+    node->first_route = NO_INDEX;
+    return (int16_t)s_node_count++;
+}
+
+static uint32_t child_hash(int16_t parent, const char *level, size_t level_len) {
+    return mqtt_comm_hash32(level, level_len) ^ ((uint32_t)parent * 0x9E3779B1u);
+}
+
+// Finds the literal child of `parent` for `level`, creating it if requested.
+static int16_t literal_child(int16_t parent, const char *level, size_t level_len, bool create) {
+    uint32_t hash = child_hash(parent, level, level_len);
+    for (uint32_t probe = 0; probe < CHILD_SLOTS; probe++) {
+        child_slot_t *slot = &s_children[(hash + probe) % CHILD_SLOTS];
+        if (slot->child == NO_INDEX) {
+            if (!create) {
+                return NO_INDEX;
+            }
+            int16_t child = new_node(level, (uint16_t)level_len);
+            if (child != NO_INDEX) {
+                slot->parent = parent;
+                slot->child = child;
+                slot->hash = hash;
+            }
+            return child;
+        }
+        const trie_node_t *node = &s_nodes[slot->child];
+        if (slot->hash == hash && slot->parent == parent &&
+            node->level_len == level_len && memcmp(node->level, level, level_len) == 0) {
+            return slot->child;
+        }
+    }
+    return NO_INDEX;
+}
+
+static bool filter_is_valid(const char *filter) {
+    size_t len = strlen(filter);
+    if (len == 0 || len >= MQTT_COMM_TOPIC_MAX_LEN) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        bool level_start = (i == 0 || filter[i - 1] == '/');
+        bool level_end = (i + 1 == len || filter[i + 1] == '/');
+        if (filter[i] == '+' && !(level_start && level_end)) {
+            return false;
+        }
+        if (filter[i] == '#' && !(level_start && i + 1 == len)) {
+            return false; // '#' must be a whole, final level
+        }
+    }
+    return true;
+}
+
+static esp_err_t add_route(const mqtt_comm_route_t *route) {
+    if (!route->filter || !route->handler || !filter_is_valid(route->filter)) {
+        ESP_LOGE(TAG, "Invalid route filter '%s'", route->filter ? route->filter : "(null)");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_route_count >= MQTT_COMM_ROUTE_MAX) {
+        ESP_LOGE(TAG, "Route table full (%d)", MQTT_COMM_ROUTE_MAX);
+        return ESP_ERR_NO_MEM;
+    }
+
+    route_entry_t *entry = &s_routes[s_route_count];
+    entry->filter = strdup(route->filter);
+    if (!entry->filter) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    int16_t node = 0; // Root
+    const char *level = entry->filter;
+    while (node != NO_INDEX) {
+        const char *slash = strchr(level, '/');
+        size_t level_len = slash ? (size_t)(slash - level) : strlen(level);
+        int16_t *wild = NULL;
+        if (level_len == 1 && level[0] == '+') {
+            wild = &s_nodes[node].plus_child;
+        } else if (level_len == 1 && level[0] == '#') {
+            wild = &s_nodes[node].hash_child;
+        }
+        if (wild) {
+            if (*wild == NO_INDEX) {
+                *wild = new_node(level, 1);
+            }
+            node = *wild;
+        } else {
+            node = literal_child(node, level, level_len, true);
+        }
+        if (!slash) {
+            break;
+        }
+        level = slash + 1;
+    }
+    if (node == NO_INDEX) {
+        ESP_LOGE(TAG, "Out of trie nodes (%d) for '%s'", MQTT_COMM_ROUTE_MAX_NODES, entry->filter);
+        free(entry->filter);
+        entry->filter = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    entry->qos = route->qos;
+    entry->handler = route->handler;
+    entry->ctx = route->ctx;
+    entry->subscribed = false;
+    entry->next = s_nodes[node].first_route;
+    s_nodes[node].first_route = (int16_t)s_route_count++;
+    ESP_LOGI(TAG, "Route added: '%s' (QoS %d)", entry->filter, entry->qos);
+    return ESP_OK;
+}
+
+esp_err_t mqtt_comm_router_init(const mqtt_comm_route_t *routes, size_t route_count) {
+    s_node_count = 0;
+    s_route_count = 0;
+    for (int i = 0; i < CHILD_SLOTS; i++) {
+        s_children[i].child = NO_INDEX;
+    }
+    new_node("", 0); // Root
+
+    for (size_t i = 0; i < route_count; i++) {
+        esp_err_t ret = add_route(&routes[i]);
+        if (ret != ESP_OK) {
+            mqtt_comm_router_deinit();
+            return ret;
+        }
+    }
+    return ESP_OK;
+}
+
+static int deliver_node(int16_t node, const mqtt_comm_message_t *msg) {
+    int delivered = 0;
+    for (int16_t r = s_nodes[node].first_route; r != NO_INDEX; r = s_routes[r].next) {
+        s_routes[r].handler(msg, s_routes[r].ctx);
+        delivered++;
+    }
+    return delivered;
+}
+
+// `level` is the start of the remaining topic levels, `end` one past the topic.
+static int match(int16_t node, const char *level, const char *end, int depth,
+                 const mqtt_comm_message_t *msg) {
+    int delivered = 0;
+    const trie_node_t *n = &s_nodes[node];
+
+    // '#' matches the remaining levels, including none ("a/#" matches "a")
+    // Topics starting with '$' are not matched by a leading wildcard.
+    bool wildcards_ok = !(depth == 0 && level < end && level[0] == '$');
+    if (n->hash_child != NO_INDEX && wildcards_ok) {
+        delivered += deliver_node(n->hash_child, msg);
+    }
+    if (level == NULL) {
+        return delivered + deliver_node(node, msg);
+    }
+    if (depth >= MAX_MATCH_DEPTH) {
+        return delivered;
+    }
+
+    const char *slash = memchr(level, '/', (size_t)(end - level));
+    size_t level_len = slash ? (size_t)(slash - level) : (size_t)(end - level);
+    const char *next = slash ? slash + 1 : NULL;
+
+    int16_t child = literal_child(node, level, level_len, false);
+    if (child != NO_INDEX) {
+        delivered += match(child, next, end, depth + 1, msg);
+    }
+    if (n->plus_child != NO_INDEX && wildcards_ok) {
+        delivered += match(n->plus_child, next, end, depth + 1, msg);
+    }
+    return delivered;
+}
+
+int mqtt_comm_router_dispatch(const mqtt_comm_message_t *msg) {
+    if (s_route_count == 0 || !msg->topic) {
+        return 0;
+    }
+    return match(0, msg->topic, msg->topic + msg->topic_len, 0, msg);
+}
+
+int mqtt_comm_router_subscribe_all(esp_mqtt_client_handle_t client, bool session_present) {
+    esp_mqtt_topic_t topics[MQTT_COMM_ROUTE_MAX];
+    s_sub_count = 0;
+    s_sub_msg_id = -1;
+    for (int i = 0; i < s_route_count; i++) {
+        if (!session_present) {
+            s_routes[i].subscribed = false; // Clean session: the broker forgot everything
+        }
+        if (s_routes[i].subscribed) {
+            continue; // Still held by the resumed session
+        }
+        topics[s_sub_count].filter = s_routes[i].filter;
+        topics[s_sub_count].qos = s_routes[i].qos;
+        s_sub_routes[s_sub_count] = (int16_t)i;
+        s_sub_count++;
+    }
+    if (s_sub_count == 0) {
+        ESP_LOGI(TAG, "All %d subscriptions held by the session", s_route_count);
+        return 0;
+    }
+
+    s_sub_msg_id = esp_mqtt_client_subscribe_multiple(client, topics, s_sub_count);
+    if (s_sub_msg_id < 0) {
+        ESP_LOGE(TAG, "Failed to queue SUBSCRIBE for %d topics", s_sub_count);
+        s_sub_count = 0;
+        return -1;
+    }
+    ESP_LOGI(TAG, "SUBSCRIBE for %d of %d topics queued, msg_id=%d", s_sub_count, s_route_count, s_sub_msg_id);
+    return s_sub_msg_id;
+}
+
+uint32_t mqtt_comm_router_table_hash(void) {
+    uint32_t hash = 0;
+    for (int i = 0; i < s_route_count; i++) {
+        char qos = (char)('0' + s_routes[i].qos);
+        hash = hash * 31 + mqtt_comm_hash32(s_routes[i].filter, strlen(s_routes[i].filter));
+        hash = hash * 31 + mqtt_comm_hash32(&qos, 1);
+    }
+    return hash;
+}
+
+void mqtt_comm_router_mark_subscribed(void) {
+    for (int i = 0; i < s_route_count; i++) {
+        s_routes[i].subscribed = true;
+    }
+}
+
+bool mqtt_comm_router_all_subscribed(void) {
+    for (int i = 0; i < s_route_count; i++) {
+        if (!s_routes[i].subscribed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool mqtt_comm_router_on_suback(int msg_id, const uint8_t *codes, size_t code_count) {
+    if (msg_id != s_sub_msg_id || s_sub_count == 0) {
+        return false; // Not ours (e.g. a direct mqtt_comm_subscribe())
+    }
+    for (int i = 0; i < s_sub_count; i++) {
+        route_entry_t *route = &s_routes[s_sub_routes[i]];
+        // One return code per topic; >= 0x80 is a failure in both MQTT 3.1.1 and 5
+        bool granted = (codes && (size_t)i < code_count && codes[i] < 0x80);
+        route->subscribed = granted;
+        if (!granted) {
+            ESP_LOGE(TAG, "Broker refused subscription '%s' (code 0x%02x)", route->filter,
+                     (codes && (size_t)i < code_count) ? codes[i] : 0xff);
+        }
+    }
+    s_sub_msg_id = -1;
+    s_sub_count = 0;
+    return true;
+}
+
+void mqtt_comm_router_deinit(void) {
+    for (int i = 0; i < MQTT_COMM_ROUTE_MAX; i++) {
+        free(s_routes[i].filter);
+        s_routes[i].filter = NULL;
+    }
+    s_route_count = 0;
+    s_node_count = 0;
+    s_sub_msg_id = -1;
+    s_sub_count = 0;
+}
\ No newline at end of file
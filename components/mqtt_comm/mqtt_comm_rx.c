@@ -0,0 +1,154 @@
+// components/mqtt_comm/mqtt_comm_rx.c
+// Receive path: turns MQTT_EVENT_DATA events into mqtt_comm_message_t.
+//
+// A message larger than the client's input buffer arrives as a series of
+// DATA events; only the first carries the topic, later ones just advance
+// current_data_offset. Fragments of one message always arrive back to back
+// from the MQTT task, so a single topic copy and a single pool buffer suffice.
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "mqtt_comm_priv.h"
+
+static const char *TAG = "MQTT_RX";
+
+#define DEFAULT_RX_MAX_LEN 4096
+
+static mqtt_comm_rx_mode_t s_mode = MQTT_COMM_RX_MODE_REASSEMBLE;
+static char *s_pool = NULL;      // Reassembly buffer, allocated once at init
+static size_t s_pool_size = 0;
+
+// Fragmented message in progress
+static char s_topic[MQTT_COMM_TOPIC_MAX_LEN];
+static size_t s_topic_len = 0;
+static size_t s_total_len = 0;
+static size_t s_expected_offset = 0;
+static int s_qos = 0;
+static bool s_retain = false;
+static bool s_in_progress = false;
+static bool s_discarding = false; // Rest of the current message is dropped
+
+esp_err_t mqtt_comm_rx_init(mqtt_comm_rx_mode_t mode, size_t max_len) {
+    s_mode = mode;
+    s_in_progress = false;
+    if (mode != MQTT_COMM_RX_MODE_REASSEMBLE) {
+        return ESP_OK;
+    }
+
+    s_pool_size = max_len ? max_len : DEFAULT_RX_MAX_LEN;
+    s_pool = malloc(s_pool_size);
+    if (!s_pool) {
+        ESP_LOGE(TAG, "Failed to allocate %d byte reassembly buffer", (int)s_pool_size);
+        s_pool_size = 0;
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Reassembling fragmented messages up to %d bytes", (int)s_pool_size);
+    return ESP_OK;
+}
+
+static void start_message(const esp_mqtt_event_handle_t event) {
+    s_in_progress = true;
+    s_discarding = false;
+    s_total_len = (size_t)event->total_data_len;
+    s_expected_offset = 0;
+    s_topic_len = 0;
+    s_qos = event->qos;
+    s_retain = event->retain;
+
+    if ((size_t)event->topic_len >= sizeof(s_topic)) {
+        ESP_LOGW(TAG, "Topic of fragmented message too long (%d), dropping it", event->topic_len);
+        s_discarding = true;
+    } else if (s_mode == MQTT_COMM_RX_MODE_REASSEMBLE && s_total_len > s_pool_size) {
+        ESP_LOGW(TAG, "Message on '%.*s' too large to reassemble (%d > %d bytes), dropping it",
+                 event->topic_len, event->topic, (int)s_total_len, (int)s_pool_size);
+        s_discarding = true;
+    } else {
+        memcpy(s_topic, event->topic, (size_t)event->topic_len);
+        s_topic_len = (size_t)event->topic_len;
+    }
+    if (s_discarding) {
+        mqtt_comm_stats_on_rx_dropped();
+    }
+}
+
+void mqtt_comm_rx_on_data(const esp_mqtt_event_handle_t event) {
+    size_t offset = (size_t)event->current_data_offset;
+    size_t len = (size_t)event->data_len;
+    size_t total = (size_t)event->total_data_len;
+
+    if (offset == 0 && len == total) {
+        // Common case: the whole message fit in the input buffer
+        s_in_progress = false;
+        mqtt_comm_message_t msg = {
+            .topic = event->topic,
+            .topic_len = (size_t)event->topic_len,
+            .data = event->data,
+            .data_len = len,
+            .offset = 0,
+            .total_len = len,
+            .qos = event->qos,
+            .retain = event->retain,
+        };
+        mqtt_comm_deliver(&msg);
+        return;
+    }
+
+    if (offset == 0) {
+        start_message(event);
+        mqtt_comm_stats_on_rx_fragmented();
+    } else if (!s_in_progress || offset != s_expected_offset || total != s_total_len || offset + len > total) {
+        ESP_LOGW(TAG, "Unexpected fragment (offset %d, expected %d), dropping it",
+                 (int)offset, s_in_progress ? (int)s_expected_offset : 0);
+        if (s_in_progress && !s_discarding) {
+            mqtt_comm_stats_on_rx_dropped();
+        }
+        s_in_progress = false;
+        return;
+    }
+    s_expected_offset = offset + len;
+    bool last = (s_expected_offset >= s_total_len);
+    if (last) {
+        s_in_progress = false;
+    }
+    if (s_discarding) {
+        return;
+    }
+
+    if (s_mode == MQTT_COMM_RX_MODE_STREAM) {
+        mqtt_comm_message_t msg = {
+            .topic = s_topic,
+            .topic_len = s_topic_len,
+            .data = event->data,
+            .data_len = len,
+            .offset = offset,
+            .total_len = s_total_len,
+            .qos = s_qos,
+            .retain = s_retain,
+        };
+        mqtt_comm_deliver(&msg);
+        return;
+    }
+
+    memcpy(s_pool + offset, event->data, len);
+    if (last) {
+        mqtt_comm_message_t msg = {
+            .topic = s_topic,
+            .topic_len = s_topic_len,
+            .data = s_pool,
+            .data_len = s_total_len,
+            .offset = 0,
+            .total_len = s_total_len,
+            .qos = s_qos,
+            .retain = s_retain,
+        };
+        ESP_LOGD(TAG, "Reassembled %d bytes on '%.*s'", (int)s_total_len, (int)s_topic_len, s_topic);
+        mqtt_comm_deliver(&msg);
+    }
+}
+
+void mqtt_comm_rx_deinit(void) {
+    free(s_pool);
+    s_pool = NULL;
+    s_pool_size = 0;
+    s_in_progress = false;
+}
\ No newline at end of file
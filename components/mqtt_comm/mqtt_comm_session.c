@@ -0,0 +1,110 @@
+// components/mqtt_comm/mqtt_comm_session.c
+// NVS-backed state for persistent MQTT sessions. The broker keys a session on
+// the client ID, so it must survive reboots, and the hash of the subscription
+// table tells whether a resumed session still holds exactly our routes.
+// Also holds the last resolved broker address (mqtt_comm_discovery.c).
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "mqtt_comm_priv.h"
+
+static const char *TAG = "MQTT_SESSION";
+
+#define NVS_NAMESPACE "mqtt_comm"
+#define KEY_CLIENT_ID "client_id"
+#define KEY_SUB_HASH "sub_hash"
+#define KEY_BROKER "broker_addr"
+
+typedef struct {
+    uint32_t ip;
+    uint16_t port;
+} broker_entry_t;
+
+esp_err_t mqtt_comm_session_load_client_id(char *buf, size_t buf_len) {
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    size_t len = buf_len;
+    ret = nvs_get_str(nvs, KEY_CLIENT_ID, buf, &len);
+    nvs_close(nvs);
+    return ret;
+}
+
+esp_err_t mqtt_comm_session_save_client_id(const char *client_id) {
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret == ESP_OK) {
+        ret = nvs_set_str(nvs, KEY_CLIENT_ID, client_id);
+        if (ret == ESP_OK) {
+            ret = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to store client ID: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+uint32_t mqtt_comm_session_load_sub_hash(void) {
+    nvs_handle_t nvs;
+    uint32_t hash = 0;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        nvs_get_u32(nvs, KEY_SUB_HASH, &hash);
+        nvs_close(nvs);
+    }
+    return hash;
+}
+
+void mqtt_comm_session_save_sub_hash(uint32_t hash) {
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to open NVS namespace '%s'", NVS_NAMESPACE);
+        return;
+    }
+    uint32_t stored = 0;
+    if (nvs_get_u32(nvs, KEY_SUB_HASH, &stored) != ESP_OK || stored != hash) {
+        // Only written when the table changes, so flash is not worn by reconnects
+        if (nvs_set_u32(nvs, KEY_SUB_HASH, hash) == ESP_OK) {
+            nvs_commit(nvs);
+        }
+    }
+    nvs_close(nvs);
+}
+
+esp_err_t mqtt_comm_session_load_broker(uint32_t *ip, uint16_t *port) {
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    broker_entry_t entry;
+    size_t len = sizeof(entry);
+    ret = nvs_get_blob(nvs, KEY_BROKER, &entry, &len);
+    nvs_close(nvs);
+    if (ret == ESP_OK && len == sizeof(entry)) {
+        *ip = entry.ip;
+        *port = entry.port;
+        return ESP_OK;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+void mqtt_comm_session_save_broker(uint32_t ip, uint16_t port) {
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    broker_entry_t entry = { .ip = ip, .port = port };
+    broker_entry_t stored;
+    size_t len = sizeof(stored);
+    if (nvs_get_blob(nvs, KEY_BROKER, &stored, &len) != ESP_OK || len != sizeof(stored) ||
+        stored.ip != entry.ip || stored.port != entry.port) {
+        if (nvs_set_blob(nvs, KEY_BROKER, &entry, sizeof(entry)) == ESP_OK) {
+            nvs_commit(nvs);
+        }
+    }
+    nvs_close(nvs);
+}
\ No newline at end of file
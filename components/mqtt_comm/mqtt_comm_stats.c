@@ -0,0 +1,269 @@
+// components/mqtt_comm/mqtt_comm_stats.c
+// Publish-to-PUBACK latency tracking. In-flight QoS > 0 publishes are kept in a
+// table indexed by msg_id (ids are incremental, see CONFIG_MQTT_MSG_ID_INCREMENTAL),
+// so matching a PUBACK is a single slot lookup.
+// The same events also feed the runtime metrics registry (metrics.h).
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "metrics.h"
+#include "mqtt_comm_priv.h"
+
+static const char *TAG = "MQTT_STATS";
+
+#define INFLIGHT_SLOTS 64 // Power of two
+
+typedef struct {
+    int msg_id;       // 0 = slot free
+    int64_t sent_us;
+} inflight_slot_t;
+
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static inflight_slot_t s_inflight[INFLIGHT_SLOTS];
+static mqtt_comm_stats_t s_stats;
+static uint32_t s_retransmit_timeout_ms = 1000;
+// A PUBACK can be handled by the MQTT task before esp_mqtt_client_publish() has
+// returned the msg_id to us. An unmatched ack is parked here and settled by the
+// next on_publish(); publishes are serialized by the client mutex, so one is enough.
+static int s_early_ack_id;
+static int64_t s_early_ack_us;
+
+static const uint32_t s_ack_ms_bounds[] = { 10, 50, 100, 250, 500, 1000, 5000 };
+static const uint32_t s_connect_ms_bounds[] = { 100, 250, 500, 1000, 2000, 5000, 10000 };
+static metric_t *s_m_published;
+static metric_t *s_m_acked;
+static metric_t *s_m_expired;
+static metric_t *s_m_ack_ms;
+static metric_t *s_m_connects;
+static metric_t *s_m_connect_ms;
+static metric_t *s_m_tls_ms;
+static metric_t *s_m_tls_resumptions;
+static metric_t *s_m_rx_fragmented;
+static metric_t *s_m_rx_dropped;
+static metric_t *s_m_dedup_suppressed;
+static metric_t *s_m_alias_bytes_saved;
+static metric_t *s_m_alias_ineligible;
+
+static int32_t read_in_flight(void *ctx) {
+    return (int32_t)s_stats.in_flight; // Single aligned word, no lock needed for a sample
+}
+
+static int32_t read_connected(void *ctx) {
+    return mqtt_comm_connected_nowait() ? 1 : 0; // Metrics readers must not block
+}
+
+static int latency_bucket(int64_t latency_us) {
+    int64_t ms = latency_us / 1000;
+    int bucket = 0;
+    while (ms > 0 && bucket < MQTT_COMM_LATENCY_BUCKETS - 1) {
+        ms >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void mqtt_comm_stats_init(uint32_t retransmit_timeout_ms) {
+    taskENTER_CRITICAL(&s_stats_lock);
+    memset(s_inflight, 0, sizeof(s_inflight));
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_early_ack_id = 0;
+    s_stats.latency_min_us = UINT32_MAX;
+    s_retransmit_timeout_ms = retransmit_timeout_ms;
+    taskEXIT_CRITICAL(&s_stats_lock);
+
+    s_m_published = metrics_counter("mqtt.published");
+    s_m_acked = metrics_counter("mqtt.acked");
+    s_m_expired = metrics_counter("mqtt.expired");
+    s_m_ack_ms = metrics_histogram("mqtt.ack_ms", s_ack_ms_bounds, sizeof(s_ack_ms_bounds) / sizeof(s_ack_ms_bounds[0]));
+    s_m_connects = metrics_counter("mqtt.connects");
+    s_m_connect_ms = metrics_histogram("mqtt.connect_ms", s_connect_ms_bounds,
+                                       sizeof(s_connect_ms_bounds) / sizeof(s_connect_ms_bounds[0]));
+    s_m_tls_ms = metrics_histogram("mqtt.tls_ms", s_connect_ms_bounds,
+                                   sizeof(s_connect_ms_bounds) / sizeof(s_connect_ms_bounds[0]));
+    s_m_tls_resumptions = metrics_counter("mqtt.tls_resumptions");
+    s_m_rx_fragmented = metrics_counter("mqtt.rx_fragmented");
+    s_m_rx_dropped = metrics_counter("mqtt.rx_dropped");
+    s_m_dedup_suppressed = metrics_counter("mqtt.dedup_suppressed");
+    s_m_alias_bytes_saved = metrics_counter("mqtt.alias_bytes_saved");
+    s_m_alias_ineligible = metrics_counter("mqtt.alias_ineligible");
+    metrics_gauge_fn("mqtt.in_flight", read_in_flight, NULL);
+    metrics_gauge_fn("mqtt.connected", read_connected, NULL);
+}
+
+// Must be called with s_stats_lock held
+static void record_ack_locked(int64_t latency_us) {
+    if (latency_us < 0) latency_us = 0;
+    uint32_t latency_clamped = latency_us > UINT32_MAX ? UINT32_MAX : (uint32_t)latency_us;
+    s_stats.latency_hist[latency_bucket(latency_us)]++;
+    s_stats.latency_sum_us += (uint64_t)latency_us;
+    if (latency_clamped < s_stats.latency_min_us) s_stats.latency_min_us = latency_clamped;
+    if (latency_clamped > s_stats.latency_max_us) s_stats.latency_max_us = latency_clamped;
+    // esp-mqtt resends an unacknowledged message every retransmit timeout
+    if (s_retransmit_timeout_ms > 0) {
+        s_stats.retransmits += (uint32_t)(latency_us / 1000 / s_retransmit_timeout_ms);
+    }
+    s_stats.acked++;
+}
+
+static void publish_ack_metrics(int64_t latency_us) {
+    metrics_inc(s_m_acked);
+    metrics_observe(s_m_ack_ms, latency_us > 0 ? (uint32_t)(latency_us / 1000) : 0);
+}
+
+void mqtt_comm_stats_on_publish(int msg_id, int64_t sent_us) {
+    int64_t acked_latency_us = -1;
+    inflight_slot_t *slot = &s_inflight[msg_id & (INFLIGHT_SLOTS - 1)];
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.published++;
+    if (s_early_ack_id == msg_id) {
+        // Acknowledged before the publish call returned: never in flight
+        acked_latency_us = s_early_ack_us - sent_us;
+        record_ack_locked(acked_latency_us);
+        s_early_ack_id = 0;
+    } else {
+        if (slot->msg_id != 0) {
+            // More than INFLIGHT_SLOTS outstanding: the older message is no longer timed
+            s_stats.untracked++;
+            s_stats.in_flight--;
+        }
+        slot->msg_id = msg_id;
+        slot->sent_us = sent_us;
+        s_stats.in_flight++;
+    }
+    taskEXIT_CRITICAL(&s_stats_lock);
+    metrics_inc(s_m_published);
+    if (acked_latency_us >= 0) {
+        publish_ack_metrics(acked_latency_us);
+    }
+}
+
+void mqtt_comm_stats_on_ack(int msg_id) {
+    int64_t now = esp_timer_get_time();
+    int64_t acked_latency_us = -1;
+    inflight_slot_t *slot = &s_inflight[msg_id & (INFLIGHT_SLOTS - 1)];
+    taskENTER_CRITICAL(&s_stats_lock);
+    if (slot->msg_id == msg_id) {
+        acked_latency_us = now - slot->sent_us;
+        record_ack_locked(acked_latency_us);
+        s_stats.in_flight--;
+        slot->msg_id = 0;
+    } else {
+        if (s_early_ack_id != 0) {
+            s_stats.untracked++; // The previously parked ack never found its publish
+        }
+        s_early_ack_id = msg_id;
+        s_early_ack_us = now;
+    }
+    taskEXIT_CRITICAL(&s_stats_lock);
+    if (acked_latency_us >= 0) {
+        publish_ack_metrics(acked_latency_us);
+    }
+}
+
+void mqtt_comm_stats_on_deleted(int msg_id) {
+    inflight_slot_t *slot = &s_inflight[msg_id & (INFLIGHT_SLOTS - 1)];
+    taskENTER_CRITICAL(&s_stats_lock);
+    if (slot->msg_id == msg_id) {
+        slot->msg_id = 0;
+        s_stats.in_flight--;
+    }
+    s_stats.expired++;
+    taskEXIT_CRITICAL(&s_stats_lock);
+    metrics_inc(s_m_expired);
+}
+
+void mqtt_comm_stats_on_reconnect(void) {
+    // Everything still in flight is sent again on the new connection
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.retransmits += s_stats.in_flight;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+void mqtt_comm_stats_on_rx_fragmented(void) {
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.rx_fragmented++;
+    taskEXIT_CRITICAL(&s_stats_lock);
+    metrics_inc(s_m_rx_fragmented);
+}
+
+void mqtt_comm_stats_on_rx_dropped(void) {
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.rx_dropped++;
+    taskEXIT_CRITICAL(&s_stats_lock);
+    metrics_inc(s_m_rx_dropped);
+}
+
+void mqtt_comm_stats_on_dedup_suppressed(void) {
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.dedup_suppressed++;
+    taskEXIT_CRITICAL(&s_stats_lock);
+    metrics_inc(s_m_dedup_suppressed);
+}
+
+// MQTT 5 publish that used an alias (aliased) or could not use one (QoS > 0 or enqueued)
+void mqtt_comm_stats_on_alias(bool aliased, size_t topic_len) {
+    taskENTER_CRITICAL(&s_stats_lock);
+    // The Topic Alias property itself takes 3 bytes
+    uint32_t saved = topic_len > 3 ? (uint32_t)topic_len - 3 : 0;
+    if (aliased) {
+        s_stats.alias_hits++;
+        s_stats.alias_bytes_saved += saved;
+    } else {
+        s_stats.alias_ineligible++;
+    }
+    taskEXIT_CRITICAL(&s_stats_lock);
+    if (aliased) {
+        metrics_add(s_m_alias_bytes_saved, saved);
+    } else {
+        metrics_inc(s_m_alias_ineligible);
+    }
+}
+
+void mqtt_comm_stats_on_subscribed(int64_t connack_to_suback_us) {
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.subscribe_time_us = connack_to_suback_us > UINT32_MAX ? UINT32_MAX : (uint32_t)connack_to_suback_us;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+void mqtt_comm_stats_on_connected(int64_t connect_us) {
+    uint32_t clamped = connect_us > UINT32_MAX ? UINT32_MAX : (uint32_t)connect_us;
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.connect_time_us = clamped;
+    if (s_stats.connects == 0 || clamped < s_stats.connect_time_min_us) s_stats.connect_time_min_us = clamped;
+    if (clamped > s_stats.connect_time_max_us) s_stats.connect_time_max_us = clamped;
+    s_stats.connects++;
+    taskEXIT_CRITICAL(&s_stats_lock);
+    metrics_inc(s_m_connects);
+    metrics_observe(s_m_connect_ms, clamped / 1000);
+}
+
+void mqtt_comm_stats_on_tls_handshake(int64_t handshake_us, bool ticket_offered) {
+    uint32_t clamped = handshake_us > UINT32_MAX ? UINT32_MAX : (handshake_us < 0 ? 0 : (uint32_t)handshake_us);
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.tls_handshake_us = clamped;
+    if (clamped > s_stats.tls_handshake_max_us) s_stats.tls_handshake_max_us = clamped;
+    s_stats.tls_handshakes++;
+    if (ticket_offered) s_stats.tls_resumptions++;
+    taskEXIT_CRITICAL(&s_stats_lock);
+    metrics_observe(s_m_tls_ms, clamped / 1000);
+    if (ticket_offered) {
+        metrics_inc(s_m_tls_resumptions);
+    }
+}
+
+esp_err_t mqtt_comm_get_stats(mqtt_comm_stats_t *out) {
+    if (!out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    taskENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    taskEXIT_CRITICAL(&s_stats_lock);
+    if (out->acked == 0) {
+        out->latency_min_us = 0;
+    }
+    out->outbox_size = mqtt_comm_outbox_size(); // Takes the client lock, so outside the critical section
+    ESP_LOGV(TAG, "in_flight=%" PRIu32 " acked=%" PRIu32 " outbox=%d", out->in_flight, out->acked, out->outbox_size);
+    return ESP_OK;
+}
\ No newline at end of file
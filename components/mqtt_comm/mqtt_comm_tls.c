@@ -0,0 +1,209 @@
+// components/mqtt_comm/mqtt_comm_tls.c
+// TLS transport for mqtts:// handed to esp-mqtt as a custom transport.
+//
+// esp-mqtt's own SSL transport connects TCP and runs the handshake in one
+// blocking call. Driving esp-tls asynchronously here lets the TCP connect and
+// the TLS handshake be stamped as separate phases (conn_timing), and lets the
+// client session ticket of the last connection be offered on the next one
+// (CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS), which turns a reconnect into an
+// abbreviated handshake without certificate verification.
+#include <string.h>
+#include <stdlib.h>
+#include <sys/select.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_tls.h"
+#include "esp_transport.h"
+#include "conn_timing.h"
+#include "mqtt_comm_priv.h"
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+#include "esp_crt_bundle.h"
+#endif
+
+static const char *TAG = "MQTT_TLS";
+
+#define HANDSHAKE_POLL_MS 10 // Socket wait between handshake steps
+
+typedef struct {
+    esp_tls_t *tls;
+    esp_tls_cfg_t cfg;
+} tls_ctx_t;
+
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+// Only the MQTT task connects, so the session needs no lock
+static esp_tls_client_session_t *s_session = NULL;
+#endif
+
+// Waits until the socket is readable (or writable). 1 = ready, 0 = timeout, -1 = error.
+static int wait_socket(esp_tls_t *tls, bool write, int timeout_ms) {
+    int sockfd = -1;
+    if (esp_tls_get_conn_sockfd(tls, &sockfd) != ESP_OK || sockfd < 0) {
+        return -1;
+    }
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(sockfd, &fds);
+    struct timeval tv = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+    int ret = select(sockfd + 1, write ? NULL : &fds, write ? &fds : NULL, NULL, timeout_ms >= 0 ? &tv : NULL);
+    return ret < 0 ? -1 : (ret > 0 ? 1 : 0);
+}
+
+static int tls_close(esp_transport_handle_t t) {
+    tls_ctx_t *ctx = esp_transport_get_context_data(t);
+    if (ctx->tls) {
+        esp_tls_conn_destroy(ctx->tls);
+        ctx->tls = NULL;
+    }
+    return 0;
+}
+
+static int tls_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms) {
+    tls_ctx_t *ctx = esp_transport_get_context_data(t);
+    tls_close(t);
+    ctx->tls = esp_tls_init();
+    if (!ctx->tls) {
+        return -1;
+    }
+
+    esp_tls_cfg_t cfg = ctx->cfg;
+    cfg.non_block = true;
+    cfg.timeout_ms = timeout_ms;
+    bool resuming = false;
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    cfg.client_session = s_session;
+    resuming = (s_session != NULL);
+#endif
+
+    int64_t start_us = esp_timer_get_time();
+    int64_t deadline_us = start_us + (int64_t)timeout_ms * 1000;
+    int64_t tcp_done_us = 0;
+    while (1) {
+        int ret = esp_tls_conn_new_async(host, (int)strlen(host), port, &cfg, ctx->tls);
+        esp_tls_conn_state_t state = ESP_TLS_INIT;
+        esp_tls_get_conn_state(ctx->tls, &state);
+        if (tcp_done_us == 0 && (state == ESP_TLS_HANDSHAKE || state == ESP_TLS_DONE)) {
+            tcp_done_us = esp_timer_get_time();
+            conn_timing_mark(CONN_TIMING_MQTT_TCP);
+        }
+        if (ret == 1) {
+            break;
+        }
+        if (ret < 0 || esp_timer_get_time() > deadline_us) {
+            ESP_LOGW(TAG, "TLS connection to %s:%d failed (%s)", host, port, ret < 0 ? "error" : "timeout");
+            tls_close(t);
+            return -1;
+        }
+        if (state == ESP_TLS_HANDSHAKE) {
+            wait_socket(ctx->tls, false, HANDSHAKE_POLL_MS); // Waiting for the server's next flight
+        }
+    }
+
+    int64_t handshake_us = esp_timer_get_time() - (tcp_done_us ? tcp_done_us : start_us);
+    conn_timing_mark(CONN_TIMING_MQTT_TLS);
+    mqtt_comm_stats_on_tls_handshake(handshake_us, resuming);
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    esp_tls_client_session_t *session = esp_tls_get_client_session(ctx->tls);
+    if (session) {
+        if (s_session) {
+            esp_tls_free_client_session(s_session);
+        }
+        s_session = session;
+    }
+#endif
+    ESP_LOGD(TAG, "TLS handshake %d ms%s", (int)(handshake_us / 1000), resuming ? " (ticket offered)" : "");
+    return 0;
+}
+
+static int tls_poll_read(esp_transport_handle_t t, int timeout_ms) {
+    tls_ctx_t *ctx = esp_transport_get_context_data(t);
+    if (!ctx->tls) {
+        return -1;
+    }
+    if (esp_tls_get_bytes_avail(ctx->tls) > 0) {
+        return 1; // Already decrypted, the socket may have nothing more
+    }
+    return wait_socket(ctx->tls, false, timeout_ms);
+}
+
+static int tls_poll_write(esp_transport_handle_t t, int timeout_ms) {
+    tls_ctx_t *ctx = esp_transport_get_context_data(t);
+    return ctx->tls ? wait_socket(ctx->tls, true, timeout_ms) : -1;
+}
+
+static int tls_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms) {
+    tls_ctx_t *ctx = esp_transport_get_context_data(t);
+    int poll = tls_poll_read(t, timeout_ms);
+    if (poll <= 0) {
+        return poll < 0 ? ERR_TCP_TRANSPORT_CONNECTION_FAILED : ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    ssize_t ret = esp_tls_conn_read(ctx->tls, buffer, (size_t)len);
+    if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_WANT_WRITE) {
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT; // Only a partial record so far
+    }
+    if (ret == 0) {
+        return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+    }
+    return ret < 0 ? ERR_TCP_TRANSPORT_CONNECTION_FAILED : (int)ret;
+}
+
+static int tls_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms) {
+    tls_ctx_t *ctx = esp_transport_get_context_data(t);
+    int written = 0;
+    while (written < len) {
+        int poll = tls_poll_write(t, timeout_ms);
+        if (poll <= 0) {
+            return poll < 0 ? -1 : written; // Timeout: esp-mqtt handles a short write
+        }
+        ssize_t ret = esp_tls_conn_write(ctx->tls, buffer + written, (size_t)(len - written));
+        if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_WANT_WRITE) {
+            continue;
+        }
+        if (ret < 0) {
+            ESP_LOGW(TAG, "TLS write failed (-0x%x)", (unsigned)-ret);
+            return -1;
+        }
+        written += (int)ret;
+    }
+    return written;
+}
+
+static int tls_destroy(esp_transport_handle_t t) {
+    tls_close(t);
+    free(esp_transport_get_context_data(t));
+    return 0;
+}
+
+esp_transport_handle_t mqtt_comm_tls_transport_create(const mqtt_comm_config_t *config, const char *common_name) {
+    tls_ctx_t *ctx = calloc(1, sizeof(tls_ctx_t));
+    esp_transport_handle_t t = ctx ? esp_transport_init() : NULL;
+    if (!t) {
+        free(ctx);
+        ESP_LOGE(TAG, "No memory for the TLS transport");
+        return NULL;
+    }
+    if (config->ca_cert_pem) {
+        ctx->cfg.cacert_buf = (const unsigned char *)config->ca_cert_pem;
+        ctx->cfg.cacert_bytes = strlen(config->ca_cert_pem) + 1; // PEM length includes the terminator
+    } else if (config->use_crt_bundle) {
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+        ctx->cfg.crt_bundle_attach = esp_crt_bundle_attach;
+#endif
+    }
+    ctx->cfg.common_name = common_name;
+    esp_transport_set_context_data(t, ctx);
+    esp_transport_set_func(t, tls_connect, tls_read, tls_write, tls_close, tls_poll_read, tls_poll_write, tls_destroy);
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    ESP_LOGI(TAG, "TLS session tickets are offered on reconnect");
+#endif
+    return t;
+}
+
+void mqtt_comm_tls_deinit(void) {
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    if (s_session) {
+        esp_tls_free_client_session(s_session);
+        s_session = NULL;
+    }
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+// components/mqtt_comm/private_include/mqtt_comm_backoff.h
+#ifndef MQTT_COMM_BACKOFF_H
+#define MQTT_COMM_BACKOFF_H
+
+// Reconnect delay computation, kept free of ESP-IDF types so the host
+// simulation (host_sim/) runs the same code as the firmware.
+
+#include <stdint.h>
+
+#define MQTT_COMM_BACKOFF_MAX_SHIFT 16
+
+/**
+ * @brief Window the next delay is drawn from after `attempt` consecutive failures.
+ */
+static inline uint32_t mqtt_comm_backoff_window_ms(uint32_t base_ms, uint32_t max_ms, uint32_t attempt) {
+    uint32_t shift = attempt < MQTT_COMM_BACKOFF_MAX_SHIFT ? attempt : MQTT_COMM_BACKOFF_MAX_SHIFT;
+    uint64_t window_ms = (uint64_t)base_ms << shift;
+    return window_ms > max_ms ? max_ms : (uint32_t)window_ms;
+}
+
+/**
+ * @brief Full jitter: a delay uniformly drawn from [0, window] using `random32`.
+ */
+static inline uint32_t mqtt_comm_backoff_delay_ms(uint32_t base_ms, uint32_t max_ms, uint32_t attempt,
+                                                  uint32_t random32) {
+    uint32_t window_ms = mqtt_comm_backoff_window_ms(base_ms, max_ms, attempt);
+    return (uint32_t)((uint64_t)random32 % ((uint64_t)window_ms + 1));
+}
+
+#endif // MQTT_COMM_BACKOFF_H
\ No newline at end of file
@@ -0,0 +1,244 @@
+// components/mqtt_comm/private_include/mqtt_comm_priv.h
+#ifndef MQTT_COMM_PRIV_H
+#define MQTT_COMM_PRIV_H
+
+#include "mqtt_client.h"
+#include "esp_transport.h"
+#include "mqtt_comm.h"
+
+// Internal helpers shared between the mqtt_comm source files.
+// Not part of the public component API.
+
+/**
+ * @brief 64-bit FNV-1a, for hashes compared without the original data at hand.
+ */
+static inline uint64_t mqtt_comm_hash64(const char *data, size_t len) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * @brief Hands a message straight to the ESP-IDF MQTT client.
+ *
+ * This is the last step of the publish path; all optional stages
+ * (batching, ...) end up here. Takes the client mutex.
+ *
+ * @param enqueue true to only place the message in the client outbox
+ *                (sent later by the MQTT task, never blocks on the network).
+ */
+esp_err_t mqtt_comm_publish_direct(const char *topic, const char *data, int len, int qos, int retain, bool enqueue);
+
+/**
+ * @brief Connection state read without the client mutex, so it never waits
+ *        (unlike mqtt_comm_is_connected(), which reports false when the mutex is busy).
+ */
+bool mqtt_comm_connected_nowait(void);
+
+/**
+ * @brief Output side of the publish path: applies compression, then publishes.
+ *
+ * Used by mqtt_comm_publish_ex() and by the coalescing stage when a batch is flushed.
+ */
+esp_err_t mqtt_comm_publish_final(const char *topic, const char *data, size_t len,
+                                  int qos, int retain, uint32_t flags, bool enqueue);
+
+/** @brief Bytes in the esp-mqtt outbox (0 if the client is not running). */
+int mqtt_comm_outbox_size(void);
+
+/**
+ * @brief Delivers a received message to the matching routes, or to the data
+ *        callback if no route matches. Called from the MQTT task.
+ */
+void mqtt_comm_deliver(const mqtt_comm_message_t *msg);
+
+// --- Receive path / fragment reassembly (mqtt_comm_rx.c), MQTT task only ---
+
+esp_err_t mqtt_comm_rx_init(mqtt_comm_rx_mode_t mode, size_t max_len);
+void mqtt_comm_rx_on_data(const esp_mqtt_event_handle_t event);
+void mqtt_comm_rx_deinit(void);
+
+// --- Subscription routing (mqtt_comm_router.c) ---
+
+esp_err_t mqtt_comm_router_init(const mqtt_comm_route_t *routes, size_t route_count);
+
+/** @brief Passes a message to every matching route; returns the number of handlers called. */
+int mqtt_comm_router_dispatch(const mqtt_comm_message_t *msg);
+
+/**
+ * @brief Sends one SUBSCRIBE for every route filter the session does not hold yet.
+ *        Called from the event handler after CONNACK.
+ *
+ * @param session_present CONNACK flag; when false all filters are sent again.
+ * @return msg_id of the SUBSCRIBE, 0 if nothing needed subscribing, -1 on error.
+ */
+int mqtt_comm_router_subscribe_all(esp_mqtt_client_handle_t client, bool session_present);
+
+/**
+ * @brief Records the SUBACK return codes (one per topic).
+ *
+ * @return true if msg_id was the router's SUBSCRIBE.
+ */
+bool mqtt_comm_router_on_suback(int msg_id, const uint8_t *codes, size_t code_count);
+
+/** @brief Hash of all filters and QoS levels, identifies the subscription table across reboots. */
+uint32_t mqtt_comm_router_table_hash(void);
+
+/** @brief Marks every route as held by the session (restored persistent session). */
+void mqtt_comm_router_mark_subscribed(void);
+
+bool mqtt_comm_router_all_subscribed(void);
+
+void mqtt_comm_router_deinit(void);
+
+// --- Persistent session state in NVS (mqtt_comm_session.c) ---
+
+esp_err_t mqtt_comm_session_load_client_id(char *buf, size_t buf_len);
+esp_err_t mqtt_comm_session_save_client_id(const char *client_id);
+uint32_t mqtt_comm_session_load_sub_hash(void); // 0 if none stored
+void mqtt_comm_session_save_sub_hash(uint32_t hash);
+esp_err_t mqtt_comm_session_load_broker(uint32_t *ip, uint16_t *port); // ip in network byte order
+void mqtt_comm_session_save_broker(uint32_t ip, uint16_t port);        // ip = 0 clears the entry
+
+// --- Broker discovery / address cache (mqtt_comm_discovery.c) ---
+
+/** @brief Parses the broker URI; a no-op unless use_mdns or cache_ttl_s is set. */
+esp_err_t mqtt_comm_discovery_init(const char *uri, bool use_mdns, uint32_t cache_ttl_s);
+
+/** @brief Host name the server certificate must match once the URI holds an IP (NULL if not TLS). */
+const char *mqtt_comm_discovery_tls_host(void);
+
+/** @brief Applies the NVS cached address (before esp_mqtt_client_start()) and starts the lookup task. */
+esp_err_t mqtt_comm_discovery_start(esp_mqtt_client_handle_t client);
+void mqtt_comm_discovery_on_connected(void);
+void mqtt_comm_discovery_on_disconnected(void);
+void mqtt_comm_discovery_deinit(void);
+
+// --- TLS transport with phase timing and session tickets (mqtt_comm_tls.c) ---
+
+/** @brief Transport for mqtts:// URIs; esp-mqtt owns and destroys it. NULL on failure. */
+esp_transport_handle_t mqtt_comm_tls_transport_create(const mqtt_comm_config_t *config, const char *common_name);
+void mqtt_comm_tls_deinit(void); // Forgets the session ticket
+
+// --- Reconnect backoff (mqtt_comm_reconnect.c) ---
+
+/** @brief base_ms = 0 leaves reconnecting to esp-mqtt. */
+esp_err_t mqtt_comm_reconnect_init(esp_mqtt_client_handle_t client, uint32_t base_ms, uint32_t max_ms);
+void mqtt_comm_reconnect_on_connected(void);
+void mqtt_comm_reconnect_on_disconnected(void); // Schedules the next attempt
+void mqtt_comm_reconnect_now(void);             // Network is back: reset backoff, retry at once
+void mqtt_comm_reconnect_deinit(void);
+
+// --- Delivery statistics (mqtt_comm_stats.c), safe to call from any task ---
+
+void mqtt_comm_stats_init(uint32_t retransmit_timeout_ms);
+void mqtt_comm_stats_on_publish(int msg_id, int64_t sent_us);
+void mqtt_comm_stats_on_ack(int msg_id);
+void mqtt_comm_stats_on_deleted(int msg_id);
+void mqtt_comm_stats_on_reconnect(void);
+void mqtt_comm_stats_on_rx_fragmented(void);
+void mqtt_comm_stats_on_rx_dropped(void);
+void mqtt_comm_stats_on_subscribed(int64_t connack_to_suback_us);
+void mqtt_comm_stats_on_connected(int64_t connect_us);
+void mqtt_comm_stats_on_tls_handshake(int64_t handshake_us, bool ticket_offered);
+void mqtt_comm_stats_on_dedup_suppressed(void);
+void mqtt_comm_stats_on_alias(bool aliased, size_t topic_len);
+
+// --- Publish-on-change deduplication (mqtt_comm_dedup.c), safe to call from any task ---
+
+typedef struct {
+    uint64_t topic_hash; // 0 = nothing to record
+    uint64_t payload_hash;
+} mqtt_comm_dedup_key_t;
+
+void mqtt_comm_dedup_init(bool enabled, uint32_t max_quiet_ms);
+
+/**
+ * @brief Checks whether a payload repeats the last one sent on its topic.
+ *
+ * @param key Filled with the hashes, to be passed to mqtt_comm_dedup_record()
+ *            once the message was actually published.
+ */
+bool mqtt_comm_dedup_is_duplicate(const char *topic, const char *data, size_t len, mqtt_comm_dedup_key_t *key);
+void mqtt_comm_dedup_record(const mqtt_comm_dedup_key_t *key);
+
+// --- Publish rate limiting (mqtt_comm_ratelimit.c) ---
+
+esp_err_t mqtt_comm_ratelimit_init(const mqtt_comm_rate_limit_config_t *config);
+
+/**
+ * @brief Charges a message against its rate limits.
+ *
+ * @param key Dedup key of the message, recorded if a held-back message is published later.
+ *
+ * @return ESP_ERR_NOT_SUPPORTED if the message may be published now (caller continues;
+ *         also while offline, where no token is charged),
+ *         ESP_OK if it was held back to be sent later (coalesce-latest, QoS 0 only),
+ *         ESP_ERR_NOT_ALLOWED if it was dropped, ESP_ERR_NO_MEM if it could not be held back,
+ *         ESP_ERR_TIMEOUT if the limiter was busy (the message is dropped, never let through).
+ */
+esp_err_t mqtt_comm_ratelimit_offer(const char *topic, const char *data, size_t len,
+                                    int qos, int retain, uint32_t flags, const mqtt_comm_dedup_key_t *key);
+
+/** @brief Lets messages held back while offline go out (called on MQTT_EVENT_CONNECTED). */
+void mqtt_comm_ratelimit_on_connected(void);
+
+void mqtt_comm_ratelimit_deinit(void);
+
+// --- Publish coalescing (mqtt_comm_batch.c) ---
+
+esp_err_t mqtt_comm_batch_init(const mqtt_comm_batch_config_t *default_cfg);
+
+/**
+ * @brief Offers a message to the coalescing stage.
+ *
+ * @param key Dedup key of the message, recorded once its batch is published.
+ *
+ * @return ESP_OK if the message was absorbed into a batch,
+ *         ESP_ERR_NOT_SUPPORTED if the topic is not batched (caller publishes directly),
+ *         or another error code if the batch could not be flushed.
+ */
+esp_err_t mqtt_comm_batch_offer(const char *topic, const char *data, size_t len, const mqtt_comm_dedup_key_t *key);
+
+void mqtt_comm_batch_deinit(void);
+
+// --- Uplink compression (mqtt_comm_compress.c) ---
+
+esp_err_t mqtt_comm_compress_init(size_t min_len, const char *topic_suffix);
+
+/**
+ * @brief Compresses and publishes a payload under "<topic><suffix>".
+ *
+ * @return ESP_ERR_NOT_SUPPORTED if the payload is below the threshold or did not
+ *         shrink (caller publishes it uncompressed), otherwise the publish result.
+ */
+esp_err_t mqtt_comm_compress_publish(const char *topic, const char *data, size_t len,
+                                     int qos, int retain, bool enqueue);
+
+void mqtt_comm_compress_deinit(void);
+
+// --- MQTT 5 topic aliases (mqtt_comm_alias.c), all called with the client mutex held ---
+
+void mqtt_comm_alias_init(uint16_t alias_max);
+
+/**
+ * @brief Returns the alias for a topic, assigning one if needed (0 = do not alias).
+ *
+ * @param announce Set to true if the full topic must be sent along with the alias,
+ *                 because the broker has not seen this mapping on the current connection.
+ */
+uint16_t mqtt_comm_alias_get(const char *topic, bool *announce);
+
+/** @brief Marks an alias as known to the broker after its announcing PUBLISH was sent. */
+void mqtt_comm_alias_confirm(uint16_t alias);
+
+/** @brief Lowers the number of aliases in use (broker accepts fewer than configured). */
+void mqtt_comm_alias_limit(uint16_t alias_max);
+
+/** @brief Forgets all announcements; called for every new connection. */
+void mqtt_comm_alias_reset(void);
+
+#endif // MQTT_COMM_PRIV_H
\ No newline at end of file
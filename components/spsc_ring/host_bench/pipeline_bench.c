@@ -0,0 +1,381 @@
+// components/spsc_ring/host_bench/pipeline_bench.c
+// Uplink throughput, synchronous vs pipelined. A source thread delivers JSON
+// messages into a model of the UART driver's RX buffer at a share of the line
+// rate; bytes that arrive while that buffer is full are lost, as on the device.
+//
+//   synchronous: RX thread reads, parses and publishes each message itself
+//   pipelined:   RX thread --ring--> parse thread --ring--> publish thread
+//
+// The rings are the firmware's spsc_ring.c with the bridge's record layout and
+// APP_PIPELINE_RING_SIZE. Parse and publish spin for their configured CPU cost;
+// every stall_every-th publish also sleeps stall_ms, standing in for a publish
+// blocked on the client lock or a full socket buffer. Exits non-zero if the
+// pipelined run delivers fewer messages than the synchronous one at any load,
+// or if a payload arrives damaged.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "freertos/task.h"
+#include "spsc_ring.h"
+
+#define DRIVER_BUF_SIZE 1024 // APP_UART_RX_BUF_SIZE
+#define RING_SIZE 4096       // APP_PIPELINE_RING_SIZE
+#define MAX_MSG 512
+#define TOPIC_MAX_LEN 128
+#define RUN_SECONDS 4
+
+typedef struct {
+    uint32_t baud;
+    size_t msg_bytes;
+    uint32_t parse_us;     // CPU time of cJSON_Parse + topic building
+    uint32_t publish_us;   // CPU time of mqtt_comm_publish
+    uint32_t stall_ms;     // Extra wait of a blocked publish...
+    uint32_t stall_every;  // ...once every this many publishes (0 = never)
+} bench_params_t;
+
+typedef struct {
+    uint32_t offered;
+    uint32_t delivered;
+    uint32_t lost_uart;    // Driver buffer full: bytes never read
+    uint32_t dropped_ring; // Ring to the next stage full
+    uint32_t damaged;
+    uint32_t rx_items;
+    int64_t rx_busy_sum_us;
+    int64_t rx_busy_max_us;
+    int64_t latency_sum_us;
+    int64_t latency_max_us;
+    int64_t last_done_us;
+} bench_result_t;
+
+// Driver RX buffer: arrival times of whole messages, bounded in bytes
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int64_t arrival_us[DRIVER_BUF_SIZE];
+    uint32_t seq[DRIVER_BUF_SIZE];
+    size_t head, count, bytes;
+    bool source_done;
+} s_drv = { .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+
+static bench_params_t s_params;
+static bool s_pipelined;
+static double s_load;
+static bench_result_t s_res;
+static pthread_mutex_t s_res_lock = PTHREAD_MUTEX_INITIALIZER;
+static spsc_ring_t s_parse_ring;
+static spsc_ring_t s_publish_ring;
+static atomic_bool s_rx_done;
+static atomic_bool s_parse_done;
+static uint32_t s_publish_count;
+
+static int64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void spin_until(int64_t t_us) {
+    while (now_us() < t_us) {
+    }
+}
+
+static void sleep_until(int64_t t_us) {
+    struct timespec ts = { .tv_sec = t_us / 1000000, .tv_nsec = (long)(t_us % 1000000) * 1000 };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+// The message the device would send, padded to msg_bytes; the payload carries the sequence number
+static size_t make_message(char *buf, uint32_t seq) {
+    int len = snprintf(buf, MAX_MSG, "{\"topic\":\"sensor/%u\",\"payload\":\"%08u:", seq % 8, seq);
+    while ((size_t)len + 2 < s_params.msg_bytes && len < MAX_MSG - 3) {
+        buf[len++] = 'x';
+    }
+    buf[len++] = '"';
+    buf[len++] = '}';
+    return (size_t)len;
+}
+
+static void *source_thread(void *arg) {
+    (void)arg;
+    // 10 bits per byte on the line (start + 8 data + stop)
+    int64_t interval_us = (int64_t)(s_params.msg_bytes * 10 * 1000000.0 / s_params.baud / s_load);
+    int64_t start = now_us();
+    int64_t end = start + RUN_SECONDS * 1000000LL;
+    for (uint32_t seq = 0;; seq++) {
+        int64_t t = start + (int64_t)seq * interval_us;
+        if (t >= end) {
+            break;
+        }
+        sleep_until(t);
+        pthread_mutex_lock(&s_drv.lock);
+        s_res.offered++;
+        if (s_drv.bytes + s_params.msg_bytes > DRIVER_BUF_SIZE) {
+            s_res.lost_uart++;
+        } else {
+            size_t slot = (s_drv.head + s_drv.count) % DRIVER_BUF_SIZE;
+            s_drv.arrival_us[slot] = t;
+            s_drv.seq[slot] = seq;
+            s_drv.count++;
+            s_drv.bytes += s_params.msg_bytes;
+            pthread_cond_signal(&s_drv.cond);
+        }
+        pthread_mutex_unlock(&s_drv.lock);
+    }
+    pthread_mutex_lock(&s_drv.lock);
+    s_drv.source_done = true;
+    pthread_cond_signal(&s_drv.cond);
+    pthread_mutex_unlock(&s_drv.lock);
+    return NULL;
+}
+
+static void publish_message(const char *topic, const char *payload, size_t payload_len, int64_t rx_us) {
+    int64_t start = now_us();
+    spin_until(start + s_params.publish_us);
+    if (s_params.stall_every && ++s_publish_count % s_params.stall_every == 0) {
+        usleep(s_params.stall_ms * 1000);
+    }
+    int64_t done = now_us();
+    // {"topic":"sensor/N","payload":"<seq>:xx..."}: 25 bytes of JSON around the topic and payload
+    bool ok = strncmp(topic, "dev/bench/", 10) == 0 && payload_len > 9 && payload[8] == ':' &&
+              payload_len + 25 + strlen(topic + 10) == s_params.msg_bytes;
+    pthread_mutex_lock(&s_res_lock);
+    s_res.delivered++;
+    s_res.damaged += ok ? 0 : 1;
+    s_res.latency_sum_us += done - rx_us;
+    s_res.latency_max_us = done - rx_us > s_res.latency_max_us ? done - rx_us : s_res.latency_max_us;
+    s_res.last_done_us = done;
+    pthread_mutex_unlock(&s_res_lock);
+}
+
+// Extracts the two string fields the way the bridge uses them (no escapes in this traffic)
+static bool find_field(const char *json, const char *key, const char **value, size_t *len) {
+    const char *p = strstr(json, key);
+    if (!p) {
+        return false;
+    }
+    p += strlen(key);
+    const char *end = strchr(p, '"');
+    if (!end) {
+        return false;
+    }
+    *value = p;
+    *len = (size_t)(end - p);
+    return true;
+}
+
+static void parse_message(const char *json, int64_t rx_us) {
+    int64_t start = now_us();
+    const char *topic, *payload;
+    size_t topic_len, payload_len;
+    if (!find_field(json, "\"topic\":\"", &topic, &topic_len) ||
+        !find_field(json, "\"payload\":\"", &payload, &payload_len)) {
+        pthread_mutex_lock(&s_res_lock);
+        s_res.damaged++;
+        pthread_mutex_unlock(&s_res_lock);
+        return;
+    }
+    char full_topic[TOPIC_MAX_LEN];
+    int full_len = snprintf(full_topic, sizeof(full_topic), "dev/bench/%.*s", (int)topic_len, topic);
+    spin_until(start + s_params.parse_us);
+
+    if (!s_pipelined) {
+        publish_message(full_topic, payload, payload_len, rx_us);
+        return;
+    }
+    spsc_ring_part_t parts[] = {
+        { .data = &rx_us, .len = sizeof(rx_us) },
+        { .data = full_topic, .len = (size_t)full_len + 1 },
+        { .data = payload, .len = payload_len },
+    };
+    if (!spsc_ring_push_parts(&s_publish_ring, parts, 3)) {
+        pthread_mutex_lock(&s_res_lock);
+        s_res.dropped_ring++;
+        pthread_mutex_unlock(&s_res_lock);
+    }
+}
+
+// uart_rx_task: one uart_read_bytes() per message, then the bridge callback
+static void *rx_thread(void *arg) {
+    (void)arg;
+    char chunk[MAX_MSG + 1];
+    while (1) {
+        pthread_mutex_lock(&s_drv.lock);
+        while (s_drv.count == 0 && !s_drv.source_done) {
+            pthread_cond_wait(&s_drv.cond, &s_drv.lock);
+        }
+        if (s_drv.count == 0) {
+            pthread_mutex_unlock(&s_drv.lock);
+            break;
+        }
+        int64_t rx_us = s_drv.arrival_us[s_drv.head];
+        uint32_t seq = s_drv.seq[s_drv.head];
+        s_drv.head = (s_drv.head + 1) % DRIVER_BUF_SIZE;
+        s_drv.count--;
+        s_drv.bytes -= s_params.msg_bytes;
+        pthread_mutex_unlock(&s_drv.lock);
+
+        size_t len = make_message(chunk, seq);
+        chunk[len] = '\0';
+        int64_t start = now_us();
+        if (s_pipelined) {
+            spsc_ring_part_t parts[] = {
+                { .data = &rx_us, .len = sizeof(rx_us) },
+                { .data = chunk, .len = len },
+            };
+            if (!spsc_ring_push_parts(&s_parse_ring, parts, 2)) {
+                pthread_mutex_lock(&s_res_lock);
+                s_res.dropped_ring++;
+                pthread_mutex_unlock(&s_res_lock);
+            }
+        } else {
+            parse_message(chunk, rx_us);
+        }
+        int64_t busy = now_us() - start;
+        pthread_mutex_lock(&s_res_lock);
+        s_res.rx_items++;
+        s_res.rx_busy_sum_us += busy;
+        s_res.rx_busy_max_us = busy > s_res.rx_busy_max_us ? busy : s_res.rx_busy_max_us;
+        pthread_mutex_unlock(&s_res_lock);
+    }
+    atomic_store(&s_rx_done, true);
+    return NULL;
+}
+
+static void *parse_thread(void *arg) {
+    host_task_bind((TaskHandle_t)arg);
+    uint8_t buf[sizeof(int64_t) + MAX_MSG + 1];
+    while (1) {
+        bool last = atomic_load(&s_rx_done); // Read before popping: nothing is pushed after it
+        size_t len = 0;
+        esp_err_t ret = spsc_ring_pop_wait(&s_parse_ring, buf, sizeof(buf) - 1, &len, pdMS_TO_TICKS(10));
+        if (ret == ESP_ERR_NOT_FOUND) {
+            if (last) {
+                break;
+            }
+            continue;
+        }
+        int64_t rx_us;
+        memcpy(&rx_us, buf, sizeof(rx_us));
+        buf[len] = '\0';
+        parse_message((char *)buf + sizeof(rx_us), rx_us);
+    }
+    atomic_store(&s_parse_done, true);
+    return NULL;
+}
+
+static void *publish_thread(void *arg) {
+    host_task_bind((TaskHandle_t)arg);
+    uint8_t buf[sizeof(int64_t) + TOPIC_MAX_LEN + MAX_MSG];
+    while (1) {
+        bool last = atomic_load(&s_parse_done);
+        size_t len = 0;
+        esp_err_t ret = spsc_ring_pop_wait(&s_publish_ring, buf, sizeof(buf), &len, pdMS_TO_TICKS(10));
+        if (ret == ESP_ERR_NOT_FOUND) {
+            if (last) {
+                break;
+            }
+            continue;
+        }
+        int64_t rx_us;
+        memcpy(&rx_us, buf, sizeof(rx_us));
+        const char *topic = (const char *)buf + sizeof(rx_us);
+        size_t topic_size = strnlen(topic, len - sizeof(rx_us)) + 1;
+        publish_message(topic, topic + topic_size, len - sizeof(rx_us) - topic_size, rx_us);
+    }
+    return NULL;
+}
+
+static bench_result_t run(bool pipelined, double load) {
+    memset(&s_res, 0, sizeof(s_res));
+    s_drv.head = s_drv.count = s_drv.bytes = 0;
+    s_drv.source_done = false;
+    s_pipelined = pipelined;
+    s_load = load;
+    s_publish_count = 0;
+    atomic_store(&s_rx_done, false);
+    atomic_store(&s_parse_done, false);
+
+    pthread_t source, rx, parse, publish;
+    TaskHandle_t parse_task = NULL, publish_task = NULL;
+    if (pipelined) {
+        parse_task = host_task_create();
+        publish_task = host_task_create();
+        if (!parse_task || !publish_task ||
+            spsc_ring_init(&s_parse_ring, RING_SIZE) != ESP_OK ||
+            spsc_ring_init(&s_publish_ring, RING_SIZE) != ESP_OK) {
+            fprintf(stderr, "Out of memory\n");
+            exit(2);
+        }
+        spsc_ring_set_consumer(&s_parse_ring, parse_task);
+        spsc_ring_set_consumer(&s_publish_ring, publish_task);
+        pthread_create(&parse, NULL, parse_thread, parse_task);
+        pthread_create(&publish, NULL, publish_thread, publish_task);
+    }
+    int64_t start = now_us();
+    pthread_create(&rx, NULL, rx_thread, NULL);
+    pthread_create(&source, NULL, source_thread, NULL);
+    pthread_join(source, NULL);
+    pthread_join(rx, NULL);
+    if (pipelined) {
+        pthread_join(parse, NULL);
+        pthread_join(publish, NULL);
+        spsc_ring_deinit(&s_parse_ring);
+        spsc_ring_deinit(&s_publish_ring);
+        host_task_delete(parse_task);
+        host_task_delete(publish_task);
+    }
+    s_res.last_done_us -= start;
+    return s_res;
+}
+
+static void print_result(const char *mode, double load, const bench_result_t *r) {
+    double secs = r->last_done_us > 0 ? r->last_done_us / 1e6 : 1.0;
+    printf("%-11s %4.0f%% %8u %9u %6u %6u %8.1f %8.1f %8.1f %8.1f %8.1f\n", mode, load * 100, r->offered,
+           r->delivered, r->lost_uart, r->dropped_ring, r->delivered / secs,
+           r->rx_items ? (double)r->rx_busy_sum_us / r->rx_items : 0.0,
+           r->rx_busy_max_us / 1000.0,
+           r->delivered ? r->latency_sum_us / 1000.0 / r->delivered : 0.0, r->latency_max_us / 1000.0);
+}
+
+int main(int argc, char **argv) {
+    s_params = (bench_params_t){
+        .baud = argc > 1 ? (uint32_t)atoi(argv[1]) : 115200, // APP_UART_BAUD_RATE
+        .msg_bytes = argc > 2 ? (size_t)atoi(argv[2]) : 96,
+        .parse_us = argc > 3 ? (uint32_t)atoi(argv[3]) : 150,
+        .publish_us = argc > 4 ? (uint32_t)atoi(argv[4]) : 200,
+        .stall_ms = argc > 5 ? (uint32_t)atoi(argv[5]) : 150,
+        .stall_every = argc > 6 ? (uint32_t)atoi(argv[6]) : 50,
+    };
+    if (s_params.baud == 0 || s_params.msg_bytes < 48 || s_params.msg_bytes > MAX_MSG - 2) {
+        fprintf(stderr, "usage: %s [baud] [msg_bytes 48..%d] [parse_us] [publish_us] [stall_ms] [stall_every]\n",
+                argv[0], MAX_MSG - 2);
+        return 2;
+    }
+    double line_rate = s_params.baud / 10.0 / s_params.msg_bytes;
+    printf("%u baud, %zu-byte messages (line rate %.0f msg/s), parse %u us, publish %u us, "
+           "%u ms stall every %u publishes, %d s per run, %ld host CPUs\n",
+           s_params.baud, s_params.msg_bytes, line_rate, s_params.parse_us, s_params.publish_us,
+           s_params.stall_ms, s_params.stall_every, RUN_SECONDS, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-11s %5s %8s %9s %6s %6s %8s %8s %8s %8s %8s\n", "mode", "load", "offered", "delivered",
+           "lost", "ring", "msg/s", "rx avg", "rx max", "lat avg", "lat max");
+    printf("%-11s %5s %8s %9s %6s %6s %8s %8s %8s %8s %8s\n", "", "", "", "", "uart", "drop", "",
+           "us", "ms", "ms", "ms");
+
+    static const double loads[] = { 0.25, 0.5, 0.9 };
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(loads) / sizeof(loads[0]); i++) {
+        bench_result_t sync = run(false, loads[i]);
+        bench_result_t piped = run(true, loads[i]);
+        print_result("synchronous", loads[i], &sync);
+        print_result("pipelined", loads[i], &piped);
+        if (piped.delivered < sync.delivered || sync.damaged || piped.damaged) {
+            failures++;
+        }
+    }
+    return failures ? 1 : 0;
+}
\ No newline at end of file
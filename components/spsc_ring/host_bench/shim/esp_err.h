@@ -0,0 +1,15 @@
+// components/spsc_ring/host_bench/shim/esp_err.h
+// The esp_err_t codes spsc_ring uses, for the host build
+#ifndef ESP_ERR_H
+#define ESP_ERR_H
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_SIZE 0x104
+#define ESP_ERR_NOT_FOUND 0x105
+
+#endif // ESP_ERR_H
\ No newline at end of file
@@ -0,0 +1,16 @@
+// components/spsc_ring/host_bench/shim/freertos/FreeRTOS.h
+// Just enough of FreeRTOS for spsc_ring on the host: ticks are milliseconds
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define portMAX_DELAY ((TickType_t)0xffffffffu)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+#endif // FREERTOS_H
\ No newline at end of file
@@ -0,0 +1,22 @@
+// components/spsc_ring/host_bench/shim/freertos/task.h
+// Task notifications on pthreads. A thread calls host_task_bind() once, after
+// which ulTaskNotifyTake() waits on its own handle, as on FreeRTOS.
+#ifndef TASK_H
+#define TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_task *TaskHandle_t;
+
+/** @brief Creates a notification target for one thread. */
+TaskHandle_t host_task_create(void);
+
+/** @brief Makes `task` the calling thread's own handle (xTaskGetCurrentTaskHandle()). */
+void host_task_bind(TaskHandle_t task);
+
+void host_task_delete(TaskHandle_t task);
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks);
+
+#endif // TASK_H
\ No newline at end of file
@@ -0,0 +1,70 @@
+// components/spsc_ring/host_bench/shim/freertos_shim.c
+// Notification value guarded by a mutex and condition variable per task
+#include <errno.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include "freertos/task.h"
+
+struct host_task {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t value;
+};
+
+static _Thread_local TaskHandle_t s_current;
+
+TaskHandle_t host_task_create(void) {
+    TaskHandle_t task = calloc(1, sizeof(*task));
+    if (task) {
+        pthread_mutex_init(&task->lock, NULL);
+        pthread_cond_init(&task->cond, NULL);
+    }
+    return task;
+}
+
+void host_task_bind(TaskHandle_t task) {
+    s_current = task;
+}
+
+void host_task_delete(TaskHandle_t task) {
+    if (task) {
+        pthread_cond_destroy(&task->cond);
+        pthread_mutex_destroy(&task->lock);
+        free(task);
+    }
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    pthread_mutex_lock(&task->lock);
+    task->value++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    TaskHandle_t task = s_current;
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ticks / 1000;
+    deadline.tv_nsec += (long)(ticks % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&task->lock);
+    while (task->value == 0 && ticks != 0) {
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(&task->cond, &task->lock);
+        } else if (pthread_cond_timedwait(&task->cond, &task->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    uint32_t value = task->value;
+    if (value) {
+        task->value = clear_on_exit ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+// components/spsc_ring/include/spsc_ring.h
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h> // For size_t
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*
+ * Lock-free ring of variable-length records between exactly one producer task
+ * and one consumer task. Records are copied in and out; each takes its length
+ * plus a 4-byte header. Producer and consumer each own one index and only read
+ * the other's, so no lock or critical section is needed, and the two sides may
+ * run on different cores at the same time.
+ *
+ * The consumer sleeps on its task notification: a push notifies the task set
+ * with spsc_ring_set_consumer(), spsc_ring_pop_wait() waits for it.
+ */
+
+/**
+ * @brief One piece of a record for spsc_ring_push_parts().
+ */
+typedef struct {
+    const void *data;           /*!< Bytes to append */
+    size_t len;                 /*!< Number of bytes */
+} spsc_ring_part_t;
+
+/**
+ * @brief Ring state. Treat as opaque except for the producer-side counters.
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t size;                // Power of two
+    atomic_size_t head;         // Bytes pushed (free-running), written by the producer only
+    atomic_size_t tail;         // Bytes popped (free-running), written by the consumer only
+    TaskHandle_t consumer;      // Notified after each push
+    size_t peak;                /*!< Highest fill level seen by the producer, in bytes */
+    uint32_t dropped;           /*!< Records the producer could not push (ring full) */
+} spsc_ring_t;
+
+/**
+ * @brief Allocates the ring storage.
+ *
+ * @param ring Ring to initialize.
+ * @param size Capacity in bytes, rounded up to a power of two.
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG, or ESP_ERR_NO_MEM.
+ */
+esp_err_t spsc_ring_init(spsc_ring_t *ring, size_t size);
+
+/**
+ * @brief Frees the ring storage. Neither side may use the ring any more.
+ */
+void spsc_ring_deinit(spsc_ring_t *ring);
+
+/**
+ * @brief Sets the task woken by pushes (the consumer). Call before the first push.
+ */
+void spsc_ring_set_consumer(spsc_ring_t *ring, TaskHandle_t consumer);
+
+/**
+ * @brief Appends one record made of several parts. Producer side only; never blocks.
+ *
+ * @return true if the record was queued, false if it did not fit (counted in `dropped`).
+ */
+bool spsc_ring_push_parts(spsc_ring_t *ring, const spsc_ring_part_t *parts, size_t count);
+
+/**
+ * @brief Appends one record. Producer side only; never blocks.
+ */
+bool spsc_ring_push(spsc_ring_t *ring, const void *data, size_t len);
+
+/**
+ * @brief Takes the oldest record. Consumer side only.
+ *
+ * @param ring The ring.
+ * @param out Receives the record.
+ * @param out_size Size of out.
+ * @param len Receives the record length.
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND if the ring is empty, or
+ *         ESP_ERR_INVALID_SIZE if the record is larger than out_size (it is discarded).
+ */
+esp_err_t spsc_ring_pop(spsc_ring_t *ring, void *out, size_t out_size, size_t *len);
+
+/**
+ * @brief Like spsc_ring_pop(), but sleeps up to `ticks` for a record if the ring is empty.
+ *        The calling task must be the one set with spsc_ring_set_consumer().
+ */
+esp_err_t spsc_ring_pop_wait(spsc_ring_t *ring, void *out, size_t out_size, size_t *len, TickType_t ticks);
+
+/**
+ * @brief Bytes currently queued (headers included).
+ */
+size_t spsc_ring_used(spsc_ring_t *ring);
+
+#endif // SPSC_RING_H
\ No newline at end of file
@@ -0,0 +1,127 @@
+// components/spsc_ring/spsc_ring.c
+// head and tail count bytes and wrap only when masked, so head - tail is the
+// fill level. The producer publishes a record by storing head with release
+// order after copying it in; the consumer frees it by storing tail with
+// release order after copying it out.
+#include <stdlib.h>
+#include <string.h>
+#include "spsc_ring.h"
+
+#define HEADER_SIZE sizeof(uint32_t)
+
+esp_err_t spsc_ring_init(spsc_ring_t *ring, size_t size) {
+    if (!ring || size < 2 * HEADER_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t pow2 = 2 * HEADER_SIZE;
+    while (pow2 < size) {
+        pow2 <<= 1;
+    }
+    memset(ring, 0, sizeof(*ring));
+    ring->buf = malloc(pow2);
+    if (!ring->buf) {
+        return ESP_ERR_NO_MEM;
+    }
+    ring->size = pow2;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return ESP_OK;
+}
+
+void spsc_ring_deinit(spsc_ring_t *ring) {
+    if (ring) {
+        free(ring->buf);
+        memset(ring, 0, sizeof(*ring));
+    }
+}
+
+void spsc_ring_set_consumer(spsc_ring_t *ring, TaskHandle_t consumer) {
+    ring->consumer = consumer;
+}
+
+static void copy_in(spsc_ring_t *ring, size_t pos, const void *src, size_t len) {
+    size_t off = pos & (ring->size - 1);
+    size_t first = (ring->size - off < len) ? ring->size - off : len;
+    memcpy(ring->buf + off, src, first);
+    memcpy(ring->buf, (const uint8_t *)src + first, len - first);
+}
+
+static void copy_out(const spsc_ring_t *ring, size_t pos, void *dst, size_t len) {
+    size_t off = pos & (ring->size - 1);
+    size_t first = (ring->size - off < len) ? ring->size - off : len;
+    memcpy(dst, ring->buf + off, first);
+    memcpy((uint8_t *)dst + first, ring->buf, len - first);
+}
+
+bool spsc_ring_push_parts(spsc_ring_t *ring, const spsc_ring_part_t *parts, size_t count) {
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += parts[i].len;
+    }
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed); // Our own index
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t used = head - tail;
+    if (total > UINT32_MAX || HEADER_SIZE + total > ring->size - used) {
+        ring->dropped++;
+        return false;
+    }
+
+    uint32_t header = (uint32_t)total;
+    copy_in(ring, head, &header, HEADER_SIZE);
+    size_t pos = head + HEADER_SIZE;
+    for (size_t i = 0; i < count; i++) {
+        copy_in(ring, pos, parts[i].data, parts[i].len);
+        pos += parts[i].len;
+    }
+    atomic_store_explicit(&ring->head, pos, memory_order_release);
+
+    used = pos - tail;
+    if (used > ring->peak) {
+        ring->peak = used;
+    }
+    if (ring->consumer) {
+        xTaskNotifyGive(ring->consumer);
+    }
+    return true;
+}
+
+bool spsc_ring_push(spsc_ring_t *ring, const void *data, size_t len) {
+    spsc_ring_part_t part = { .data = data, .len = len };
+    return spsc_ring_push_parts(ring, &part, 1);
+}
+
+esp_err_t spsc_ring_pop(spsc_ring_t *ring, void *out, size_t out_size, size_t *len) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed); // Our own index
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head == tail) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    uint32_t header;
+    copy_out(ring, tail, &header, HEADER_SIZE);
+    esp_err_t ret = ESP_ERR_INVALID_SIZE;
+    if (header <= out_size) {
+        copy_out(ring, tail + HEADER_SIZE, out, header);
+        ret = ESP_OK;
+    }
+    if (len) {
+        *len = header;
+    }
+    atomic_store_explicit(&ring->tail, tail + HEADER_SIZE + header, memory_order_release);
+    return ret;
+}
+
+esp_err_t spsc_ring_pop_wait(spsc_ring_t *ring, void *out, size_t out_size, size_t *len, TickType_t ticks) {
+    esp_err_t ret = spsc_ring_pop(ring, out, out_size, len);
+    if (ret == ESP_ERR_NOT_FOUND) {
+        // A push after the failed pop has already given the notification, so it cannot be missed
+        ulTaskNotifyTake(pdTRUE, ticks);
+        ret = spsc_ring_pop(ring, out, out_size, len);
+    }
+    return ret;
+}
+
+size_t spsc_ring_used(spsc_ring_t *ring) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return head - tail;
+}
\ No newline at end of file
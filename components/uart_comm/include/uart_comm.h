@@ -3,10 +3,13 @@
 #define UART_COMM_H
 
 #include "esp_err.h"
+#include "freertos/FreeRTOS.h" // For UBaseType_t / BaseType_t
 #include "driver/uart.h"
 #include <stddef.h> // For size_t
 #include <stdint.h> // For uint8_t
 
+#define UART_COMM_WAIT_FOREVER UINT32_MAX /*!< Timeout for uart_comm_transmit_parts(): wait until there is room */
+
 /**
  * @brief UART communication configuration structure.
  */
@@ -18,8 +21,19 @@ typedef struct {
     int rx_buffer_size;         /*!< UART RX ring buffer size */
     int tx_buffer_size;         /*!< UART TX ring buffer size (0 for default/no buffer) */
     int queue_size;             /*!< UART event queue size (0 for default) */
+    int tx_defer_size;          /*!< Deferred TX queue in bytes, used while the TX ring is full and drained by a TX task (0 = writes block instead) */
+    UBaseType_t task_priority;  /*!< Priority of the RX and deferred TX tasks (0 for 10) */
+    BaseType_t task_core;       /*!< Core the RX and deferred TX tasks are pinned to (tskNO_AFFINITY for either) */
 } uart_comm_config_t;
 
+/**
+ * @brief One piece of a message for uart_comm_transmit_parts().
+ */
+typedef struct {
+    const void *data;           /*!< Bytes to send (not copied until the call) */
+    size_t len;                 /*!< Number of bytes (0 to skip the part) */
+} uart_comm_tx_part_t;
+
 /**
  * @brief Callback function type for received UART data.
  *
@@ -56,6 +70,35 @@ esp_err_t uart_comm_init(const uart_comm_config_t *config, uart_comm_rx_callback
  */
 esp_err_t uart_comm_transmit(const uint8_t *data, size_t len);
 
+/**
+ * @brief Transmits several buffers back to back, without assembling them first.
+ *
+ * The parts are copied straight into the driver's TX ring when it has room for
+ * all of them, otherwise into the deferred TX queue. Parts of one call are
+ * never interleaved with other writes, and a call either queues all parts or
+ * none. Memory use is bounded by tx_buffer_size + tx_defer_size. A message
+ * larger than both buffers together is written by the calling task once older
+ * bytes are out; other writers wait (within their timeout) until it is done.
+ * This function is thread-safe.
+ *
+ * @param parts Buffers to send, in order.
+ * @param count Number of entries in parts.
+ * @param timeout_ms How long to wait for room (0 = fail immediately, UART_COMM_WAIT_FOREVER).
+ * @return esp_err_t ESP_OK once all parts are queued, ESP_ERR_TIMEOUT if there was no room in time,
+ *         ESP_FAIL if UART not initialized, ESP_ERR_INVALID_ARG if arguments are invalid.
+ */
+esp_err_t uart_comm_transmit_parts(const uart_comm_tx_part_t *parts, size_t count, uint32_t timeout_ms);
+
+/**
+ * @brief Bytes accepted for transmission but not yet sent.
+ *
+ * Counts both the driver's TX ring and the deferred TX queue, so a producer can
+ * tell how far behind the UART is. Read without locking; may be slightly stale.
+ *
+ * @return size_t Pending TX bytes (0 if not initialized).
+ */
+size_t uart_comm_tx_pending(void);
+
 /**
  * @brief Deinitializes the UART communication component.
  *
@@ -1,9 +1,13 @@
 // components/uart_comm/uart_comm.c
 #include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/ringbuf.h"
 #include "esp_log.h"
+#include "metrics.h"
 #include "uart_comm.h" // Include own header
 
 static const char *TAG = "UART_COMM";
@@ -13,10 +17,26 @@ static uart_comm_config_t s_uart_config;
 static bool s_uart_initialized = false;
 static TaskHandle_t s_uart_rx_task_handle = NULL;
 static uart_comm_rx_callback_t s_rx_callback = NULL;
-static SemaphoreHandle_t s_tx_mutex = NULL;
+static SemaphoreHandle_t s_tx_mutex = NULL; // Serializes writers; also protects s_tx_deferred
 
-// Forward declaration
+// Deferred TX path: used while the driver's TX ring is full
+static RingbufHandle_t s_tx_defer_rb = NULL;
+static size_t s_tx_deferred = 0; // Bytes in s_tx_defer_rb not yet handed to the driver
+static TaskHandle_t s_tx_owner = NULL; // Task writing an oversize message outside the mutex
+static TaskHandle_t s_uart_tx_task_handle = NULL;
+
+#define TX_UNBUFFERED_CHUNK 128 // Bytes per blocking write when the driver has no TX ring
+
+// Runtime metrics (see metrics.h), registered by uart_comm_init()
+static metric_t *s_m_rx_bytes;
+static metric_t *s_m_rx_chunks;
+static metric_t *s_m_rx_errors;
+static metric_t *s_m_tx_bytes;
+static metric_t *s_m_tx_timeouts;
+
+// Forward declarations
 static void uart_rx_task(void *pvParameters);
+static void uart_tx_task(void *pvParameters);
 
 /**
  * @brief Default weak implementation of the RX callback.
@@ -28,6 +48,10 @@ __attribute__((weak)) void uart_comm_on_receive(const uint8_t *data, size_t len)
 }
 
 
+static int32_t read_tx_deferred(void *ctx) {
+    return (int32_t)s_tx_deferred; // Read without the mutex: a gauge may be slightly stale
+}
+
 esp_err_t uart_comm_init(const uart_comm_config_t *config, uart_comm_rx_callback_t rx_callback) {
     if (s_uart_initialized) {
         ESP_LOGW(TAG, "UART already initialized.");
@@ -38,6 +62,9 @@ esp_err_t uart_comm_init(const uart_comm_config_t *config, uart_comm_rx_callback
     }
 
     s_uart_config = *config; // Copy config
+    if (s_uart_config.task_priority == 0) {
+        s_uart_config.task_priority = 10;
+    }
     s_rx_callback = rx_callback;
 
     uart_config_t uart_drv_config = {
@@ -78,45 +105,188 @@ esp_err_t uart_comm_init(const uart_comm_config_t *config, uart_comm_rx_callback
         return ESP_FAIL;
     }
 
+    if (s_uart_config.tx_defer_size > 0) {
+        s_tx_deferred = 0;
+        s_tx_defer_rb = xRingbufferCreate(s_uart_config.tx_defer_size, RINGBUF_TYPE_BYTEBUF);
+        if (s_tx_defer_rb == NULL ||
+            xTaskCreatePinnedToCore(uart_tx_task, "uart_tx_task", 2048, NULL, s_uart_config.task_priority,
+                                    &s_uart_tx_task_handle, s_uart_config.task_core) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create deferred TX queue/task");
+            if (s_tx_defer_rb) {
+                vRingbufferDelete(s_tx_defer_rb);
+                s_tx_defer_rb = NULL;
+            }
+            vSemaphoreDelete(s_tx_mutex);
+            s_tx_mutex = NULL;
+            uart_driver_delete(s_uart_config.port);
+            return ESP_FAIL;
+        }
+    }
+
     // Create the UART RX task
-    BaseType_t task_created = xTaskCreate(uart_rx_task, "uart_rx_task", 4096, NULL, 10, &s_uart_rx_task_handle);
+    BaseType_t task_created = xTaskCreatePinnedToCore(uart_rx_task, "uart_rx_task", 4096, NULL, s_uart_config.task_priority,
+                                                      &s_uart_rx_task_handle, s_uart_config.task_core);
     if (task_created != pdPASS) {
         ESP_LOGE(TAG, "Failed to create UART RX task");
+        if (s_uart_tx_task_handle) {
+            vTaskDelete(s_uart_tx_task_handle);
+            s_uart_tx_task_handle = NULL;
+        }
+        if (s_tx_defer_rb) {
+            vRingbufferDelete(s_tx_defer_rb);
+            s_tx_defer_rb = NULL;
+        }
         vSemaphoreDelete(s_tx_mutex);
         s_tx_mutex = NULL;
         uart_driver_delete(s_uart_config.port);
         return ESP_FAIL;
     }
 
+    s_m_rx_bytes = metrics_counter("uart.rx_bytes");
+    s_m_rx_chunks = metrics_counter("uart.rx_chunks");
+    s_m_rx_errors = metrics_counter("uart.rx_errors");
+    s_m_tx_bytes = metrics_counter("uart.tx_bytes");
+    s_m_tx_timeouts = metrics_counter("uart.tx_timeouts");
+    metrics_gauge_fn("uart.tx_deferred", read_tx_deferred, NULL);
+
     s_uart_initialized = true;
     ESP_LOGI(TAG, "UART%d initialized successfully.", s_uart_config.port);
     return ESP_OK;
 }
 
 esp_err_t uart_comm_transmit(const uint8_t *data, size_t len) {
+    if (!data || len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uart_comm_tx_part_t part = { .data = data, .len = len };
+    return uart_comm_transmit_parts(&part, 1, UART_COMM_WAIT_FOREVER);
+}
+
+static size_t tx_ring_free(void) {
+    size_t free_size = 0;
+    if (s_uart_config.tx_buffer_size <= 0 ||
+        uart_get_tx_buffer_free_size(s_uart_config.port, &free_size) != ESP_OK) {
+        return 0;
+    }
+    return free_size;
+}
+
+static esp_err_t write_parts_blocking(const uart_comm_tx_part_t *parts, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (parts[i].len == 0) continue;
+        int written = uart_write_bytes(s_uart_config.port, parts[i].data, parts[i].len);
+        if (written != (int)parts[i].len) {
+            ESP_LOGE(TAG, "UART write failed (wrote %d, expected %d)", written, parts[i].len);
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+// Queues all parts if there is room. Called with s_tx_mutex held.
+// Returns ESP_ERR_TIMEOUT if the caller should wait and retry, and
+// ESP_ERR_INVALID_SIZE once the caller owns the line for an oversize write.
+static esp_err_t tx_try_queue(const uart_comm_tx_part_t *parts, size_t count, size_t total) {
+    if (s_tx_owner != NULL) {
+        return ESP_ERR_TIMEOUT; // Another message is being streamed out
+    }
+    // Straight into the driver ring, unless older bytes are still deferred
+    if (s_tx_deferred == 0 && total <= tx_ring_free()) {
+        return write_parts_blocking(parts, count); // Fits, so uart_write_bytes only copies
+    }
+    if (s_tx_defer_rb && total <= xRingbufferGetCurFreeSize(s_tx_defer_rb)) {
+        for (size_t i = 0; i < count; i++) {
+            if (parts[i].len > 0) {
+                xRingbufferSend(s_tx_defer_rb, parts[i].data, parts[i].len, 0);
+            }
+        }
+        s_tx_deferred += total;
+        xTaskNotifyGive(s_uart_tx_task_handle);
+        return ESP_OK;
+    }
+    // Without any buffering, or for a message larger than all buffers together,
+    // claim the line once older bytes are out. The caller then writes without
+    // the mutex while other writers back off.
+    size_t capacity = (size_t)(s_uart_config.tx_buffer_size > 0 ? s_uart_config.tx_buffer_size : 0);
+    if (s_tx_defer_rb) {
+        capacity += (size_t)s_uart_config.tx_defer_size;
+    }
+    if (s_tx_deferred == 0 && total > capacity) {
+        s_tx_owner = xTaskGetCurrentTaskHandle();
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_ERR_TIMEOUT;
+}
+
+esp_err_t uart_comm_transmit_parts(const uart_comm_tx_part_t *parts, size_t count, uint32_t timeout_ms) {
     if (!s_uart_initialized) {
         ESP_LOGE(TAG, "UART not initialized, cannot transmit.");
         return ESP_FAIL;
     }
-    if (!data || len == 0) {
+    if (!parts || count == 0) {
         return ESP_ERR_INVALID_ARG;
     }
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!parts[i].data && parts[i].len > 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        total += parts[i].len;
+    }
+    if (total == 0) {
+        return ESP_OK;
+    }
 
-    esp_err_t ret = ESP_FAIL;
-    if (xSemaphoreTake(s_tx_mutex, portMAX_DELAY) == pdTRUE) {
-        int written = uart_write_bytes(s_uart_config.port, data, len);
-        if (written == (int)len) {
-            ret = ESP_OK;
-        } else {
-            ESP_LOGE(TAG, "UART write failed (wrote %d, expected %d)", written, len);
-            ret = ESP_FAIL;
+    // Time the UART needs to send `total` bytes (10 bits per byte), used as the retry interval
+    uint32_t drain_ms = (uint32_t)(total * 10 * 1000 / (size_t)s_uart_config.baud_rate);
+    TickType_t retry_ticks = pdMS_TO_TICKS(drain_ms) > 0 ? pdMS_TO_TICKS(drain_ms) : 1;
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout_ticks = pdMS_TO_TICKS(timeout_ms);
+    while (1) {
+        esp_err_t ret = ESP_ERR_TIMEOUT;
+        TickType_t mutex_wait = portMAX_DELAY;
+        if (timeout_ms != UART_COMM_WAIT_FOREVER) {
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            mutex_wait = elapsed < timeout_ticks ? timeout_ticks - elapsed : 0; // Whatever is left of the deadline
         }
-        xSemaphoreGive(s_tx_mutex);
-    } else {
-        ESP_LOGE(TAG, "Could not obtain TX mutex");
-        ret = ESP_FAIL; // Or a specific error like ESP_ERR_TIMEOUT
+        if (xSemaphoreTake(s_tx_mutex, mutex_wait) == pdTRUE) {
+            ret = tx_try_queue(parts, count, total);
+            xSemaphoreGive(s_tx_mutex);
+        }
+        if (ret == ESP_ERR_INVALID_SIZE) {
+            // This task owns the line: the blocking write runs without the mutex,
+            // so the TX task and other writers are never stuck behind it
+            ret = write_parts_blocking(parts, count);
+            xSemaphoreTake(s_tx_mutex, portMAX_DELAY);
+            s_tx_owner = NULL;
+            xSemaphoreGive(s_tx_mutex);
+        }
+        if (ret != ESP_ERR_TIMEOUT) {
+            if (ret == ESP_OK) {
+                metrics_add(s_m_tx_bytes, (uint32_t)total);
+            }
+            return ret;
+        }
+        if (timeout_ms != UART_COMM_WAIT_FOREVER &&
+            xTaskGetTickCount() - start + retry_ticks > timeout_ticks) {
+            ESP_LOGW(TAG, "No TX room for %d bytes within %" PRIu32 " ms", total, timeout_ms);
+            metrics_inc(s_m_tx_timeouts);
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(retry_ticks);
     }
-    return ret;
+}
+
+size_t uart_comm_tx_pending(void) {
+    if (!s_uart_initialized) {
+        return 0;
+    }
+    size_t in_ring = 0;
+    if (s_uart_config.tx_buffer_size > 0) {
+        size_t free_size = tx_ring_free();
+        in_ring = (size_t)s_uart_config.tx_buffer_size > free_size ? (size_t)s_uart_config.tx_buffer_size - free_size : 0;
+    }
+    return in_ring + s_tx_deferred;
 }
 
 esp_err_t uart_comm_deinit(void) {
@@ -130,6 +300,18 @@ esp_err_t uart_comm_deinit(void) {
         vTaskDelete(s_uart_rx_task_handle);
         s_uart_rx_task_handle = NULL;
     }
+    if (s_uart_tx_task_handle) {
+        // Take the mutex so the TX task is not deleted in the middle of a write
+        xSemaphoreTake(s_tx_mutex, portMAX_DELAY);
+        vTaskDelete(s_uart_tx_task_handle);
+        s_uart_tx_task_handle = NULL;
+        xSemaphoreGive(s_tx_mutex);
+    }
+    if (s_tx_defer_rb) {
+        vRingbufferDelete(s_tx_defer_rb); // Deferred bytes are discarded
+        s_tx_defer_rb = NULL;
+        s_tx_deferred = 0;
+    }
 
     esp_err_t ret = uart_driver_delete(s_uart_config.port);
     if (ret != ESP_OK) {
@@ -172,6 +354,8 @@ static void uart_rx_task(void *pvParameters) {
             // Null-terminate (optional, depends on expected data type)
             // rx_buffer[len] = '\0';
             ESP_LOGD(TAG, "UART%d Received %d bytes", s_uart_config.port, len);
+            metrics_add(s_m_rx_bytes, (uint32_t)len);
+            metrics_inc(s_m_rx_chunks);
             if (s_rx_callback) {
                 // Call the application-provided callback
                 s_rx_callback(rx_buffer, len);
@@ -182,12 +366,13 @@ static void uart_rx_task(void *pvParameters) {
 
         } else if (len < 0) {
             ESP_LOGE(TAG, "UART%d read error", s_uart_config.port);
-            // Handle error, maybe break loop or add delay?
+            metrics_inc(s_m_rx_errors);
+            // A driver error returns at once: back off instead of spinning on it
+            vTaskDelay(pdMS_TO_TICKS(10));
         }
-        // else len == 0 (timeout), just loop again
-
-        // Small delay to prevent busy-waiting if no data comes frequently
-        vTaskDelay(pdMS_TO_TICKS(10));
+        // else len == 0 (timeout), just loop again. No extra delay: the read
+        // above already sleeps while there is no data, and a delay here would
+        // only cap the rate at which chunks are handed on.
     }
 
     // Should not be reached unless loop is broken
@@ -195,4 +380,33 @@ static void uart_rx_task(void *pvParameters) {
     ESP_LOGW(TAG, "UART RX task exiting for UART%d.", s_uart_config.port);
     s_uart_rx_task_handle = NULL; // Mark task as gone
     vTaskDelete(NULL);
+}
+
+// Moves deferred bytes into the driver's TX ring as space frees up
+static void uart_tx_task(void *pvParameters) {
+    ESP_LOGI(TAG, "UART TX task started for UART%d.", s_uart_config.port);
+
+    while (1) {
+        if (s_tx_deferred == 0) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+
+        size_t room = (s_uart_config.tx_buffer_size > 0) ? tx_ring_free() : TX_UNBUFFERED_CHUNK;
+        bool progressed = false;
+        if (room > 0 && xSemaphoreTake(s_tx_mutex, portMAX_DELAY) == pdTRUE) {
+            size_t size = 0;
+            void *item = xRingbufferReceiveUpTo(s_tx_defer_rb, &size, 0, room);
+            if (item) {
+                uart_write_bytes(s_uart_config.port, item, size);
+                vRingbufferReturnItem(s_tx_defer_rb, item);
+                s_tx_deferred -= size;
+                progressed = true;
+            }
+            xSemaphoreGive(s_tx_mutex);
+        }
+        if (!progressed) {
+            // Ring full: wait for the hardware to drain it a bit
+            uart_wait_tx_done(s_uart_config.port, pdMS_TO_TICKS(10));
+        }
+    }
 }
\ No newline at end of file
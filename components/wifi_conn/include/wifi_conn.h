@@ -2,8 +2,13 @@
 #ifndef WIFI_CONN_H
 #define WIFI_CONN_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
 #include "esp_netif_types.h" // For esp_netif_ip_info_t
+#include "esp_wifi_types.h"  // For wifi_auth_mode_t
+
+#define WIFI_CONN_MAX_APS 8 /*!< Candidate networks in wifi_conn_config_t.aps */
 
 /**
  * @brief WiFi connection status enumeration.
@@ -15,6 +20,61 @@ typedef enum {
     WIFI_CONN_STATUS_CONNECTION_FAILED // Added for explicit failure signal
 } wifi_conn_status_t;
 
+/**
+ * @brief Power-save / latency trade-off of the station.
+ *
+ * In modem sleep the radio wakes for beacons only, so a downlink packet
+ * waits for the next DTIM beacon (typically 100-300 ms).
+ */
+typedef enum {
+    WIFI_CONN_PS_BALANCED = 0,  /*!< Modem sleep, wake every DTIM (WIFI_PS_MIN_MODEM, ESP-IDF default) */
+    WIFI_CONN_PS_LOW_LATENCY,   /*!< Radio always on (WIFI_PS_NONE): lowest downlink latency, highest current */
+    WIFI_CONN_PS_LOW_POWER,     /*!< Modem sleep, wake every listen_interval beacons (WIFI_PS_MAX_MODEM) */
+} wifi_conn_ps_profile_t;
+
+/**
+ * @brief A candidate network.
+ */
+typedef struct {
+    const char *ssid;           /*!< SSID */
+    const char *password;       /*!< Password (NULL or "" for an open network) */
+    int priority;               /*!< Preference; each step counts as much as 10 dB more signal */
+    wifi_auth_mode_t min_authmode; /*!< Weakest security accepted (WIFI_AUTH_OPEN: WPA2-PSK if a password is set) */
+} wifi_conn_ap_t;
+
+/**
+ * @brief WiFi station configuration.
+ */
+typedef struct {
+    const char *ssid;           /*!< SSID of the target Access Point (if aps is not used) */
+    const char *password;       /*!< Password of the target Access Point */
+    const wifi_conn_ap_t *aps;  /*!< Candidate networks (copied at init), used instead of ssid/password if ap_count > 0.
+                                     The scanned AP with the best signal, weighted by priority, is chosen. */
+    size_t ap_count;            /*!< Entries in aps (max WIFI_CONN_MAX_APS) */
+    int8_t roam_rssi;           /*!< Look for a better AP when the signal stays below this (dBm, 0 = no roaming) */
+    uint8_t roam_hysteresis_db; /*!< Only roam to an AP at least this much stronger than the current one (0 for 8) */
+    bool fast_reconnect;        /*!< Keep the last good BSSID, channel and DHCP lease in NVS and connect to that AP
+                                     directly, without a scan. Falls back to a full scan if it does not connect. */
+    bool reuse_ip_lease;        /*!< With fast_reconnect: use the cached lease as a static address and skip DHCP.
+                                     Only for networks whose DHCP server keeps leases stable (reserved addresses). */
+    esp_netif_ip_info_t static_ip; /*!< Fixed address, netmask and gateway (ip.addr = 0: DHCP) */
+    esp_ip4_addr_t static_dns;  /*!< DNS server used with static_ip (0 = none) */
+    wifi_conn_ps_profile_t ps_profile; /*!< Power-save profile, see wifi_conn_set_ps_profile() */
+    uint16_t listen_interval;   /*!< WIFI_CONN_PS_LOW_POWER: beacon intervals between wake-ups (0 for 3) */
+} wifi_conn_config_t;
+
+/**
+ * @brief Connection timing and fast-reconnect counters (see wifi_conn_get_stats()).
+ */
+typedef struct {
+    uint32_t boot_to_ip_ms;     /*!< Time from boot to the first IP_EVENT_STA_GOT_IP (0 = no address yet) */
+    uint32_t last_connect_ms;   /*!< Last (re)connect: from the first attempt to IP_EVENT_STA_GOT_IP */
+    uint32_t connects;          /*!< Addresses obtained */
+    uint32_t cached_connects;   /*!< ...of which with the cached BSSID/channel (no scan) */
+    uint32_t cache_misses;      /*!< Cached AP or lease that failed, followed by a full scan */
+    uint32_t roams;             /*!< Switches to a stronger AP because the signal was low */
+} wifi_conn_stats_t;
+
 /**
  * @brief Callback function type for WiFi status changes.
  *
@@ -31,13 +91,32 @@ typedef void (*wifi_conn_status_callback_t)(wifi_conn_status_t status, const esp
  * Requires NVS flash to be initialized beforehand by the main application.
  * Requires default event loop and netif to be created beforehand by the main application.
  *
- * @param ssid The SSID of the target Access Point.
- * @param password The password of the target Access Point.
+ * @param config Station configuration (SSID, password, fast reconnect and IP options).
  * @param status_cb Pointer to the callback function to be called on status changes.
  *                  The application *must* provide this callback.
  * @return esp_err_t ESP_OK on successful initiation, or an error code.
  */
-esp_err_t wifi_conn_init_sta(const char *ssid, const char *password, wifi_conn_status_callback_t status_cb);
+esp_err_t wifi_conn_init_sta(const wifi_conn_config_t *config, wifi_conn_status_callback_t status_cb);
+
+/**
+ * @brief Switches the power-save profile at runtime.
+ *
+ * The sleep mode changes at once. The listen interval of WIFI_CONN_PS_LOW_POWER
+ * is announced to the AP on association, so it applies from the next (re)connect.
+ *
+ * @param profile The new profile.
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_STATE if WiFi is not initialized,
+ *         or the error from esp_wifi_set_ps().
+ */
+esp_err_t wifi_conn_set_ps_profile(wifi_conn_ps_profile_t profile);
+
+/**
+ * @brief Reads the connection timing and fast-reconnect counters.
+ *
+ * @param out Destination for the counters.
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if out is NULL.
+ */
+esp_err_t wifi_conn_get_stats(wifi_conn_stats_t *out);
 
 /**
  * @brief Checks if the WiFi is currently connected (has an IP address).
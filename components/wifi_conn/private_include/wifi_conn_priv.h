@@ -0,0 +1,88 @@
+// components/wifi_conn/private_include/wifi_conn_priv.h
+#ifndef WIFI_CONN_PRIV_H
+#define WIFI_CONN_PRIV_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_netif_types.h"
+#include "esp_wifi_types.h"
+#include "wifi_conn.h"
+
+// Internal helpers shared between the wifi_conn source files.
+// Not part of the public component API.
+
+/**
+ * @brief Last good connection, kept in NVS to skip the scan (and optionally DHCP) next time.
+ */
+typedef struct {
+    uint32_t ssid_hash;          // The entry only applies to the network it was stored for
+    uint8_t bssid[6];
+    uint8_t channel;
+    esp_netif_ip_info_t ip_info; // DHCP lease
+    uint32_t dns;                // Main DNS server of the lease (network byte order, 0 = none)
+} wifi_conn_cache_t;
+
+/** @brief FNV-1a hash of the SSID, identifies the network of a cache entry. */
+uint32_t wifi_conn_cache_ssid_hash(const char *ssid);
+
+/** @brief Loads the stored entry; ESP_ERR_NOT_FOUND if there is none. */
+esp_err_t wifi_conn_cache_load(wifi_conn_cache_t *out);
+
+/** @brief Stores an entry; flash is only written when it differs from the stored one. */
+void wifi_conn_cache_save(const wifi_conn_cache_t *entry);
+
+void wifi_conn_cache_clear(void);
+
+// --- Internal events, so timer-driven work runs in the default event loop task ---
+
+ESP_EVENT_DECLARE_BASE(WIFI_CONN_EVENT);
+
+enum {
+    WIFI_CONN_EVENT_RETRY,      // Reconnect backoff expired
+    WIFI_CONN_EVENT_ROAM_CHECK, // Signal has been low for a while
+};
+
+// --- Candidate networks and AP selection (wifi_conn_select.c), event loop task only ---
+
+/**
+ * @brief A BSS (AP radio) found for one of the candidate networks.
+ */
+typedef struct {
+    int ap_index;      // Candidate the SSID belongs to
+    uint8_t bssid[6];
+    uint8_t channel;
+    int8_t rssi;
+} wifi_conn_bss_t;
+
+/** @brief Copies the candidate list; a password-protected network needs at least WPA2 unless set otherwise. */
+esp_err_t wifi_conn_select_init(const wifi_conn_ap_t *aps, size_t count);
+size_t wifi_conn_select_count(void);
+
+/** @brief Writes SSID, password and auth threshold of candidate `index` into a station config. */
+void wifi_conn_select_fill_config(int index, wifi_config_t *wifi_config);
+
+/** @brief wifi_conn_cache_ssid_hash() of candidate `index`, stored with the cache entry. */
+uint32_t wifi_conn_select_ssid_hash(int index);
+
+/** @brief Candidate whose SSID has this hash (wifi_conn_cache_ssid_hash()), -1 if none. */
+int wifi_conn_select_find_ssid_hash(uint32_t ssid_hash);
+
+/** @brief Starts a non-blocking scan; call wifi_conn_select_on_scan_done() on WIFI_EVENT_SCAN_DONE. */
+esp_err_t wifi_conn_select_start_scan(void);
+void wifi_conn_select_on_scan_done(void);
+
+/** @brief True while the last scan result may be reused instead of scanning. */
+bool wifi_conn_select_cache_fresh(void);
+
+/** @brief Best scored BSS of the cached scan; ESP_ERR_NOT_FOUND if no candidate was seen. */
+esp_err_t wifi_conn_select_best(wifi_conn_bss_t *out);
+
+/** @brief Lowers the score of a BSS that failed to connect. */
+void wifi_conn_select_on_failure(const uint8_t *bssid);
+
+/** @brief Forgets the scan result, so the next selection scans again. */
+void wifi_conn_select_invalidate(void);
+
+#endif // WIFI_CONN_PRIV_H
\ No newline at end of file
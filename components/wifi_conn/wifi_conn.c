@@ -1,17 +1,34 @@
 // components/wifi_conn/wifi_conn.c
 #include <string.h>
 #include "freertos/FreeRTOS.h"
-#include "freertos/task.h" // For vTaskDelay
 #include "freertos/event_groups.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_netif.h" // Required for IP info
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "conn_timing.h"
+#include "metrics.h"
 
 #include "wifi_conn.h" // Include own header
+#include "wifi_conn_priv.h"
 
-#define WIFI_CONN_MAX_RETRY 10 // Example: Limit explicit retries before pausing longer
-#define WIFI_CONN_RETRY_DELAY_MS 5000 // Delay between retries
+// Reconnect backoff: the first retry after a disconnect is immediate, the n-th
+// one waits random(0, min(MAX, BASE * 2^(n-2))) ms ("full jitter").
+#define WIFI_CONN_RETRY_BASE_MS 500
+#define WIFI_CONN_RETRY_MAX_MS 30000
+#define WIFI_CONN_RETRY_MAX_SHIFT 16
+
+#define WIFI_CONN_DEFAULT_LISTEN_INTERVAL 3 // Beacons, for WIFI_CONN_PS_LOW_POWER
+
+// Roaming: a low signal must persist for CONFIRM before a scan, and after a
+// scan that found nothing better the next one waits RECHECK.
+#define WIFI_CONN_ROAM_CONFIRM_MS 5000
+#define WIFI_CONN_ROAM_RECHECK_MS 30000
+#define WIFI_CONN_DEFAULT_ROAM_HYSTERESIS_DB 8
+
+ESP_EVENT_DEFINE_BASE(WIFI_CONN_EVENT);
 
 static const char *TAG = "WIFI_CONN";
 
@@ -20,29 +37,241 @@ static EventGroupHandle_t s_wifi_event_group = NULL;
 static wifi_conn_status_callback_t s_status_callback = NULL;
 static bool s_wifi_initialized = false;
 static bool s_wifi_started = false;
-static int s_retry_num = 0;
+static int s_retry_num = 0; // Consecutive failed attempts, only touched in the event loop task
+static esp_timer_handle_t s_retry_timer = NULL;
+static esp_timer_handle_t s_roam_timer = NULL;
+static esp_netif_t *s_sta_netif = NULL;
+
+// Connection state, only touched in the event loop task after init
+static wifi_conn_config_t s_config;
+static wifi_conn_bss_t s_target;          // BSS of the current attempt or connection
+static bool s_target_pending = false;     // Next attempt goes to s_target without selection
+static bool s_roam_scan = false;          // Scan in progress looks for a better AP
+static bool s_roaming = false;            // Disconnected on purpose to switch to s_target
+static wifi_conn_cache_t s_cache;
+static bool s_cache_valid = false;
+static bool s_using_cached_ap = false;    // Attempt went to a known BSS without scanning
+static bool s_using_cached_lease = false; // DHCP skipped, cached lease set as static IP
+static int64_t s_attempt_start_us = 0;    // Start of the current (re)connect
+static wifi_conn_stats_t s_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Runtime metrics (see metrics.h), registered by wifi_conn_init_sta()
+static const uint32_t s_connect_ms_bounds[] = { 250, 500, 1000, 2000, 4000, 8000, 16000 };
+static metric_t *s_m_connects;
+static metric_t *s_m_disconnects;
+static metric_t *s_m_cache_misses;
+static metric_t *s_m_roams;
+static metric_t *s_m_connect_ms;
+static metric_t *s_m_cached_connects;
+static metric_t *s_m_boot_to_ip_ms;
 
 // Event bits
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT      BIT1 // No longer means permanent fail, just failed connection attempt
 
 // Forward declarations
+static void retry_timer_cb(void *arg);
+static void roam_timer_cb(void *arg);
+static void schedule_retry(void);
+static void conn_event_handler(void* arg, esp_event_base_t event_base,
+                               int32_t event_id, void* event_data);
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                                int32_t event_id, void* event_data);
 static void ip_event_handler(void* arg, esp_event_base_t event_base,
                              int32_t event_id, void* event_data);
 
-esp_err_t wifi_conn_init_sta(const char *ssid, const char *password, wifi_conn_status_callback_t status_cb) {
+static wifi_ps_type_t ps_type(wifi_conn_ps_profile_t profile) {
+    switch (profile) {
+        case WIFI_CONN_PS_LOW_LATENCY: return WIFI_PS_NONE;
+        case WIFI_CONN_PS_LOW_POWER:   return WIFI_PS_MAX_MODEM;
+        default:                       return WIFI_PS_MIN_MODEM;
+    }
+}
+
+// Listen interval announced on association; 0 lets the driver use its default
+static void apply_listen_interval(wifi_config_t *wifi_config) {
+    if (s_config.ps_profile == WIFI_CONN_PS_LOW_POWER) {
+        wifi_config->sta.listen_interval = s_config.listen_interval ? s_config.listen_interval : WIFI_CONN_DEFAULT_LISTEN_INTERVAL;
+    } else {
+        wifi_config->sta.listen_interval = 0;
+    }
+}
+
+// Sets a fixed address and stops the DHCP client (IP_EVENT_STA_GOT_IP follows on connect)
+static esp_err_t set_static_ip(const esp_netif_ip_info_t *ip_info, uint32_t dns) {
+    esp_err_t ret = esp_netif_dhcpc_stop(s_sta_netif);
+    if (ret != ESP_OK && ret != ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED) {
+        return ret;
+    }
+    ret = esp_netif_set_ip_info(s_sta_netif, ip_info);
+    if (ret == ESP_OK && dns != 0) {
+        esp_netif_dns_info_t dns_info = { 0 };
+        dns_info.ip.u_addr.ip4.addr = dns;
+        dns_info.ip.type = ESP_IPADDR_TYPE_V4;
+        ret = esp_netif_set_dns_info(s_sta_netif, ESP_NETIF_DNS_MAIN, &dns_info);
+    }
+    return ret;
+}
+
+// Connects to one BSS: fixed BSSID and channel, so the driver does not scan all channels
+static void connect_to(const wifi_conn_bss_t *bss, bool known) {
+    wifi_config_t wifi_config = {
+        .sta = {
+            .pmf_cfg = {
+                .capable = true,
+                .required = false
+            },
+            // Both need CONFIG_ESP_WIFI_11KV_SUPPORT (sdkconfig), else the driver ignores them
+            .rm_enabled = 1,  // 802.11k: the AP may ask for radio measurements / offer neighbor reports
+            .btm_enabled = 1, // 802.11v: the AP may steer us to a better AP (BSS transition)
+        },
+    };
+    wifi_conn_select_fill_config(bss->ap_index, &wifi_config);
+    wifi_config.sta.bssid_set = true;
+    memcpy(wifi_config.sta.bssid, bss->bssid, sizeof(wifi_config.sta.bssid));
+    wifi_config.sta.channel = bss->channel;
+    apply_listen_interval(&wifi_config); // The profile may have changed meanwhile
+
+    s_target = *bss;
+    s_using_cached_ap = known;
+    ESP_LOGI(TAG, "Connecting to '%s' %02x:%02x:%02x:%02x:%02x:%02x (channel %d, %s)",
+             (const char *)wifi_config.sta.ssid, bss->bssid[0], bss->bssid[1], bss->bssid[2], bss->bssid[3],
+             bss->bssid[4], bss->bssid[5], bss->channel, known ? "known" : "scanned");
+    esp_err_t ret = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    if (ret == ESP_OK) {
+        ret = esp_wifi_connect();
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "esp_wifi_connect failed: %s", esp_err_to_name(ret));
+        if (s_status_callback) s_status_callback(WIFI_CONN_STATUS_CONNECTION_FAILED, NULL);
+        s_retry_num++; // No disconnect event follows, so retry from here
+        schedule_retry();
+    }
+}
+
+// Next attempt: the known BSS if one is pending, else the best candidate of a (cached) scan
+static void connect_next(void) {
+    if (s_target_pending) {
+        s_target_pending = false;
+        connect_to(&s_target, true);
+        return;
+    }
+    if (!wifi_conn_select_cache_fresh()) {
+        esp_err_t ret = wifi_conn_select_start_scan();
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Scan failed to start: %s", esp_err_to_name(ret));
+            s_retry_num++;
+            schedule_retry();
+        }
+        return; // Continues on WIFI_EVENT_SCAN_DONE
+    }
+    wifi_conn_bss_t bss;
+    if (wifi_conn_select_best(&bss) != ESP_OK) {
+        ESP_LOGW(TAG, "None of the %u candidate networks is in range", (unsigned)wifi_conn_select_count());
+        wifi_conn_select_invalidate(); // Scan again on the next attempt
+        s_retry_num++;
+        schedule_retry();
+        return;
+    }
+    connect_to(&bss, false);
+}
+
+// The cached AP or lease did not lead to a connection: forget it, scan and use DHCP
+static void fall_back_to_scan(void) {
+    ESP_LOGW(TAG, "Known AP %02x:%02x:%02x:%02x:%02x:%02x (channel %d) failed, falling back to a scan",
+             s_target.bssid[0], s_target.bssid[1], s_target.bssid[2], s_target.bssid[3], s_target.bssid[4],
+             s_target.bssid[5], s_target.channel);
+    if (s_using_cached_lease) {
+        esp_netif_dhcpc_start(s_sta_netif);
+        s_using_cached_lease = false;
+    }
+    s_cache_valid = false;
+    wifi_conn_cache_clear();
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.cache_misses++;
+    taskEXIT_CRITICAL(&s_stats_lock);
+    metrics_inc(s_m_cache_misses);
+}
+
+// Remembers the AP and lease of the connection that just got its address
+static void update_cache(const esp_netif_ip_info_t *ip_info) {
+    wifi_conn_cache_t entry;
+    memset(&entry, 0, sizeof(entry)); // Padding included, entries are compared bytewise
+    entry.ssid_hash = wifi_conn_select_ssid_hash(s_target.ap_index);
+    memcpy(entry.bssid, s_target.bssid, sizeof(entry.bssid));
+    entry.channel = s_target.channel;
+    entry.ip_info = *ip_info;
+    esp_netif_dns_info_t dns_info;
+    if (esp_netif_get_dns_info(s_sta_netif, ESP_NETIF_DNS_MAIN, &dns_info) == ESP_OK &&
+        dns_info.ip.type == ESP_IPADDR_TYPE_V4) {
+        entry.dns = dns_info.ip.u_addr.ip4.addr;
+    }
+    if (s_using_cached_lease) {
+        entry.ip_info = s_cache.ip_info; // Unchanged, we did not ask the DHCP server
+        entry.dns = s_cache.dns;
+    }
+    s_cache = entry;
+    s_cache_valid = true;
+    wifi_conn_cache_save(&entry);
+}
+
+// RSSI of the current AP, 0 while not connected
+static int32_t read_rssi(void *ctx) {
+    wifi_ap_record_t ap;
+    return (wifi_conn_is_connected() && esp_wifi_sta_get_ap_info(&ap) == ESP_OK) ? ap.rssi : 0;
+}
+
+esp_err_t wifi_conn_init_sta(const wifi_conn_config_t *config, wifi_conn_status_callback_t status_cb) {
     if (s_wifi_initialized) {
         ESP_LOGW(TAG, "WiFi already initialized.");
         return ESP_OK;
     }
-    if (!ssid || !password || !status_cb) {
+    if (!config || (config->ap_count == 0 && !config->ssid) || !status_cb) {
         return ESP_ERR_INVALID_ARG;
     }
+    // Without a list, ssid/password are the only candidate
+    const wifi_conn_ap_t single = { .ssid = config->ssid, .password = config->password };
+    esp_err_t ret = config->ap_count ? wifi_conn_select_init(config->aps, config->ap_count)
+                                     : wifi_conn_select_init(&single, 1);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Invalid candidate network list");
+        return ret;
+    }
 
     ESP_LOGI(TAG, "Initializing WiFi STA mode...");
     s_status_callback = status_cb;
+    s_config = *config;
+    s_config.aps = NULL; // Copied by wifi_conn_select_init()
+    if (s_config.roam_hysteresis_db == 0) {
+        s_config.roam_hysteresis_db = WIFI_CONN_DEFAULT_ROAM_HYSTERESIS_DB;
+    }
+    int cached_index = -1;
+    if (config->fast_reconnect && wifi_conn_cache_load(&s_cache) == ESP_OK) {
+        cached_index = wifi_conn_select_find_ssid_hash(s_cache.ssid_hash); // Entry of a network no longer listed is ignored
+    }
+    s_cache_valid = (cached_index >= 0);
+    s_target_pending = s_cache_valid; // First attempt skips the scan
+    if (s_cache_valid) {
+        s_target.ap_index = cached_index;
+        memcpy(s_target.bssid, s_cache.bssid, sizeof(s_target.bssid));
+        s_target.channel = s_cache.channel;
+        s_target.rssi = 0;
+    }
+    s_roam_scan = false;
+    s_roaming = false;
+    s_using_cached_ap = false;
+    s_using_cached_lease = false;
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_m_connects = metrics_counter("wifi.connects");
+    s_m_disconnects = metrics_counter("wifi.disconnects");
+    s_m_cache_misses = metrics_counter("wifi.cache_misses");
+    s_m_roams = metrics_counter("wifi.roams");
+    s_m_connect_ms = metrics_histogram("wifi.connect_ms", s_connect_ms_bounds,
+                                       sizeof(s_connect_ms_bounds) / sizeof(s_connect_ms_bounds[0]));
+    s_m_cached_connects = metrics_counter("wifi.cached_connects");
+    s_m_boot_to_ip_ms = metrics_gauge("wifi.boot_to_ip_ms");
+    metrics_gauge_fn("wifi.rssi", read_rssi, NULL);
 
     s_wifi_event_group = xEventGroupCreate();
     if (s_wifi_event_group == NULL) {
@@ -53,6 +282,7 @@ esp_err_t wifi_conn_init_sta(const char *ssid, const char *password, wifi_conn_s
     // NOTE: Assumes esp_netif_init() and esp_event_loop_create_default()
     // have been called in the main application.
     esp_netif_t *sta_netif = esp_netif_create_default_wifi_sta();
+    s_sta_netif = sta_netif;
      if (sta_netif == NULL) {
         ESP_LOGE(TAG, "Failed to create default STA netif");
         vEventGroupDelete(s_wifi_event_group);
@@ -61,10 +291,38 @@ esp_err_t wifi_conn_init_sta(const char *ssid, const char *password, wifi_conn_s
     }
 
 
+    const esp_timer_create_args_t timer_args = {
+        .callback = retry_timer_cb,
+        .name = "wifi_retry",
+    };
+    const esp_timer_create_args_t roam_timer_args = {
+        .callback = roam_timer_cb,
+        .name = "wifi_roam",
+    };
+    ret = esp_timer_create(&timer_args, &s_retry_timer);
+    if (ret == ESP_OK) {
+        ret = esp_timer_create(&roam_timer_args, &s_roam_timer);
+        if (ret != ESP_OK) {
+            esp_timer_delete(s_retry_timer);
+            s_retry_timer = NULL;
+        }
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create timers: %s", esp_err_to_name(ret));
+        vEventGroupDelete(s_wifi_event_group);
+        s_wifi_event_group = NULL;
+        esp_netif_destroy(sta_netif);
+        return ret;
+    }
+
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    esp_err_t ret = esp_wifi_init(&cfg);
+    ret = esp_wifi_init(&cfg);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "esp_wifi_init failed: %s", esp_err_to_name(ret));
+        esp_timer_delete(s_retry_timer);
+        s_retry_timer = NULL;
+        esp_timer_delete(s_roam_timer);
+        s_roam_timer = NULL;
         vEventGroupDelete(s_wifi_event_group);
         s_wifi_event_group = NULL;
         esp_netif_destroy(sta_netif); // Clean up netif
@@ -76,28 +334,26 @@ esp_err_t wifi_conn_init_sta(const char *ssid, const char *password, wifi_conn_s
     if (ret != ESP_OK) goto cleanup;
     ret = esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &ip_event_handler, NULL);
     if (ret != ESP_OK) goto cleanup_wifi_handler;
+    ret = esp_event_handler_register(WIFI_CONN_EVENT, ESP_EVENT_ANY_ID, &conn_event_handler, NULL);
+    if (ret != ESP_OK) goto cleanup_ip_handler;
 
-
-    wifi_config_t wifi_config = {
-        .sta = {
-            .threshold.authmode = WIFI_AUTH_WPA2_PSK, // Or adjust as needed
-            .pmf_cfg = {
-                .capable = true,
-                .required = false
-            },
-        },
-    };
-    strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid) - 1);
-    wifi_config.sta.ssid[sizeof(wifi_config.sta.ssid) - 1] = '\0'; // Ensure null termination
-    strncpy((char *)wifi_config.sta.password, password, sizeof(wifi_config.sta.password) - 1);
-    wifi_config.sta.password[sizeof(wifi_config.sta.password) - 1] = '\0'; // Ensure null termination
+    if (config->static_ip.ip.addr != 0) {
+        ret = set_static_ip(&config->static_ip, config->static_dns.addr);
+        if (ret != ESP_OK) goto cleanup_ip_handler;
+    } else if (s_cache_valid && config->reuse_ip_lease && s_cache.ip_info.ip.addr != 0) {
+        ret = set_static_ip(&s_cache.ip_info, s_cache.dns);
+        s_using_cached_lease = (ret == ESP_OK); // Otherwise DHCP as usual
+    }
+    ESP_LOGI(TAG, "Connecting with %s AP (%u candidates), %s", s_cache_valid ? "cached" : "scanned",
+             (unsigned)wifi_conn_select_count(),
+             config->static_ip.ip.addr ? "static IP" : (s_using_cached_lease ? "cached IP lease" : "DHCP"));
 
     ret = esp_wifi_set_mode(WIFI_MODE_STA);
-    if (ret != ESP_OK) goto cleanup_ip_handler;
-    ret = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
-    if (ret != ESP_OK) goto cleanup_ip_handler;
-    ret = esp_wifi_start();
-    if (ret != ESP_OK) goto cleanup_ip_handler;
+    if (ret != ESP_OK) goto cleanup_conn_handler;
+    ret = esp_wifi_set_ps(ps_type(config->ps_profile));
+    if (ret != ESP_OK) goto cleanup_conn_handler;
+    ret = esp_wifi_start(); // Station config is set per attempt, from WIFI_EVENT_STA_START on
+    if (ret != ESP_OK) goto cleanup_conn_handler;
 
     s_wifi_started = true;
     s_wifi_initialized = true;
@@ -105,13 +361,20 @@ esp_err_t wifi_conn_init_sta(const char *ssid, const char *password, wifi_conn_s
     return ESP_OK;
 
 // Cleanup labels
+cleanup_conn_handler:
+    esp_event_handler_unregister(WIFI_CONN_EVENT, ESP_EVENT_ANY_ID, &conn_event_handler);
 cleanup_ip_handler:
     esp_event_handler_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, &ip_event_handler);
 cleanup_wifi_handler:
     esp_event_handler_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler);
 cleanup:
     esp_wifi_deinit(); // Deinit wifi stack
+    esp_timer_delete(s_retry_timer);
+    s_retry_timer = NULL;
+    esp_timer_delete(s_roam_timer);
+    s_roam_timer = NULL;
     esp_netif_destroy(sta_netif); // Clean up netif
+    s_sta_netif = NULL;
     vEventGroupDelete(s_wifi_event_group);
     s_wifi_event_group = NULL;
     ESP_LOGE(TAG, "WiFi STA initialization failed during setup: %s", esp_err_to_name(ret));
@@ -119,6 +382,30 @@ cleanup:
 
 }
 
+esp_err_t wifi_conn_set_ps_profile(wifi_conn_ps_profile_t profile) {
+    if (!s_wifi_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t ret = esp_wifi_set_ps(ps_type(profile));
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "esp_wifi_set_ps failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    s_config.ps_profile = profile; // Listen interval is applied before the next association
+    ESP_LOGI(TAG, "Power-save profile %d", profile);
+    return ESP_OK;
+}
+
+esp_err_t wifi_conn_get_stats(wifi_conn_stats_t *out) {
+    if (!out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    taskENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    taskEXIT_CRITICAL(&s_stats_lock);
+    return ESP_OK;
+}
+
 bool wifi_conn_is_connected(void) {
     if (!s_wifi_event_group) return false;
     return (xEventGroupGetBits(s_wifi_event_group) & WIFI_CONNECTED_BIT) != 0;
@@ -133,9 +420,21 @@ esp_err_t wifi_conn_deinit(void) {
     esp_err_t ret = ESP_OK;
 
     // Unregister handlers first
+    esp_event_handler_unregister(WIFI_CONN_EVENT, ESP_EVENT_ANY_ID, &conn_event_handler);
     esp_event_handler_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, &ip_event_handler);
     esp_event_handler_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler);
 
+    if (s_retry_timer) {
+        esp_timer_stop(s_retry_timer);
+        esp_timer_delete(s_retry_timer);
+        s_retry_timer = NULL;
+    }
+    if (s_roam_timer) {
+        esp_timer_stop(s_roam_timer);
+        esp_timer_delete(s_roam_timer);
+        s_roam_timer = NULL;
+    }
+
     if (s_wifi_started) {
         ret = esp_wifi_stop();
         if (ret != ESP_OK) {
@@ -151,9 +450,9 @@ esp_err_t wifi_conn_deinit(void) {
         // Continue deinit
     }
 
-    esp_netif_t *sta_netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
-    if (sta_netif) {
-        esp_netif_destroy(sta_netif);
+    if (s_sta_netif) {
+        esp_netif_destroy(s_sta_netif);
+        s_sta_netif = NULL;
     }
 
 
@@ -170,38 +469,160 @@ esp_err_t wifi_conn_deinit(void) {
     return ret; // Return the last significant error code
 }
 
+// --- Reconnect Scheduling ---
+
+// Timers run in the esp_timer task; the work is handed to the event loop task,
+// which owns the connection state. If its queue is full, try again shortly.
+static void post_or_rearm(int32_t event_id, esp_timer_handle_t timer) {
+    if (esp_event_post(WIFI_CONN_EVENT, event_id, NULL, 0, 0) != ESP_OK) {
+        esp_timer_start_once(timer, 100 * 1000);
+    }
+}
+
+static void retry_timer_cb(void *arg) {
+    post_or_rearm(WIFI_CONN_EVENT_RETRY, s_retry_timer);
+}
+
+static void roam_timer_cb(void *arg) {
+    post_or_rearm(WIFI_CONN_EVENT_ROAM_CHECK, s_roam_timer);
+}
+
+static void schedule_retry(void) {
+    if (esp_timer_is_active(s_retry_timer)) {
+        return; // An attempt is already scheduled
+    }
+    uint32_t delay_ms = 0;
+    if (s_retry_num > 1) {
+        int shift = s_retry_num - 2 < WIFI_CONN_RETRY_MAX_SHIFT ? s_retry_num - 2 : WIFI_CONN_RETRY_MAX_SHIFT;
+        uint64_t window_ms = (uint64_t)WIFI_CONN_RETRY_BASE_MS << shift;
+        if (window_ms > WIFI_CONN_RETRY_MAX_MS) {
+            window_ms = WIFI_CONN_RETRY_MAX_MS;
+        }
+        delay_ms = (uint32_t)(esp_random() % (window_ms + 1));
+    }
+    ESP_LOGI(TAG, "Retrying connection (attempt %d) in %u ms...", s_retry_num, (unsigned)delay_ms);
+    esp_timer_start_once(s_retry_timer, (uint64_t)delay_ms * 1000);
+}
+
+// --- Roaming ---
+
+// Arms the driver's low-signal event (WIFI_EVENT_STA_BSS_RSSI_LOW), which fires once per call
+static void arm_roam_threshold(void) {
+    if (s_config.roam_rssi != 0) {
+        esp_wifi_set_rssi_threshold(s_config.roam_rssi);
+    }
+}
+
+// The signal stayed low: scan for a stronger AP of any candidate network
+static void roam_check(void) {
+    wifi_ap_record_t ap;
+    if (!wifi_conn_is_connected() || esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return;
+    }
+    if (ap.rssi >= s_config.roam_rssi) {
+        arm_roam_threshold(); // Recovered
+        return;
+    }
+    ESP_LOGI(TAG, "Signal %d dBm below %d dBm, scanning for a better AP", ap.rssi, s_config.roam_rssi);
+    s_roam_scan = (wifi_conn_select_start_scan() == ESP_OK);
+    if (!s_roam_scan) {
+        esp_timer_start_once(s_roam_timer, (uint64_t)WIFI_CONN_ROAM_RECHECK_MS * 1000);
+    }
+}
+
+// Scan for roaming is done: switch if another AP is clearly stronger
+static void roam_decide(void) {
+    wifi_ap_record_t ap;
+    if (!wifi_conn_is_connected() || esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return;
+    }
+    wifi_conn_bss_t best;
+    if (wifi_conn_select_best(&best) == ESP_OK && memcmp(best.bssid, ap.bssid, sizeof(best.bssid)) != 0 &&
+        best.rssi >= ap.rssi + s_config.roam_hysteresis_db) {
+        ESP_LOGI(TAG, "Roaming from %d dBm to %02x:%02x:%02x:%02x:%02x:%02x at %d dBm", ap.rssi,
+                 best.bssid[0], best.bssid[1], best.bssid[2], best.bssid[3], best.bssid[4], best.bssid[5], best.rssi);
+        s_target = best;
+        s_roaming = true;
+        taskENTER_CRITICAL(&s_stats_lock);
+        s_stats.roams++;
+        taskEXIT_CRITICAL(&s_stats_lock);
+        metrics_inc(s_m_roams);
+        esp_wifi_disconnect(); // Reconnects to s_target from the disconnect event
+        return;
+    }
+    // Nothing better in range: look again later while the signal stays low
+    esp_timer_start_once(s_roam_timer, (uint64_t)WIFI_CONN_ROAM_RECHECK_MS * 1000);
+}
+
 // --- Internal Event Handlers ---
 
+static void conn_event_handler(void* arg, esp_event_base_t event_base,
+                               int32_t event_id, void* event_data)
+{
+    if (event_id == WIFI_CONN_EVENT_RETRY) {
+        connect_next();
+    } else if (event_id == WIFI_CONN_EVENT_ROAM_CHECK) {
+        roam_check();
+    }
+}
+
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                                int32_t event_id, void* event_data)
 {
     if (event_id == WIFI_EVENT_STA_START) {
         ESP_LOGI(TAG, "WIFI_EVENT_STA_START received, attempting to connect...");
+        s_attempt_start_us = esp_timer_get_time();
+        conn_timing_begin();
         if (s_status_callback) s_status_callback(WIFI_CONN_STATUS_CONNECTING, NULL);
-        esp_err_t ret = esp_wifi_connect();
-        if (ret != ESP_OK) {
-             ESP_LOGE(TAG, "esp_wifi_connect failed on start: %s", esp_err_to_name(ret));
-             // Maybe notify failure? Or let disconnect event handle it.
-             if (s_status_callback) s_status_callback(WIFI_CONN_STATUS_CONNECTION_FAILED, NULL);
+        connect_next();
+    } else if (event_id == WIFI_EVENT_SCAN_DONE) {
+        wifi_conn_select_on_scan_done();
+        if (s_roam_scan) {
+            s_roam_scan = false;
+            roam_decide();
+        } else if (!wifi_conn_is_connected() && !esp_timer_is_active(s_retry_timer)) {
+            conn_timing_mark(CONN_TIMING_WIFI_SCAN);
+            connect_next();
+        }
+    } else if (event_id == WIFI_EVENT_STA_CONNECTED) {
+        conn_timing_mark(CONN_TIMING_WIFI_CONNECTED);
+    } else if (event_id == WIFI_EVENT_STA_BSS_RSSI_LOW) {
+        if (wifi_conn_is_connected() && !esp_timer_is_active(s_roam_timer)) {
+            esp_timer_start_once(s_roam_timer, (uint64_t)WIFI_CONN_ROAM_CONFIRM_MS * 1000);
         }
     } else if (event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        ESP_LOGW(TAG, "WIFI_EVENT_STA_DISCONNECTED received.");
+        wifi_event_sta_disconnected_t *event = (wifi_event_sta_disconnected_t *)event_data;
+        ESP_LOGW(TAG, "WIFI_EVENT_STA_DISCONNECTED received (reason %d).", event->reason);
         s_retry_num++;
         // Clear connected bit
-        xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        bool was_connected = (xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT) & WIFI_CONNECTED_BIT) != 0;
+        esp_timer_stop(s_roam_timer);
+        s_roam_scan = false;
+        if (was_connected) {
+            metrics_inc(s_m_disconnects);
+        }
+        if (s_roaming) {
+            s_roaming = false;
+            s_target_pending = true; // Chosen by roam_decide()
+            s_attempt_start_us = esp_timer_get_time();
+            conn_timing_begin();
+        } else if (was_connected) {
+            s_target_pending = true; // Reconnect to the AP we just lost without scanning first
+            s_attempt_start_us = esp_timer_get_time();
+            conn_timing_begin();
+        } else {
+            conn_timing_mark(CONN_TIMING_WIFI_START); // Counted as a retry of the open attempt
+            wifi_conn_select_on_failure(s_target.bssid);
+            if (s_using_cached_ap || s_using_cached_lease) {
+                fall_back_to_scan();
+            }
+        }
         // Notify application
         if (s_status_callback) s_status_callback(WIFI_CONN_STATUS_DISCONNECTED, NULL);
 
-        // Persistent Retry Logic
-        ESP_LOGI(TAG, "Retrying connection (attempt %d)...", s_retry_num);
+        // Persistent Retry Logic, scheduled on a timer so this handler returns at once
         if (s_status_callback) s_status_callback(WIFI_CONN_STATUS_CONNECTING, NULL); // Notify that we are trying again
-        vTaskDelay(pdMS_TO_TICKS(WIFI_CONN_RETRY_DELAY_MS));
-        esp_err_t ret = esp_wifi_connect();
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "esp_wifi_connect failed on retry: %s", esp_err_to_name(ret));
-            // If connect itself fails immediately, maybe signal failure?
-             if (s_status_callback) s_status_callback(WIFI_CONN_STATUS_CONNECTION_FAILED, NULL);
-        }
+        schedule_retry();
     }
 }
 
@@ -211,8 +632,41 @@ static void ip_event_handler(void* arg, esp_event_base_t event_base,
     if (event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "IP_EVENT_STA_GOT_IP received: " IPSTR, IP2STR(&event->ip_info.ip));
+        conn_timing_mark(CONN_TIMING_GOT_IP);
         s_retry_num = 0; // Reset retry counter on success
+
+        int64_t now = esp_timer_get_time();
+        taskENTER_CRITICAL(&s_stats_lock);
+        if (s_stats.boot_to_ip_ms == 0) {
+            s_stats.boot_to_ip_ms = (uint32_t)(now / 1000);
+        }
+        s_stats.last_connect_ms = (uint32_t)((now - s_attempt_start_us) / 1000);
+        s_stats.connects++;
+        if (s_using_cached_ap) {
+            s_stats.cached_connects++;
+        }
+        wifi_conn_stats_t stats = s_stats;
+        taskEXIT_CRITICAL(&s_stats_lock);
+        metrics_inc(s_m_connects);
+        metrics_observe(s_m_connect_ms, stats.last_connect_ms);
+        metrics_set(s_m_boot_to_ip_ms, (int32_t)stats.boot_to_ip_ms);
+        if (s_using_cached_ap) {
+            metrics_inc(s_m_cached_connects);
+        }
+        ESP_LOGI(TAG, "Got IP %u ms after connect start (%u ms after boot), %s AP",
+                 (unsigned)stats.last_connect_ms, (unsigned)(now / 1000), s_using_cached_ap ? "known" : "scanned");
+        wifi_ap_record_t ap;
+        if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+            // The AP may have steered us elsewhere (802.11v) since the attempt started
+            memcpy(s_target.bssid, ap.bssid, sizeof(s_target.bssid));
+            s_target.channel = ap.primary;
+            s_target.rssi = ap.rssi;
+        }
+        if (s_config.fast_reconnect) {
+            update_cache(&event->ip_info);
+        }
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        arm_roam_threshold();
         // Notify application
         if (s_status_callback) s_status_callback(WIFI_CONN_STATUS_CONNECTED_GOT_IP, &event->ip_info);
     }
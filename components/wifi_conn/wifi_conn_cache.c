@@ -0,0 +1,66 @@
+// components/wifi_conn/wifi_conn_cache.c
+// NVS cache of the last good AP (BSSID, channel) and DHCP lease. Presetting
+// them skips the all-channel scan and, if enabled, the DHCP exchange, which
+// together make up most of the time from boot to the first IP address.
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "wifi_conn_priv.h"
+
+static const char *TAG = "WIFI_CACHE";
+
+#define NVS_NAMESPACE "wifi_conn"
+#define KEY_AP_CACHE "ap_cache"
+
+uint32_t wifi_conn_cache_ssid_hash(const char *ssid) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (const char *p = ssid; *p; p++) {
+        hash ^= (uint8_t)*p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+esp_err_t wifi_conn_cache_load(wifi_conn_cache_t *out) {
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (ret != ESP_OK) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    size_t len = sizeof(*out);
+    ret = nvs_get_blob(nvs, KEY_AP_CACHE, out, &len);
+    nvs_close(nvs);
+    if (ret != ESP_OK || len != sizeof(*out) || out->channel == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+void wifi_conn_cache_save(const wifi_conn_cache_t *entry) {
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to open NVS namespace '%s'", NVS_NAMESPACE);
+        return;
+    }
+    wifi_conn_cache_t stored;
+    size_t len = sizeof(stored);
+    // Only written when something changed, so flash is not worn by reconnects
+    if (nvs_get_blob(nvs, KEY_AP_CACHE, &stored, &len) != ESP_OK || len != sizeof(stored) ||
+        memcmp(&stored, entry, sizeof(stored)) != 0) {
+        if (nvs_set_blob(nvs, KEY_AP_CACHE, entry, sizeof(*entry)) == ESP_OK) {
+            nvs_commit(nvs);
+        }
+    }
+    nvs_close(nvs);
+}
+
+void wifi_conn_cache_clear(void) {
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    if (nvs_erase_key(nvs, KEY_AP_CACHE) == ESP_OK) {
+        nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+}
\ No newline at end of file
@@ -0,0 +1,173 @@
+// components/wifi_conn/wifi_conn_select.c
+// Candidate networks and AP selection.
+//
+// A scan result is kept for WIFI_CONN_SCAN_CACHE_MS, so reconnects and retries
+// pick the next AP without scanning again. Each BSS seen for a candidate SSID
+// is scored as rssi + WIFI_CONN_PRIORITY_DB * priority, minus a penalty for
+// every failed attempt on it, and the highest score is tried first.
+// Only used from the default event loop task.
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "wifi_conn_priv.h"
+
+static const char *TAG = "WIFI_SELECT";
+
+#define WIFI_CONN_SCAN_MAX 16           // BSS entries kept from one scan
+#define WIFI_CONN_SCAN_CACHE_MS 30000   // Scan results are reused this long
+#define WIFI_CONN_PRIORITY_DB 10        // One priority step is worth this much signal
+#define WIFI_CONN_FAILURE_PENALTY_DB 20 // Per failed attempt on a BSS
+
+typedef struct {
+    uint8_t ssid[33];
+    uint8_t password[65];
+    int priority;
+    wifi_auth_mode_t min_authmode;
+} candidate_t;
+
+typedef struct {
+    wifi_conn_bss_t bss;
+    uint8_t failures;
+} scan_entry_t;
+
+static candidate_t s_candidates[WIFI_CONN_MAX_APS];
+static size_t s_candidate_count = 0;
+static scan_entry_t s_scan[WIFI_CONN_SCAN_MAX];
+static size_t s_scan_count = 0;
+static int64_t s_scan_time_us = 0; // 0 = no valid scan
+
+esp_err_t wifi_conn_select_init(const wifi_conn_ap_t *aps, size_t count) {
+    if (count == 0 || count > WIFI_CONN_MAX_APS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(s_candidates, 0, sizeof(s_candidates));
+    for (size_t i = 0; i < count; i++) {
+        if (!aps[i].ssid || strlen(aps[i].ssid) >= sizeof(s_candidates[i].ssid) ||
+            (aps[i].password && strlen(aps[i].password) >= sizeof(s_candidates[i].password))) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        strlcpy((char *)s_candidates[i].ssid, aps[i].ssid, sizeof(s_candidates[i].ssid));
+        strlcpy((char *)s_candidates[i].password, aps[i].password ? aps[i].password : "", sizeof(s_candidates[i].password));
+        s_candidates[i].priority = aps[i].priority;
+        s_candidates[i].min_authmode = aps[i].min_authmode;
+        if (s_candidates[i].min_authmode == WIFI_AUTH_OPEN && s_candidates[i].password[0] != '\0') {
+            s_candidates[i].min_authmode = WIFI_AUTH_WPA2_PSK;
+        }
+    }
+    s_candidate_count = count;
+    wifi_conn_select_invalidate();
+    return ESP_OK;
+}
+
+size_t wifi_conn_select_count(void) {
+    return s_candidate_count;
+}
+
+void wifi_conn_select_fill_config(int index, wifi_config_t *wifi_config) {
+    const candidate_t *c = &s_candidates[index];
+    memcpy(wifi_config->sta.ssid, c->ssid, sizeof(wifi_config->sta.ssid)); // Not terminated at 32 chars, as the driver expects
+    strlcpy((char *)wifi_config->sta.password, (const char *)c->password, sizeof(wifi_config->sta.password));
+    wifi_config->sta.threshold.authmode = c->min_authmode;
+}
+
+uint32_t wifi_conn_select_ssid_hash(int index) {
+    return wifi_conn_cache_ssid_hash((const char *)s_candidates[index].ssid);
+}
+
+int wifi_conn_select_find_ssid_hash(uint32_t ssid_hash) {
+    for (size_t i = 0; i < s_candidate_count; i++) {
+        if (wifi_conn_cache_ssid_hash((const char *)s_candidates[i].ssid) == ssid_hash) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+esp_err_t wifi_conn_select_start_scan(void) {
+    const wifi_scan_config_t scan_config = {
+        .ssid = s_candidate_count == 1 ? s_candidates[0].ssid : NULL, // Directed probe for a single (hidden) SSID
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+    };
+    esp_err_t ret = esp_wifi_scan_start(&scan_config, false); // WIFI_EVENT_SCAN_DONE follows
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "esp_wifi_scan_start failed: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+static int find_candidate(const uint8_t *ssid) {
+    for (size_t i = 0; i < s_candidate_count; i++) {
+        if (strncmp((const char *)s_candidates[i].ssid, (const char *)ssid, 32) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+void wifi_conn_select_on_scan_done(void) {
+    uint16_t ap_num = 0;
+    esp_wifi_scan_get_ap_num(&ap_num);
+    wifi_ap_record_t *records = ap_num ? calloc(ap_num, sizeof(wifi_ap_record_t)) : NULL;
+    if (!records) {
+        esp_wifi_clear_ap_list(); // Frees the driver's copy
+        s_scan_count = 0;
+        s_scan_time_us = ap_num ? 0 : esp_timer_get_time(); // An empty result is still a result
+        return;
+    }
+    esp_wifi_scan_get_ap_records(&ap_num, records);
+
+    s_scan_count = 0;
+    for (uint16_t i = 0; i < ap_num && s_scan_count < WIFI_CONN_SCAN_MAX; i++) {
+        int index = find_candidate(records[i].ssid);
+        if (index < 0 || records[i].authmode < s_candidates[index].min_authmode) {
+            continue;
+        }
+        scan_entry_t *entry = &s_scan[s_scan_count++];
+        entry->bss.ap_index = index;
+        memcpy(entry->bss.bssid, records[i].bssid, sizeof(entry->bss.bssid));
+        entry->bss.channel = records[i].primary;
+        entry->bss.rssi = records[i].rssi;
+        entry->failures = 0;
+    }
+    free(records);
+    s_scan_time_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "Scan: %d APs, %d usable candidates", ap_num, (int)s_scan_count);
+}
+
+bool wifi_conn_select_cache_fresh(void) {
+    return s_scan_time_us != 0 && esp_timer_get_time() - s_scan_time_us < (int64_t)WIFI_CONN_SCAN_CACHE_MS * 1000;
+}
+
+esp_err_t wifi_conn_select_best(wifi_conn_bss_t *out) {
+    const scan_entry_t *best = NULL;
+    int best_score = 0;
+    for (size_t i = 0; i < s_scan_count; i++) {
+        const scan_entry_t *entry = &s_scan[i];
+        int score = entry->bss.rssi + WIFI_CONN_PRIORITY_DB * s_candidates[entry->bss.ap_index].priority -
+                    WIFI_CONN_FAILURE_PENALTY_DB * entry->failures;
+        if (!best || score > best_score) {
+            best = entry;
+            best_score = score;
+        }
+    }
+    if (!best) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *out = best->bss;
+    return ESP_OK;
+}
+
+void wifi_conn_select_on_failure(const uint8_t *bssid) {
+    for (size_t i = 0; i < s_scan_count; i++) {
+        if (memcmp(s_scan[i].bss.bssid, bssid, sizeof(s_scan[i].bss.bssid)) == 0 && s_scan[i].failures < UINT8_MAX) {
+            s_scan[i].failures++;
+        }
+    }
+}
+
+void wifi_conn_select_invalidate(void) {
+    s_scan_count = 0;
+    s_scan_time_us = 0;
+}
\ No newline at end of file
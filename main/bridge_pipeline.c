@@ -0,0 +1,307 @@
+// main/bridge_pipeline.c
+// Uplink pipeline: UART chunks are parsed and published by separate tasks,
+// connected by single-producer/single-consumer rings, so the UART RX task
+// only copies each chunk and goes back to reading.
+//
+//   uart_rx_task --[ts | chunk]--> parse task --[ts | topic\0 | payload]--> publish task
+//
+// `ts` is the esp_timer time the chunk left the UART driver, for the
+// end-to-end latency counters.
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#include "dlog.h"
+#include "spsc_ring.h"
+#include "uart_comm.h"
+#include "mqtt_comm.h"
+#include "metrics.h"
+#include "bridge_pipeline.h" // Include own header
+
+static const char *TAG = "BRIDGE";
+
+#define TOPIC_MAX_LEN 128
+
+static bridge_pipeline_config_t s_config;
+static bool s_initialized = false;
+static spsc_ring_t s_parse_ring;   // uart_rx_task -> parse task
+static spsc_ring_t s_publish_ring; // parse task -> publish task
+static bridge_pipeline_stats_t s_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Exported counters of one stage; NULL where a count is not exported
+typedef struct {
+    metric_t *items;
+    metric_t *dropped;
+    metric_t *busy_ms;
+} stage_metrics_t;
+
+static const uint32_t s_latency_us_bounds[] = { 500, 1000, 2000, 5000, 10000, 50000, 200000 };
+static stage_metrics_t s_m_rx;
+static stage_metrics_t s_m_parse;
+static stage_metrics_t s_m_publish;
+static metric_t *s_m_latency_us;
+static metric_t *s_m_latency_max_us;
+
+static void uart_reply(const char *msg) {
+    uart_comm_transmit((const uint8_t *)msg, strlen(msg));
+}
+
+static void count_stage(bridge_stage_stats_t *stage, const stage_metrics_t *m, int64_t start_us, bool dropped) {
+    int64_t busy_us = esp_timer_get_time() - start_us;
+    taskENTER_CRITICAL(&s_stats_lock);
+    uint64_t busy_ms_before = stage->busy_us / 1000;
+    stage->items++;
+    stage->busy_us += (uint64_t)busy_us;
+    if (dropped) {
+        stage->dropped++;
+    }
+    // Whole ms crossed, so the sub-ms busy time of short items is not lost
+    uint32_t busy_ms = (uint32_t)(stage->busy_us / 1000 - busy_ms_before);
+    taskEXIT_CRITICAL(&s_stats_lock);
+
+    metrics_inc(m->items);
+    if (dropped) {
+        metrics_inc(m->dropped);
+    }
+    if (busy_ms) {
+        metrics_add(m->busy_ms, busy_ms);
+    }
+}
+
+// Publish stage: hands the message to mqtt_comm and acknowledges it on the UART
+static void publish_message(const char *topic, const char *payload, size_t payload_len, int64_t rx_us) {
+    int64_t start_us = esp_timer_get_time();
+    ESP_LOGD(TAG, "Parsed UART JSON - Topic: '%s', Payload: '%.*s'", topic, (int)payload_len, payload);
+
+    esp_err_t pub_ret = mqtt_comm_publish(topic, payload, (int)payload_len, 1, 0);
+    if (pub_ret == ESP_OK) {
+        DLOGI(TAG, "Message queued for MQTT publish (%d bytes).", (int)payload_len); // No formatting here
+        uart_reply("OK: Sent to MQTT Queue\r\n");
+    } else {
+        ESP_LOGE(TAG, "Failed to queue message for MQTT publish (Error: %s)", esp_err_to_name(pub_ret));
+        uart_reply("Error: Failed to send to MQTT\r\n");
+    }
+
+    int64_t now = esp_timer_get_time();
+    uint32_t latency_us = (uint32_t)(now - rx_us);
+    count_stage(&s_stats.publish, &s_m_publish, start_us, false);
+    bool new_max = false;
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.latency_sum_us += latency_us;
+    if (latency_us > s_stats.latency_max_us) {
+        s_stats.latency_max_us = latency_us;
+        new_max = true;
+    }
+    taskEXIT_CRITICAL(&s_stats_lock);
+
+    metrics_observe(s_m_latency_us, latency_us);
+    if (new_max) {
+        metrics_set(s_m_latency_max_us, (int32_t)latency_us);
+    }
+}
+
+// Parse stage: `json` is NUL-terminated and may be modified
+static void parse_message(char *json, int64_t rx_us) {
+    int64_t start_us = esp_timer_get_time();
+    bool dropped = false;
+
+    cJSON *root = cJSON_Parse(json);
+    if (root == NULL) {
+        ESP_LOGE(TAG, "Failed to parse JSON: %s", cJSON_GetErrorPtr());
+        uart_reply("Error: Invalid JSON\r\n");
+        count_stage(&s_stats.parse, &s_m_parse, start_us, false);
+        return;
+    }
+
+    cJSON *topic_item = cJSON_GetObjectItem(root, "topic");
+    cJSON *payload_item = cJSON_GetObjectItem(root, "payload");
+    if (!cJSON_IsString(topic_item) || !topic_item->valuestring ||
+        !cJSON_IsString(payload_item) || !payload_item->valuestring) {
+        ESP_LOGE(TAG, "JSON format error: 'topic' or 'payload' missing/invalid.");
+        uart_reply("Error: Missing/Invalid 'topic' or 'payload'\r\n");
+    } else {
+        // Construct the full topic including the base
+        char full_topic[TOPIC_MAX_LEN];
+        int topic_len = snprintf(full_topic, sizeof(full_topic), "%s%s", s_config.pub_base_topic, topic_item->valuestring);
+        if (topic_len >= (int)sizeof(full_topic)) {
+            topic_len = sizeof(full_topic) - 1; // Truncated, as before
+        }
+        const char *payload = payload_item->valuestring;
+        size_t payload_len = strlen(payload);
+
+        if (s_config.synchronous) {
+            count_stage(&s_stats.parse, &s_m_parse, start_us, false);
+            publish_message(full_topic, payload, payload_len, rx_us);
+            cJSON_Delete(root);
+            return;
+        }
+        spsc_ring_part_t parts[] = {
+            { .data = &rx_us, .len = sizeof(rx_us) },
+            { .data = full_topic, .len = (size_t)topic_len + 1 }, // With its NUL as separator
+            { .data = payload, .len = payload_len },
+        };
+        if (!spsc_ring_push_parts(&s_publish_ring, parts, sizeof(parts) / sizeof(parts[0]))) {
+            ESP_LOGW(TAG, "Publish stage behind, dropping message for '%s'", full_topic);
+            uart_reply("Error: Bridge busy\r\n");
+            dropped = true;
+        }
+    }
+    cJSON_Delete(root);
+    count_stage(&s_stats.parse, &s_m_parse, start_us, dropped);
+}
+
+static void parse_task(void *pvParameters) {
+    size_t buf_size = sizeof(int64_t) + s_config.max_chunk + 1;
+    uint8_t *buf = malloc(buf_size);
+    if (!buf) {
+        ESP_LOGE(TAG, "No memory for the parse stage");
+        vTaskDelete(NULL);
+        return;
+    }
+    while (1) {
+        size_t len = 0;
+        if (spsc_ring_pop_wait(&s_parse_ring, buf, buf_size - 1, &len, portMAX_DELAY) != ESP_OK) {
+            continue;
+        }
+        int64_t rx_us;
+        memcpy(&rx_us, buf, sizeof(rx_us));
+        buf[len] = '\0';
+        parse_message((char *)buf + sizeof(rx_us), rx_us);
+    }
+}
+
+static void publish_task(void *pvParameters) {
+    size_t buf_size = sizeof(int64_t) + TOPIC_MAX_LEN + s_config.max_chunk;
+    uint8_t *buf = malloc(buf_size);
+    if (!buf) {
+        ESP_LOGE(TAG, "No memory for the publish stage");
+        vTaskDelete(NULL);
+        return;
+    }
+    while (1) {
+        size_t len = 0;
+        if (spsc_ring_pop_wait(&s_publish_ring, buf, buf_size, &len, portMAX_DELAY) != ESP_OK) {
+            continue;
+        }
+        int64_t rx_us;
+        memcpy(&rx_us, buf, sizeof(rx_us));
+        const char *topic = (const char *)buf + sizeof(rx_us);
+        size_t topic_size = strnlen(topic, len - sizeof(rx_us)) + 1;
+        publish_message(topic, topic + topic_size, len - sizeof(rx_us) - topic_size, rx_us);
+    }
+}
+
+void bridge_pipeline_on_uart_rx(const uint8_t *data, size_t len) {
+    if (!s_initialized) {
+        return;
+    }
+    int64_t rx_us = esp_timer_get_time();
+    bool dropped = false;
+
+    if (s_config.synchronous) {
+        // Add null terminator for string parsing
+        char *json_string = malloc(len + 1);
+        if (!json_string) {
+            ESP_LOGE(TAG, "Failed to allocate buffer for JSON string");
+            return;
+        }
+        memcpy(json_string, data, len);
+        json_string[len] = '\0';
+        parse_message(json_string, rx_us);
+        free(json_string);
+    } else {
+        spsc_ring_part_t parts[] = {
+            { .data = &rx_us, .len = sizeof(rx_us) },
+            { .data = data, .len = len },
+        };
+        if (len > s_config.max_chunk || !spsc_ring_push_parts(&s_parse_ring, parts, 2)) {
+            ESP_LOGW(TAG, "Parse stage behind, dropping %d bytes from UART", (int)len);
+            dropped = true;
+        }
+    }
+    count_stage(&s_stats.rx, &s_m_rx, rx_us, dropped);
+}
+
+static esp_err_t start_stage(TaskFunction_t fn, const char *name, const bridge_stage_config_t *stage,
+                             spsc_ring_t *input) {
+    TaskHandle_t handle = NULL;
+    if (xTaskCreatePinnedToCore(fn, name, 4096, NULL, stage->priority, &handle, stage->core) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create %s task", name);
+        return ESP_FAIL;
+    }
+    spsc_ring_set_consumer(input, handle);
+    return ESP_OK;
+}
+
+esp_err_t bridge_pipeline_init(const bridge_pipeline_config_t *config) {
+    if (s_initialized) {
+        ESP_LOGW(TAG, "Bridge pipeline already initialized.");
+        return ESP_OK;
+    }
+    if (!config || !config->pub_base_topic || config->max_chunk == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_config = *config;
+    memset(&s_stats, 0, sizeof(s_stats));
+
+    // Busy time in ms (us would wrap within the hour); compare APP_PIPELINE_SYNCHRONOUS true / false
+    s_m_rx.dropped = metrics_counter("uplink.rx_dropped");
+    s_m_rx.busy_ms = metrics_counter("uplink.rx_busy_ms");
+    s_m_parse.items = metrics_counter("uplink.parsed");
+    s_m_parse.dropped = metrics_counter("uplink.parse_dropped");
+    s_m_parse.busy_ms = metrics_counter("uplink.parse_busy_ms");
+    s_m_publish.items = metrics_counter("uplink.published");
+    s_m_publish.busy_ms = metrics_counter("uplink.publish_busy_ms");
+    s_m_latency_us = metrics_histogram("uplink.latency_us", s_latency_us_bounds,
+                                       sizeof(s_latency_us_bounds) / sizeof(s_latency_us_bounds[0]));
+    s_m_latency_max_us = metrics_gauge("uplink.latency_max_us");
+
+    if (!config->synchronous) {
+        esp_err_t ret = spsc_ring_init(&s_parse_ring, config->ring_size);
+        if (ret == ESP_OK) {
+            ret = spsc_ring_init(&s_publish_ring, config->ring_size);
+            if (ret != ESP_OK) {
+                spsc_ring_deinit(&s_parse_ring);
+            }
+        }
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create pipeline rings: %s", esp_err_to_name(ret));
+            return ret;
+        }
+        // The consumer is set before anything can be pushed: the UART is not read until s_initialized
+        if (start_stage(parse_task, "bridge_parse", &config->parse, &s_parse_ring) != ESP_OK ||
+            start_stage(publish_task, "bridge_publish", &config->publish, &s_publish_ring) != ESP_OK) {
+            // A stage task that did start only waits on its ring; leave both rings allocated for it
+            return ESP_FAIL;
+        }
+    }
+
+    s_initialized = true;
+    if (config->synchronous) {
+        ESP_LOGI(TAG, "Uplink synchronous: parse and publish in the UART RX task");
+    } else {
+        ESP_LOGI(TAG, "Uplink pipelined: rings of %d bytes, parse prio %d core %d, publish prio %d core %d",
+                 (int)s_parse_ring.size, (int)config->parse.priority, (int)config->parse.core,
+                 (int)config->publish.priority, (int)config->publish.core);
+    }
+    return ESP_OK;
+}
+
+esp_err_t bridge_pipeline_get_stats(bridge_pipeline_stats_t *out) {
+    if (!out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    taskENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    taskEXIT_CRITICAL(&s_stats_lock);
+    if (s_initialized && !s_config.synchronous) {
+        out->parse_ring_peak = s_parse_ring.peak;
+        out->publish_ring_peak = s_publish_ring.peak;
+    }
+    return ESP_OK;
+}
\ No newline at end of file
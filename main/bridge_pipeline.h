@@ -0,0 +1,76 @@
+// main/bridge_pipeline.h
+#ifndef BRIDGE_PIPELINE_H
+#define BRIDGE_PIPELINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h" // For UBaseType_t / BaseType_t
+
+/**
+ * @brief Task placement of one pipeline stage.
+ */
+typedef struct {
+    UBaseType_t priority;      /*!< Task priority */
+    BaseType_t core;           /*!< Core the task is pinned to (tskNO_AFFINITY for either) */
+} bridge_stage_config_t;
+
+/**
+ * @brief Uplink pipeline configuration (UART -> MQTT).
+ */
+typedef struct {
+    const char *pub_base_topic;    /*!< Prepended to the topic of every message (copied pointer, must stay valid) */
+    size_t max_chunk;              /*!< Largest UART chunk handed to bridge_pipeline_on_uart_rx() */
+    size_t ring_size;              /*!< Bytes per ring between two stages */
+    bool synchronous;              /*!< Parse and publish in the caller of bridge_pipeline_on_uart_rx(),
+                                        without rings or stage tasks (the former design, for comparison) */
+    bridge_stage_config_t parse;   /*!< JSON parse stage */
+    bridge_stage_config_t publish; /*!< MQTT publish stage */
+} bridge_pipeline_config_t;
+
+/**
+ * @brief Counters of one stage.
+ */
+typedef struct {
+    uint32_t items;            /*!< Items handled */
+    uint32_t dropped;          /*!< Items lost because the ring to the next stage was full */
+    uint64_t busy_us;          /*!< Time spent handling them */
+} bridge_stage_stats_t;
+
+/**
+ * @brief Pipeline counters, for comparing the pipelined and synchronous designs.
+ */
+typedef struct {
+    bridge_stage_stats_t rx;       /*!< In the UART RX task: the time it is kept from reading */
+    bridge_stage_stats_t parse;
+    bridge_stage_stats_t publish;
+    uint64_t latency_sum_us;       /*!< UART chunk received to publish queued, summed over publish.items */
+    uint32_t latency_max_us;
+    size_t parse_ring_peak;        /*!< Highest fill of the RX -> parse ring in bytes */
+    size_t publish_ring_peak;      /*!< Highest fill of the parse -> publish ring in bytes */
+} bridge_pipeline_stats_t;
+
+/**
+ * @brief Creates the rings and the stage tasks (none with config->synchronous).
+ *
+ * Stages: UART RX (the uart_comm RX task) -> ring -> parse (JSON) -> ring -> publish (MQTT).
+ * Each ring has one producer and one consumer, so no stage ever waits on a lock
+ * held by another; a stage whose next ring is full drops the item and counts it.
+ *
+ * @param config Pipeline configuration.
+ * @return esp_err_t ESP_OK on success, or an error code.
+ */
+esp_err_t bridge_pipeline_init(const bridge_pipeline_config_t *config);
+
+/**
+ * @brief Hands one UART chunk (one JSON message) to the pipeline. Call from the UART RX task only.
+ */
+void bridge_pipeline_on_uart_rx(const uint8_t *data, size_t len);
+
+/**
+ * @brief Reads the pipeline counters.
+ */
+esp_err_t bridge_pipeline_get_stats(bridge_pipeline_stats_t *out);
+
+#endif // BRIDGE_PIPELINE_H
\ No newline at end of file
@@ -5,29 +5,75 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 
-// Queue handle for LED commands (still needed by main app logic)
+// Queue handle for LED commands (connection state changes only; activity
+// is signalled with led_signal_activity())
 extern QueueHandle_t led_command_queue;
 
-// LED Commands Enum (Unchanged)
+// LED Commands Enum
 typedef enum {
     LED_CMD_OFF,
     LED_CMD_WIFI_CONNECTING,
     LED_CMD_WIFI_CONNECTED, // WiFi Connected, MQTT might be connecting/disconnected
     LED_CMD_MQTT_CONNECTED, // WiFi and MQTT are connected
-    LED_CMD_UART_RX_RECEIVED,
-    LED_CMD_MQTT_RX_RECEIVED,
     LED_CMD_ERROR // Optional: Generic error state
 } led_command_t;
 
+// Activity bits for led_signal_activity()
+typedef enum {
+    LED_ACTIVITY_UART_RX = 1 << 0,
+    LED_ACTIVITY_MQTT_RX = 1 << 1,
+} led_activity_t;
+
 // --- Configuration (Hardcoded - Replace with your details!) ---
 // WiFi
 #define APP_WIFI_SSID "Nearloc.Private.Main" // <<< CHANGE THIS
 #define APP_WIFI_PASS "1928374650"           // <<< CHANGE THIS
+// Further networks to roam between, each as { ssid, password, priority, min_authmode }.
+// The strongest AP of any listed network is chosen; priority adds 10 dB per step.
+#define APP_WIFI_EXTRA_APS /* { "Nearloc.Private.Backup", "1928374650", -1, WIFI_AUTH_WPA2_PSK }, */
+#define APP_WIFI_ROAM_RSSI -75         // Look for a stronger AP below this signal (dBm, 0 = never roam)
+#define APP_WIFI_ROAM_HYSTERESIS_DB 8  // Only move to an AP at least this much stronger
+#define APP_WIFI_FAST_RECONNECT true   // Connect to the last good AP/channel from NVS, no scan
+#define APP_WIFI_REUSE_IP_LEASE false  // Also reuse the last DHCP lease (only if the DHCP server reserves our address)
+#define APP_WIFI_PS_PROFILE WIFI_CONN_PS_LOW_LATENCY // Radio always on: no DTIM delay on downlink commands
+#define APP_WIFI_LISTEN_INTERVAL 3     // WIFI_CONN_PS_LOW_POWER only: beacons between wake-ups
+#define APP_LATENCY_BENCH_PROBES 0     // >0: measure MQTT round trips under each power-save profile after boot
+#define APP_LATENCY_BENCH_BASE_TOPIC "bench/" // Loopback topic for the benchmark, MAC appended
+#define APP_METRICS_BASE_TOPIC "dev"   // Runtime metrics go to <base>/<mac>/stats, downlink NACKs to <base>/<mac>/nack
+#define APP_METRICS_INTERVAL_S 30      // Seconds between metrics snapshots (only changed values are sent)
+#define APP_METRICS_FULL_EVERY 10      // Every Nth snapshot carries all metrics
+#define APP_DLOG_SLOTS 128             // Deferred log records buffered for hot-path logging (see dlog.h)
+#define APP_DLOG_FLUSH_MS 200          // How often the deferred log is drained
+#define APP_DLOG_TO_MQTT false         // true: ship deferred log lines to <APP_METRICS_BASE_TOPIC>/<mac>/log instead of the console
 
 // MQTT
 #define APP_MQTT_BROKER_URI "mqtt://mqtt.eclipseprojects.io" // <<< CHANGE OR CONFIRM
 #define APP_MQTT_PUB_BASE_TOPIC "pub/data/"                  // Base for publishing from UART
 #define APP_MQTT_SUB_BASE_TOPIC "sub/data/"                  // Base for subscribing
+#define APP_MQTT_BATCH_WINDOW_MS 0      // Coalesce QoS0 publishes per topic for up to N ms (0 = off; the QoS 1 UART uplink is never batched)
+#define APP_MQTT_BATCH_MAX_BYTES 1024   // ...or until the coalesced payload reaches M bytes
+// Note: the bridge used MQTT 3.1.1 before; MQTT 5 needs a broker that supports it
+// (e.g. Mosquitto >= 1.6). Use MQTT_COMM_PROTOCOL_V3_1_1 for older brokers.
+#define APP_MQTT_PROTOCOL MQTT_COMM_PROTOCOL_V5 // Or MQTT_COMM_PROTOCOL_V3_1_1
+#define APP_MQTT_TOPIC_ALIAS_MAX 8      // MQTT 5 topic aliases for hot topics (0 = off). QoS 0 only: the QoS 1 UART uplink keeps full topics
+#define APP_MQTT_MESSAGE_EXPIRY_S 300   // MQTT 5 message expiry, drops stale data after outages (0 = never)
+#define APP_MQTT_DEDUP true            // Do not publish a reading identical to the last one on its topic...
+#define APP_MQTT_DEDUP_MAX_QUIET_MS 60000 // ...unless the topic has been quiet this long (heartbeat)
+#define APP_MQTT_RATE_TOPIC 10         // Publishes per second per topic from the UART (0 = unlimited)...
+#define APP_MQTT_RATE_TOPIC_BURST 20   // ...with short bursts up to this many
+#define APP_MQTT_RATE_GLOBAL 50        // Publishes per second over all topics (0 = unlimited)
+#define APP_MQTT_RATE_POLICY MQTT_COMM_RATE_POLICY_COALESCE // Over the limit: keep the latest value per topic (QoS 0)...
+#define APP_MQTT_RATE_MAX_DELAY_MS 200 // ...while QoS 1 messages wait this long for a token before being dropped
+#define APP_MQTT_COMPRESS_MIN_LEN 0     // >0: LZSS-compress payloads from this size, published on "<topic>/lz" (subscribers must decode)
+#define APP_MQTT_RX_MODE MQTT_COMM_RX_MODE_STREAM // Large downlink messages go to the UART fragment by fragment
+#define APP_MQTT_PERSISTENT_SESSION true // Broker keeps subscriptions and queues QoS 1 downlink while we are offline
+#define APP_MQTT_SESSION_EXPIRY_S (24 * 60 * 60) // MQTT 5: how long the broker keeps the session
+#define APP_MQTT_RECONNECT_BASE_MS 1000 // Reconnect backoff: first window, doubled per failure, random delay within it
+#define APP_MQTT_RECONNECT_MAX_MS 60000 // Reconnect backoff: largest window
+#define APP_MQTT_RECEIVE_MAXIMUM 4      // MQTT 5: QoS 1 messages in flight towards us, keeps a fast broker in step with the UART
+#define APP_MQTT_BROKER_DISCOVERY false // Opt-in: resolve the URI host via mDNS (_mqtt._tcp) when DNS cannot
+#define APP_MQTT_BROKER_CACHE_TTL_S 3600 // Resolve the broker in the background, reconnect to the cached IP
+#define APP_MQTT_CA_CERT_PEM NULL       // For mqtts://: pinned broker CA in PEM (NULL = plain mqtt:// or certificate bundle)
 // #define APP_MQTT_CLIENT_ID NULL // Let component generate default
 // #define APP_MQTT_USERNAME NULL
 // #define APP_MQTT_PASSWORD NULL
@@ -38,12 +84,32 @@ typedef enum {
 #define APP_UART_RX_PIN (16)
 #define APP_UART_BAUD_RATE 115200
 #define APP_UART_RX_BUF_SIZE (1024) // Ring buffer size for driver
-#define APP_UART_TX_BUF_SIZE (0)    // No TX ring buffer
+#define APP_UART_TX_BUF_SIZE (2048) // Driver TX ring, filled without blocking the writer
+#define APP_UART_TX_DEFER_SIZE (4096) // Deferred TX queue used while the TX ring is full
+#define APP_DOWNLINK_MAX_LATENCY_MS (1000) // Queue at most what the UART can send in this time (TX ring and deferred bytes included)
+#define APP_DOWNLINK_POLICY DOWNLINK_POLICY_DROP_QOS0 // What to drop when the queue is over budget...
+#define APP_DOWNLINK_QOS1_WAIT_MS (2000) // ...after QoS 1 messages waited this long (holding back their PUBACK); then they are NACKed
 #define APP_UART_QUEUE_SIZE (0)     // Default event queue
 
+// --- Task Placement (dual-core ESP32) ---
+// UART and the uplink stages run on APP_CPU; WiFi and lwIP are pinned to
+// PRO_CPU in sdkconfig, and the publish stage joins them there.
+#define APP_PIPELINE_SYNCHRONOUS false  // true: parse + publish inside the UART RX task, to compare throughput
+#define APP_PIPELINE_RING_SIZE (4096)   // Bytes per ring between two uplink stages
+#define APP_UART_TASK_PRIO 10           // UART RX / deferred TX tasks
+#define APP_UART_TASK_CORE 1
+#define APP_PARSE_TASK_PRIO 8           // JSON parse stage
+#define APP_PARSE_TASK_CORE 1
+#define APP_PUBLISH_TASK_PRIO 7         // MQTT publish stage
+#define APP_PUBLISH_TASK_CORE 0
+#define APP_DOWNLINK_TASK_PRIO 9        // MQTT -> UART writer
+#define APP_DOWNLINK_TASK_CORE 1
+#define APP_DLOG_TASK_PRIO 2            // Deferred log formatting, below all bridge tasks
+#define APP_DLOG_TASK_CORE 0
+
 // LED
 #define APP_LED_GPIO (GPIO_NUM_2) // Common built-in LED GPIO
-#define APP_LED_TASK_STACK (2048) // Stack for LED handler task in main
+#define APP_LED_FRAME_MS (25) // LED engine tick; pattern timings are multiples of this
 // --- End Configuration ---
 
 #endif // COMMON_DEFS_H
\ No newline at end of file
@@ -0,0 +1,413 @@
+// main/downlink_sched.c
+// Downlink scheduler: decouples the MQTT task from the (much slower) UART.
+//
+// Received messages are copied into a FIFO whose byte budget is what the UART
+// can send within max_latency_ms. Bytes already waiting in uart_comm (TX ring
+// and deferred queue) count against the same budget. A writer task drains the
+// FIFO into uart_comm. When a new message does not fit, a QoS 1 message first
+// waits a bounded time in the MQTT task: esp-mqtt sends its PUBACK only once the
+// handler returns, so with a small MQTT 5 receive maximum this throttles the
+// broker. After that (and right away for QoS 0) the configured policy decides
+// what is dropped, and a QoS 1 message that still does not fit is reported on
+// the NACK topic so the sender can retry.
+//
+// Messages larger than the client's input buffer arrive as stream fragments
+// (MQTT_COMM_RX_MODE_STREAM). Each fragment is queued as it comes, so no
+// message ever has to fit in memory or in the budget as a whole.
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "uart_comm.h"
+#include "metrics.h"
+#include "downlink_sched.h" // Include own header
+
+static const char *TAG = "DOWNLINK";
+
+#define DL_FLAG_FIRST 0x01 // Writer sends the prefix before this item
+#define DL_FLAG_LAST  0x02 // Writer sends the suffix after this item
+#define DL_FLAG_WHOLE (DL_FLAG_FIRST | DL_FLAG_LAST)
+
+#define NACK_SLOTS 4 // Rejected QoS 1 messages waiting to be reported
+
+typedef struct dl_item {
+    struct dl_item *next;
+    uint32_t topic_hash;
+    int qos;
+    uint8_t flags;       // DL_FLAG_*; only whole messages can be dropped or replaced
+    size_t topic_len;
+    size_t data_len;
+    char buf[];          // Topic followed by payload
+} dl_item_t;
+
+typedef struct {
+    char topic[MQTT_COMM_TOPIC_MAX_LEN];
+    size_t total_len;
+} nack_t;
+
+static downlink_sched_config_t s_config;
+static SemaphoreHandle_t s_queue_mutex = NULL; // Protects the queue, the NACKs and s_stats
+static TaskHandle_t s_writer_task_handle = NULL;
+static dl_item_t *s_head = NULL;
+static dl_item_t *s_tail = NULL;
+static downlink_sched_stats_t s_stats;
+
+// Fragmented message being streamed. Fragments arrive back to back from the MQTT task.
+static bool s_stream_open = false;     // First fragment queued, last one not yet
+static bool s_stream_skipping = false; // Rest of the current message is dropped
+
+static nack_t s_nacks[NACK_SLOTS];
+static size_t s_nack_count = 0;
+
+static metric_t *s_m_sent;
+static metric_t *s_m_dropped;        // Oldest and QoS 0, as counted by the policy
+static metric_t *s_m_replaced;
+static metric_t *s_m_nacked;
+static metric_t *s_m_stream_aborted;
+static metric_t *s_m_qos1_delayed;
+
+// Unlinks `item` (whose predecessor is `prev`, NULL for the head). Mutex held.
+static void unlink_item(dl_item_t *prev, dl_item_t *item) {
+    if (prev) {
+        prev->next = item->next;
+    } else {
+        s_head = item->next;
+    }
+    if (s_tail == item) {
+        s_tail = prev;
+    }
+    s_stats.queued_msgs--;
+    s_stats.queued_bytes -= item->data_len;
+}
+
+// Drops the oldest whole message, or the oldest whole QoS 0 one. Fragments of
+// a streamed message are never dropped: the UART would get half a message. Mutex held.
+static bool drop_one(bool qos0_only) {
+    dl_item_t *prev = NULL;
+    dl_item_t *item = s_head;
+    while (item && (item->flags != DL_FLAG_WHOLE || (qos0_only && item->qos > 0))) {
+        prev = item;
+        item = item->next;
+    }
+    if (!item) {
+        return false;
+    }
+    unlink_item(prev, item);
+    if (qos0_only) {
+        s_stats.dropped_qos0++;
+    } else {
+        s_stats.dropped_oldest++;
+    }
+    metrics_inc(s_m_dropped);
+    free(item);
+    return true;
+}
+
+// Removes a queued whole message with the same topic, if any. Mutex held.
+static void replace_same_topic(const mqtt_comm_message_t *msg, uint32_t hash) {
+    dl_item_t *prev = NULL;
+    for (dl_item_t *item = s_head; item; prev = item, item = item->next) {
+        if (item->flags == DL_FLAG_WHOLE && item->topic_hash == hash && item->topic_len == msg->topic_len &&
+            memcmp(item->buf, msg->topic, item->topic_len) == 0) {
+            unlink_item(prev, item);
+            s_stats.replaced++;
+            metrics_inc(s_m_replaced);
+            free(item);
+            return;
+        }
+    }
+}
+
+// Bytes the UART still has to send, queued here or already in uart_comm. Mutex held.
+static size_t backlog_bytes(void) {
+    return s_stats.queued_bytes + uart_comm_tx_pending();
+}
+
+// Applies the policy until `len` more bytes fit in the budget. Mutex held.
+// Returns false if the new message has to go instead.
+static bool make_room(size_t len) {
+    while (backlog_bytes() + len > s_stats.budget_bytes) {
+        if (s_stats.queued_msgs == 0) {
+            return true; // Nothing left to give up: larger than the budget on its own, it goes out next
+        }
+        if (!drop_one(s_config.policy == DOWNLINK_POLICY_DROP_QOS0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Holds a QoS 1 message (and so its PUBACK) until `len` more bytes fit, for at
+// most qos1_wait_ms. Mutex held; released while sleeping. Returns true if it waited.
+static bool wait_for_room(size_t len) {
+    TickType_t limit = pdMS_TO_TICKS(s_config.qos1_wait_ms);
+    TickType_t start = xTaskGetTickCount();
+    bool delayed = false;
+    while (backlog_bytes() > 0 && backlog_bytes() + len > s_stats.budget_bytes) {
+        TickType_t waited = xTaskGetTickCount() - start;
+        if (waited >= limit) {
+            break;
+        }
+        // About as long as the UART needs to send the excess
+        size_t excess = backlog_bytes() + len - s_stats.budget_bytes;
+        TickType_t delay = pdMS_TO_TICKS((uint32_t)(excess * 10 * 1000 / (size_t)s_config.baud_rate));
+        delay = delay < 1 ? 1 : (delay > limit - waited ? limit - waited : delay);
+        delayed = true;
+        xSemaphoreGive(s_queue_mutex);
+        vTaskDelay(delay);
+        xSemaphoreTake(s_queue_mutex, portMAX_DELAY);
+    }
+    return delayed;
+}
+
+// Remembers a rejected QoS 1 message for the writer task to report. Mutex held.
+static void queue_nack(const mqtt_comm_message_t *msg) {
+    s_stats.nacked++;
+    metrics_inc(s_m_nacked);
+    if (!s_config.nack_topic || s_nack_count >= NACK_SLOTS || msg->topic_len >= MQTT_COMM_TOPIC_MAX_LEN) {
+        return; // Still counted; the sender sees no NACK and has to rely on its own timeout
+    }
+    nack_t *nack = &s_nacks[s_nack_count++];
+    memcpy(nack->topic, msg->topic, msg->topic_len);
+    nack->topic[msg->topic_len] = '\0';
+    nack->total_len = msg->total_len;
+}
+
+static dl_item_t *new_item(const mqtt_comm_message_t *msg, uint32_t hash, uint8_t flags) {
+    dl_item_t *item = malloc(sizeof(dl_item_t) + msg->topic_len + msg->data_len);
+    if (!item) {
+        return NULL;
+    }
+    item->next = NULL;
+    item->qos = msg->qos;
+    item->flags = flags;
+    item->topic_len = msg->topic_len;
+    item->data_len = msg->data_len;
+    item->topic_hash = hash;
+    memcpy(item->buf, msg->topic, msg->topic_len);
+    memcpy(item->buf + msg->topic_len, msg->data, msg->data_len);
+    return item;
+}
+
+// Appends `item` to the FIFO. Mutex held.
+static void append_item(dl_item_t *item) {
+    if (s_tail) {
+        s_tail->next = item;
+    } else {
+        s_head = item;
+    }
+    s_tail = item;
+    s_stats.queued_msgs++;
+    s_stats.queued_bytes += item->data_len;
+    if (s_stats.queued_bytes > s_stats.peak_bytes) {
+        s_stats.peak_bytes = s_stats.queued_bytes;
+    }
+}
+
+esp_err_t downlink_sched_submit(const mqtt_comm_message_t *msg) {
+    if (!s_queue_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!msg) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    bool first = (msg->offset == 0);
+    bool last = (msg->offset + msg->data_len >= msg->total_len);
+    uint8_t flags = (first ? DL_FLAG_FIRST : 0) | (last ? DL_FLAG_LAST : 0);
+    uint32_t hash = mqtt_comm_hash32(msg->topic, msg->topic_len);
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(s_queue_mutex, portMAX_DELAY);
+    if (first) {
+        s_stream_open = false;
+        s_stream_skipping = false;
+    } else if (s_stream_skipping || !s_stream_open) {
+        s_stream_skipping = !last;
+        xSemaphoreGive(s_queue_mutex);
+        return ESP_ERR_NO_MEM; // Start of this message was already dropped
+    }
+
+    if (flags == DL_FLAG_WHOLE && s_config.policy == DOWNLINK_POLICY_LATEST_PER_TOPIC) {
+        replace_same_topic(msg, hash);
+    }
+    if (msg->qos > 0 && wait_for_room(msg->data_len)) {
+        s_stats.qos1_delayed++;
+        metrics_inc(s_m_qos1_delayed);
+    }
+    dl_item_t *item = NULL;
+    if (make_room(msg->data_len)) {
+        item = new_item(msg, hash, flags);
+        if (!item) {
+            ESP_LOGE(TAG, "No memory for downlink message (%d bytes)", (int)msg->data_len);
+        }
+    }
+
+    if (item) {
+        append_item(item);
+        s_stream_open = !last;
+        if (!first) {
+            s_stats.fragments++;
+        }
+    } else if (first) {
+        // Nothing of this message was queued: drop it whole
+        if (msg->qos > 0) {
+            queue_nack(msg);
+        } else {
+            s_stats.dropped_qos0++;
+            metrics_inc(s_m_dropped);
+        }
+        s_stream_skipping = !last;
+        ret = ESP_ERR_NO_MEM;
+    } else {
+        // Part of the message is already queued. Close its line with a payload-less
+        // item so the next message starts clean; the receiver sees a short line.
+        dl_item_t *end = new_item(&(mqtt_comm_message_t){ .topic = msg->topic, .topic_len = msg->topic_len,
+                                                         .qos = msg->qos }, hash, DL_FLAG_LAST);
+        if (end) {
+            append_item(end);
+        }
+        s_stats.stream_aborted++;
+        metrics_inc(s_m_stream_aborted);
+        if (msg->qos > 0) {
+            queue_nack(msg);
+        }
+        s_stream_open = false;
+        s_stream_skipping = !last;
+        ret = ESP_ERR_NO_MEM;
+    }
+    xSemaphoreGive(s_queue_mutex);
+
+    xTaskNotifyGive(s_writer_task_handle);
+    return ret;
+}
+
+// Reports rejected QoS 1 messages. Runs in the writer task, never in the MQTT task.
+static void send_nacks(void) {
+    while (1) {
+        nack_t nack;
+        xSemaphoreTake(s_queue_mutex, portMAX_DELAY);
+        if (s_nack_count == 0) {
+            xSemaphoreGive(s_queue_mutex);
+            return;
+        }
+        nack = s_nacks[0];
+        memmove(&s_nacks[0], &s_nacks[1], (s_nack_count - 1) * sizeof(s_nacks[0]));
+        s_nack_count--;
+        xSemaphoreGive(s_queue_mutex);
+
+        char payload[MQTT_COMM_TOPIC_MAX_LEN + 48];
+        int len = snprintf(payload, sizeof(payload), "{\"topic\":\"%s\",\"len\":%u}", nack.topic, (unsigned)nack.total_len);
+        esp_err_t ret = mqtt_comm_publish_ex(s_config.nack_topic, payload, len, 0, 0,
+                                             MQTT_COMM_PUB_FLAG_NO_RATE_LIMIT | MQTT_COMM_PUB_FLAG_NO_DEDUP |
+                                             MQTT_COMM_PUB_FLAG_NO_BATCH | MQTT_COMM_PUB_FLAG_NO_COMPRESS);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Could not report dropped message on '%s' (Error: %s)", nack.topic, esp_err_to_name(ret));
+        }
+    }
+}
+
+// Metrics readers: must not block, so the word-sized levels are read without the mutex
+static int32_t read_queued_bytes(void *ctx) {
+    return (int32_t)s_stats.queued_bytes;
+}
+
+static int32_t read_peak_bytes(void *ctx) {
+    return (int32_t)s_stats.peak_bytes;
+}
+
+static void downlink_writer_task(void *pvParameters) {
+    ESP_LOGI(TAG, "Downlink writer task started.");
+    while (1) {
+        send_nacks();
+
+        xSemaphoreTake(s_queue_mutex, portMAX_DELAY);
+        dl_item_t *item = s_head;
+        if (item) {
+            unlink_item(NULL, item);
+        }
+        xSemaphoreGive(s_queue_mutex);
+
+        if (!item) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        uart_comm_tx_part_t parts[] = {
+            { .data = s_config.prefix, .len = (s_config.prefix && (item->flags & DL_FLAG_FIRST)) ? strlen(s_config.prefix) : 0 },
+            { .data = item->buf + item->topic_len, .len = item->data_len },
+            { .data = s_config.suffix, .len = (s_config.suffix && (item->flags & DL_FLAG_LAST)) ? strlen(s_config.suffix) : 0 },
+        };
+        // Blocking here is fine: this task only exists to wait for the UART
+        esp_err_t ret = uart_comm_transmit_parts(parts, sizeof(parts) / sizeof(parts[0]), UART_COMM_WAIT_FOREVER);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to send downlink message to UART (Error: %s)", esp_err_to_name(ret));
+        } else if (item->flags & DL_FLAG_LAST) {
+            xSemaphoreTake(s_queue_mutex, portMAX_DELAY);
+            s_stats.sent++;
+            xSemaphoreGive(s_queue_mutex);
+            metrics_inc(s_m_sent);
+        }
+        free(item);
+    }
+}
+
+esp_err_t downlink_sched_init(const downlink_sched_config_t *config) {
+    if (!config || config->baud_rate <= 0 || config->max_latency_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_queue_mutex) {
+        ESP_LOGW(TAG, "Downlink scheduler already initialized.");
+        return ESP_OK;
+    }
+
+    s_config = *config;
+    memset(&s_stats, 0, sizeof(s_stats));
+    // 8N1: 10 bits on the wire per byte
+    s_stats.budget_bytes = (size_t)config->baud_rate / 10 * config->max_latency_ms / 1000;
+
+    s_m_sent = metrics_counter("downlink.sent");
+    s_m_dropped = metrics_counter("downlink.dropped");
+    s_m_replaced = metrics_counter("downlink.replaced");
+    s_m_nacked = metrics_counter("downlink.nacked");
+    s_m_stream_aborted = metrics_counter("downlink.stream_aborted");
+    s_m_qos1_delayed = metrics_counter("downlink.qos1_delayed");
+    metrics_gauge_fn("downlink.queued_bytes", read_queued_bytes, NULL);
+    metrics_gauge_fn("downlink.peak_bytes", read_peak_bytes, NULL);
+
+    s_queue_mutex = xSemaphoreCreateMutex();
+    if (s_queue_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create downlink queue mutex");
+        return ESP_FAIL;
+    }
+    if (xTaskCreatePinnedToCore(downlink_writer_task, "downlink_tx", 3072, NULL,
+                                config->task_priority ? config->task_priority : 9,
+                                &s_writer_task_handle, config->task_core) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create downlink writer task");
+        vSemaphoreDelete(s_queue_mutex);
+        s_queue_mutex = NULL;
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Downlink budget %d bytes (%d baud, %d ms), policy %d",
+             (int)s_stats.budget_bytes, config->baud_rate, (int)config->max_latency_ms, config->policy);
+    return ESP_OK;
+}
+
+esp_err_t downlink_sched_get_stats(downlink_sched_stats_t *out) {
+    if (!out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_queue_mutex) {
+        memset(out, 0, sizeof(*out));
+        return ESP_OK;
+    }
+    xSemaphoreTake(s_queue_mutex, portMAX_DELAY);
+    *out = s_stats;
+    xSemaphoreGive(s_queue_mutex);
+    out->uart_pending_bytes = uart_comm_tx_pending();
+    return ESP_OK;
+}
\ No newline at end of file
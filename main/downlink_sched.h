@@ -0,0 +1,89 @@
+// main/downlink_sched.h
+#ifndef DOWNLINK_SCHED_H
+#define DOWNLINK_SCHED_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h" // For UBaseType_t / BaseType_t
+#include "mqtt_comm.h" // For mqtt_comm_message_t
+
+/**
+ * @brief What to give up when the downlink queue is over its byte budget.
+ */
+typedef enum {
+    DOWNLINK_POLICY_DROP_OLDEST,      /*!< Drop the oldest queued messages (never fragments of a streamed one) */
+    DOWNLINK_POLICY_DROP_QOS0,        /*!< Drop queued QoS 0 messages (oldest first), then new QoS 0 messages */
+    DOWNLINK_POLICY_LATEST_PER_TOPIC, /*!< Keep only the newest message per topic, then drop the oldest */
+} downlink_policy_t;
+
+/**
+ * @brief Downlink scheduler configuration.
+ */
+typedef struct {
+    int baud_rate;             /*!< UART baud rate; the UART drains baud_rate / 10 bytes per second */
+    uint32_t max_latency_ms;   /*!< Byte budget = what the UART sends in this time, including bytes already in uart_comm */
+    downlink_policy_t policy;  /*!< Applied when a new message does not fit in the budget */
+    uint32_t qos1_wait_ms;     /*!< A QoS 1 message (or fragment) waits this long for room before the policy applies.
+                                    Its PUBACK is held back meanwhile, throttling the broker (see receive_maximum). */
+    const char *nack_topic;    /*!< QoS 1 messages that still do not fit are reported here as {"topic":...,"len":...}
+                                    (NULL = count only) */
+    const char *prefix;        /*!< Written before every payload (may be NULL) */
+    const char *suffix;        /*!< Written after every payload (may be NULL) */
+    UBaseType_t task_priority; /*!< Writer task priority (0 for 9) */
+    BaseType_t task_core;      /*!< Core the writer task is pinned to (tskNO_AFFINITY for either) */
+} downlink_sched_config_t;
+
+/**
+ * @brief Downlink scheduler counters.
+ */
+typedef struct {
+    uint32_t queued_msgs;      /*!< Messages waiting for the UART */
+    size_t queued_bytes;       /*!< Payload bytes waiting for the UART */
+    size_t peak_bytes;         /*!< Highest queued_bytes seen */
+    size_t budget_bytes;       /*!< Byte budget derived from baud rate and max latency */
+    size_t uart_pending_bytes; /*!< Bytes in the UART TX ring and deferred queue (counted against the budget) */
+    uint32_t sent;             /*!< Messages written to the UART */
+    uint32_t fragments;        /*!< Stream fragments queued after the first one of their message */
+    uint32_t dropped_oldest;   /*!< Queued messages dropped to make room */
+    uint32_t dropped_qos0;     /*!< QoS 0 messages dropped (queued or new) */
+    uint32_t replaced;         /*!< Queued messages superseded by a newer one on the same topic */
+    uint32_t qos1_delayed;     /*!< QoS 1 messages or fragments that had to wait for room */
+    uint32_t nacked;           /*!< QoS 1 messages rejected for lack of room after qos1_wait_ms (and reported on nack_topic) */
+    uint32_t stream_aborted;   /*!< Streamed messages cut short because a later fragment did not fit */
+} downlink_sched_stats_t;
+
+/**
+ * @brief Creates the downlink queue and the task that writes it to the UART.
+ *
+ * @param config Scheduler configuration (prefix/suffix must stay valid).
+ * @return esp_err_t ESP_OK on success, or an error code.
+ */
+esp_err_t downlink_sched_init(const downlink_sched_config_t *config);
+
+/**
+ * @brief Queues a received message, or one stream fragment of it, for the UART.
+ *
+ * Called from the MQTT task. The data is copied. Fragments of a large message
+ * (MQTT_COMM_RX_MODE_STREAM) are queued one by one, so a message does not have
+ * to fit in the budget as a whole. When the budget is exceeded, a QoS 1 message
+ * blocks for up to qos1_wait_ms: esp-mqtt acknowledges it only once the handler
+ * returns, so the broker is slowed down. QoS 0 messages never wait. Then the
+ * policy applies; a QoS 1 message that still does not fit is dropped, and since
+ * esp-mqtt acknowledges it anyway it is reported on nack_topic.
+ *
+ * @param msg Complete message or stream fragment.
+ * @return esp_err_t ESP_OK if queued, ESP_ERR_NO_MEM if dropped,
+ *         ESP_ERR_INVALID_STATE if not initialized.
+ */
+esp_err_t downlink_sched_submit(const mqtt_comm_message_t *msg);
+
+/**
+ * @brief Reads the scheduler counters.
+ *
+ * @param out Destination for the counters.
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if out is NULL.
+ */
+esp_err_t downlink_sched_get_stats(downlink_sched_stats_t *out);
+
+#endif // DOWNLINK_SCHED_H
\ No newline at end of file
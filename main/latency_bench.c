@@ -0,0 +1,112 @@
+// main/latency_bench.c
+// Round-trip time through the bridge under each WiFi power-save profile.
+//
+// A probe carries a sequence number; it is published (QoS 0, all optional
+// publish stages bypassed) to a topic this device is subscribed to, and timed
+// until the broker delivers it back. Uplink, broker and downlink are all
+// included, so the DTIM wake-up delay of modem sleep shows up directly.
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "wifi_conn.h"
+#include "latency_bench.h" // Include own header
+
+static const char *TAG = "LATENCY_BENCH";
+
+#define PROBE_TIMEOUT_MS 2000
+#define PROBE_INTERVAL_MS 500   // Between probes, so the radio returns to its sleep pattern
+#define SETTLE_MS 3000          // After switching profile
+
+static char s_topic[64];
+static uint32_t s_probes = 0;
+static int s_restore_profile = WIFI_CONN_PS_BALANCED;
+static TaskHandle_t s_bench_task_handle = NULL;
+static volatile uint32_t s_seq = 0;
+
+void latency_bench_route_handler(const mqtt_comm_message_t *msg, void *ctx) {
+    char buf[12];
+    if (!s_bench_task_handle || msg->data_len == 0 || msg->data_len >= sizeof(buf)) {
+        return;
+    }
+    memcpy(buf, msg->data, msg->data_len);
+    buf[msg->data_len] = '\0';
+    if ((uint32_t)strtoul(buf, NULL, 10) == s_seq) {
+        xTaskNotify(s_bench_task_handle, s_seq, eSetValueWithOverwrite);
+    }
+}
+
+static void run_profile(wifi_conn_ps_profile_t profile) {
+    if (wifi_conn_set_ps_profile(profile) != ESP_OK) {
+        return;
+    }
+    vTaskDelay(pdMS_TO_TICKS(SETTLE_MS));
+
+    uint32_t received = 0;
+    int64_t min_us = INT64_MAX, max_us = 0, sum_us = 0;
+    for (uint32_t i = 0; i < s_probes; i++) {
+        while (!mqtt_comm_is_connected()) {
+            vTaskDelay(pdMS_TO_TICKS(1000));
+        }
+        char payload[12];
+        uint32_t seq = s_seq + 1;
+        int len = snprintf(payload, sizeof(payload), "%" PRIu32, seq);
+        xTaskNotifyStateClear(NULL);
+        s_seq = seq;
+        int64_t sent_us = esp_timer_get_time();
+        esp_err_t ret = mqtt_comm_publish_ex(s_topic, payload, len, 0, 0,
+                                             MQTT_COMM_PUB_FLAG_NO_BATCH | MQTT_COMM_PUB_FLAG_NO_COMPRESS |
+                                             MQTT_COMM_PUB_FLAG_NO_RATE_LIMIT | MQTT_COMM_PUB_FLAG_NO_DEDUP);
+        uint32_t echoed = 0;
+        if (ret == ESP_OK && xTaskNotifyWait(0, 0, &echoed, pdMS_TO_TICKS(PROBE_TIMEOUT_MS)) == pdTRUE && echoed == seq) {
+            int64_t rtt_us = esp_timer_get_time() - sent_us;
+            min_us = rtt_us < min_us ? rtt_us : min_us;
+            max_us = rtt_us > max_us ? rtt_us : max_us;
+            sum_us += rtt_us;
+            received++;
+        }
+        vTaskDelay(pdMS_TO_TICKS(PROBE_INTERVAL_MS));
+    }
+
+    if (received == 0) {
+        ESP_LOGW(TAG, "Profile %d: no probe came back (%" PRIu32 " sent)", profile, s_probes);
+        return;
+    }
+    ESP_LOGI(TAG, "Profile %d: RTT min %" PRId64 " / mean %" PRId64 " / max %" PRId64 " ms, %" PRIu32 " of %" PRIu32 " lost",
+             profile, min_us / 1000, sum_us / received / 1000, max_us / 1000, s_probes - received, s_probes);
+}
+
+static void latency_bench_task(void *pvParameters) {
+    const wifi_conn_ps_profile_t profiles[] = {
+        WIFI_CONN_PS_LOW_LATENCY, WIFI_CONN_PS_BALANCED, WIFI_CONN_PS_LOW_POWER,
+    };
+    ESP_LOGI(TAG, "Measuring round trips via '%s', %" PRIu32 " probes per profile", s_topic, s_probes);
+    for (size_t i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+        run_profile(profiles[i]);
+    }
+    wifi_conn_set_ps_profile((wifi_conn_ps_profile_t)s_restore_profile);
+    ESP_LOGI(TAG, "Benchmark finished.");
+    s_bench_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+esp_err_t latency_bench_start(const char *topic, uint32_t probes, int restore_profile) {
+    if (!topic || probes == 0 || strlen(topic) >= sizeof(s_topic)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_bench_task_handle) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    strlcpy(s_topic, topic, sizeof(s_topic));
+    s_probes = probes;
+    s_restore_profile = restore_profile;
+    if (xTaskCreate(latency_bench_task, "latency_bench", 3072, NULL, 5, &s_bench_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create benchmark task");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
\ No newline at end of file
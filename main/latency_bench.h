@@ -0,0 +1,30 @@
+// main/latency_bench.h
+#ifndef LATENCY_BENCH_H
+#define LATENCY_BENCH_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "mqtt_comm.h" // For mqtt_comm_message_t
+
+/**
+ * @brief Route handler for the benchmark topic; register it with the same
+ *        topic as passed to latency_bench_start().
+ */
+void latency_bench_route_handler(const mqtt_comm_message_t *msg, void *ctx);
+
+/**
+ * @brief Starts the round-trip benchmark in a background task.
+ *
+ * For each WiFi power-save profile, probes are published to `topic` and timed
+ * until they come back from the broker through the subscription. Results
+ * (min / mean / max / lost) are logged per profile, then the profile given in
+ * `restore_profile` is set again and the task ends.
+ *
+ * @param topic Loopback topic (copied), published and subscribed by this device.
+ * @param probes Probes per profile.
+ * @param restore_profile Profile (wifi_conn_ps_profile_t) to switch back to when done.
+ * @return esp_err_t ESP_OK if the task was started.
+ */
+esp_err_t latency_bench_start(const char *topic, uint32_t probes, int restore_profile);
+
+#endif // LATENCY_BENCH_H
\ No newline at end of file
@@ -1,144 +1,154 @@
 // main/led_handler.c
+// Non-blocking LED engine. A periodic esp_timer advances the current pattern
+// one frame at a time and drains the command queue without waiting, so no
+// sender is ever held up by an animation.
+//
+// Patterns are bit strings with one bit per frame (LED on/off). A steady
+// pattern (connection state) persists until the next state command; an
+// activity blink is played over it and the steady pattern resumes afterwards.
+// Activity is not queued: senders set bits in s_activity, which the timer
+// takes once per frame, so a burst of messages costs one blink.
+#include <stdint.h>
+#include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
 #include "freertos/queue.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 // Include local headers
 #include "led_handler.h" // Include own header
-#include "common_defs.h" // For APP_LED_GPIO, APP_LED_TASK_STACK, led_command_t
+#include "common_defs.h" // For APP_LED_GPIO, APP_LED_FRAME_MS, led_command_t
 
 // TAG updated for consistency (optional)
 static const char *TAG = "LED_HANDLER";
 
-// Task function to control the LED based on commands received via queue
-static void led_control_task(void *pvParameters)
-{
-    QueueHandle_t cmd_queue = (QueueHandle_t)pvParameters;
-    led_command_t received_cmd;
-    // Track logical *steady* state for restoring after blinks
-    uint8_t current_led_steady_state = LED_CMD_OFF;
+#define FRAMES(ms) ((ms) / APP_LED_FRAME_MS)
+// LED on for `ms` from `first`. Each use asserts that the run ends within the
+// 64 frames of `bits`, so neither shift below reaches 64.
+#define ON_RUN(ms, first) \
+    ((UINT64_MAX >> (64 - FRAMES(ms))) << FRAMES(first) \
+     | 0 * sizeof(struct { _Static_assert(FRAMES(ms) >= 1 && FRAMES(first) + FRAMES(ms) <= 64, \
+                                          "ON_RUN(" #ms ", " #first ") does not fit 64 frames"); int unused; }))
+
+typedef struct {
+    uint64_t bits;   // Bit i: LED on in frame i
+    uint8_t frames;  // Pattern length
+    bool repeat;     // Loop; otherwise the last frame's level holds
+} led_pattern_t;
+
+// Pattern lengths, each defined once and checked below
+#define WIFI_CONNECTING_FRAMES FRAMES(1000)
+#define WIFI_CONNECTED_FRAMES (FRAMES(1000) + 1)
+#define ERROR_FRAMES FRAMES(200)
+#define UART_RX_FRAMES FRAMES(400)
+#define MQTT_RX_FRAMES FRAMES(250)
+
+// Steady patterns (connection state)
+static const led_pattern_t PATTERN_OFF = { 0, 1, true };
+static const led_pattern_t PATTERN_ON = { 1, 1, true };
+static const led_pattern_t PATTERN_WIFI_CONNECTING = { ON_RUN(500, 0), WIFI_CONNECTING_FRAMES, true }; // Slow blink
+static const led_pattern_t PATTERN_WIFI_CONNECTED = { ON_RUN(1000, 0), WIFI_CONNECTED_FRAMES, false }; // On 1 s, then off (MQTT pending)
+static const led_pattern_t PATTERN_ERROR = { ON_RUN(100, 0), ERROR_FRAMES, true }; // Fast blink
+
+// Activity blinks, framed by a short gap so they also show on a solid LED
+static const led_pattern_t PATTERN_UART_RX = { ON_RUN(75, 50) | ON_RUN(75, 200), UART_RX_FRAMES, false }; // Double blink
+static const led_pattern_t PATTERN_MQTT_RX = { ON_RUN(150, 50), MQTT_RX_FRAMES, false }; // Single pulse
+
+// bits holds one frame per bit: a longer pattern (or a smaller APP_LED_FRAME_MS) would index past it
+_Static_assert(WIFI_CONNECTING_FRAMES <= 64, "PATTERN_WIFI_CONNECTING exceeds 64 frames");
+_Static_assert(WIFI_CONNECTED_FRAMES <= 64, "PATTERN_WIFI_CONNECTED exceeds 64 frames");
+_Static_assert(ERROR_FRAMES <= 64, "PATTERN_ERROR exceeds 64 frames");
+_Static_assert(UART_RX_FRAMES <= 64, "PATTERN_UART_RX exceeds 64 frames");
+_Static_assert(MQTT_RX_FRAMES <= 64, "PATTERN_MQTT_RX exceeds 64 frames");
+
+// Engine state, only touched in the esp_timer task
+static QueueHandle_t s_cmd_queue = NULL;
+static esp_timer_handle_t s_frame_timer = NULL;
+static const led_pattern_t *s_steady = &PATTERN_OFF;
+static uint32_t s_steady_frame = 0;
+static const led_pattern_t *s_blink = NULL;   // Activity blink being played
+static const led_pattern_t *s_next_blink = NULL; // Coalesced activity, played after s_blink
+static uint8_t s_blink_frame = 0;
+static int s_level = -1;
+
+static atomic_uint s_activity = 0; // led_activity_t bits set since the last frame
+
+static const led_pattern_t *steady_pattern(led_command_t cmd) {
+    switch (cmd) {
+        case LED_CMD_WIFI_CONNECTING: return &PATTERN_WIFI_CONNECTING;
+        case LED_CMD_WIFI_CONNECTED:  return &PATTERN_WIFI_CONNECTED;
+        case LED_CMD_MQTT_CONNECTED:  return &PATTERN_ON; // Fully operational
+        case LED_CMD_ERROR:           return &PATTERN_ERROR;
+        default:                      return &PATTERN_OFF;
+    }
+}
 
-    ESP_LOGI(TAG, "LED control task started (GPIO %d).", APP_LED_GPIO);
+void led_signal_activity(led_activity_t activity) {
+    atomic_fetch_or_explicit(&s_activity, (unsigned)activity, memory_order_relaxed);
+}
 
-    // Ensure LED is off initially
-    gpio_set_level(APP_LED_GPIO, 0);
+static void start_blink(const led_pattern_t *blink) {
+    if (!s_blink) {
+        s_blink = blink;
+        s_blink_frame = 0;
+    } else {
+        s_next_blink = blink; // Any amount of activity meanwhile is one more blink
+    }
+}
+
+static void handle_command(led_command_t cmd) {
+    ESP_LOGD(TAG, "Received LED command: %d", cmd);
+    const led_pattern_t *steady = steady_pattern(cmd);
+    if (steady != s_steady) {
+        s_steady = steady;
+        s_steady_frame = 0; // Same state again keeps the pattern running undisturbed
+    }
+}
+
+static bool pattern_level(const led_pattern_t *p, uint32_t frame) {
+    if (frame >= p->frames) {
+        frame = p->repeat ? frame % p->frames : p->frames - 1u;
+    }
+    return (p->bits >> frame) & 1;
+}
 
-    while (1)
-    {
-        // Wait indefinitely for a command
-        if (xQueueReceive(cmd_queue, &received_cmd, portMAX_DELAY))
-        {
-            ESP_LOGD(TAG, "Received LED command: %d", received_cmd);
-
-            // --- Execute LED Action/Animation ---
-
-            // Store previous steady state before potentially transient animations
-            bool was_steady_on = (current_led_steady_state == LED_CMD_MQTT_CONNECTED);
-
-            // Turn off LED before starting a new pattern (simplifies logic)
-            // Exception: If going from MQTT_CONNECTED to a blink, we handle restore later.
-            if (received_cmd != LED_CMD_UART_RX_RECEIVED && received_cmd != LED_CMD_MQTT_RX_RECEIVED) {
-                 gpio_set_level(APP_LED_GPIO, 0);
-            }
-
-
-            switch (received_cmd)
-            {
-                case LED_CMD_WIFI_CONNECTING:
-                    current_led_steady_state = received_cmd; // This is a persistent state until changed
-                    ESP_LOGD(TAG, "LED: WiFi Connecting - Slow Blink");
-                    // Simple blocking slow blink for indication
-                    // Note: This will block processing other commands for 1s
-                    gpio_set_level(APP_LED_GPIO, 1);
-                    vTaskDelay(pdMS_TO_TICKS(500));
-                    gpio_set_level(APP_LED_GPIO, 0);
-                    vTaskDelay(pdMS_TO_TICKS(500));
-                    // For continuous blinking, a non-blocking timer/state machine would be better
-                    break;
-
-                case LED_CMD_WIFI_CONNECTED:
-                    current_led_steady_state = received_cmd; // Persistent state
-                    ESP_LOGD(TAG, "LED: WiFi Connected - Solid ON briefly then OFF");
-                    // Solid ON briefly then off (indicates WiFi OK, MQTT pending)
-                    gpio_set_level(APP_LED_GPIO, 1);
-                    vTaskDelay(pdMS_TO_TICKS(1000)); // Show solid for 1 sec
-                    gpio_set_level(APP_LED_GPIO, 0);
-                     // The LED stays off after this indication, until MQTT connects or disconnects
-                    break;
-
-                case LED_CMD_MQTT_CONNECTED:
-                    current_led_steady_state = received_cmd; // Persistent state
-                    ESP_LOGD(TAG, "LED: MQTT Connected - Solid ON");
-                    gpio_set_level(APP_LED_GPIO, 1); // Solid ON for fully operational
-                    // Keep it ON - next state change (disconnect, error) will turn it off/change it
-                    break;
-
-                case LED_CMD_UART_RX_RECEIVED:
-                    // Fast double blink, then return to previous *steady* state
-                    ESP_LOGD(TAG, "LED: UART RX - Fast Double Blink");
-                    // Turn off if it was steady on, otherwise it's already off
-                    if (was_steady_on) gpio_set_level(APP_LED_GPIO, 0);
-                    vTaskDelay(pdMS_TO_TICKS(50)); // Small delay before blinking
-
-                    for (int i = 0; i < 2; i++) {
-                        gpio_set_level(APP_LED_GPIO, 1);
-                        vTaskDelay(pdMS_TO_TICKS(75)); // Slightly longer ON for visibility
-                        gpio_set_level(APP_LED_GPIO, 0);
-                        vTaskDelay(pdMS_TO_TICKS(75));
-                    }
-                    // Restore previous steady state
-                    if (was_steady_on) {
-                        vTaskDelay(pdMS_TO_TICKS(50)); // Small delay after blinking
-                        gpio_set_level(APP_LED_GPIO, 1); // Restore solid ON
-                    }
-                    break;
-
-                case LED_CMD_MQTT_RX_RECEIVED:
-                    // Quick single pulse, then return to previous *steady* state
-                    ESP_LOGD(TAG, "LED: MQTT RX - Quick Pulse");
-                    if (was_steady_on) gpio_set_level(APP_LED_GPIO, 0);
-                    vTaskDelay(pdMS_TO_TICKS(50));
-
-                    gpio_set_level(APP_LED_GPIO, 1);
-                    vTaskDelay(pdMS_TO_TICKS(150)); // Pulse duration
-                    gpio_set_level(APP_LED_GPIO, 0);
-
-                    // Restore previous steady state
-                    if (was_steady_on) {
-                         vTaskDelay(pdMS_TO_TICKS(50));
-                        gpio_set_level(APP_LED_GPIO, 1); // Restore solid ON
-                    }
-                    break;
-
-                case LED_CMD_ERROR: // Handle generic error state
-                    current_led_steady_state = received_cmd; // Persistent error state
-                    ESP_LOGD(TAG, "LED: Error State - Very Fast Blink");
-                     // Example: Fast continuous blink indicates error
-                     // Note: Like WIFI_CONNECTING, this is blocking. Consider timer for continuous.
-                    gpio_set_level(APP_LED_GPIO, 1);
-                    vTaskDelay(pdMS_TO_TICKS(100));
-                    gpio_set_level(APP_LED_GPIO, 0);
-                    vTaskDelay(pdMS_TO_TICKS(100));
-                    break;
-
-                case LED_CMD_OFF:
-                default:
-                    ESP_LOGD(TAG, "LED: Turning OFF");
-                    current_led_steady_state = LED_CMD_OFF; // Persistent state
-                    gpio_set_level(APP_LED_GPIO, 0); // Turn off explicitly
-                    break;
-            }
+static void frame_timer_cb(void *arg) {
+    led_command_t cmd;
+    while (xQueueReceive(s_cmd_queue, &cmd, 0) == pdTRUE) {
+        handle_command(cmd);
+    }
+    unsigned activity = atomic_exchange_explicit(&s_activity, 0, memory_order_relaxed);
+    if (activity & LED_ACTIVITY_UART_RX) {
+        start_blink(&PATTERN_UART_RX);
+    }
+    if (activity & LED_ACTIVITY_MQTT_RX) {
+        start_blink(&PATTERN_MQTT_RX);
+    }
+
+    bool on;
+    if (s_blink) {
+        on = pattern_level(s_blink, s_blink_frame);
+        if (++s_blink_frame >= s_blink->frames) {
+            s_blink = s_next_blink;
+            s_next_blink = NULL;
+            s_blink_frame = 0;
         }
-         // Add a small delay to prevent this task from hogging CPU if queue is spammed
-         // Only needed if the switch cases don't inherently have delays.
-         // vTaskDelay(pdMS_TO_TICKS(10));
+    } else {
+        on = pattern_level(s_steady, s_steady_frame);
+    }
+    if (s_steady_frame < UINT32_MAX) {
+        s_steady_frame++; // Steady pattern keeps its timing while a blink plays over it
+    }
+
+    if ((int)on != s_level) {
+        s_level = on;
+        gpio_set_level(APP_LED_GPIO, on);
     }
 }
 
-// Initialize LED GPIO and start the control task
-esp_err_t led_init_and_start_task(QueueHandle_t cmd_queue)
+// Initialize LED GPIO and start the frame timer
+esp_err_t led_init_and_start(QueueHandle_t cmd_queue)
 {
     if (cmd_queue == NULL) {
         ESP_LOGE(TAG, "Command queue handle is NULL");
@@ -163,21 +173,23 @@ esp_err_t led_init_and_start_task(QueueHandle_t cmd_queue)
 
     // Set initial level
     gpio_set_level(APP_LED_GPIO, 0);
+    s_level = 0;
+    s_cmd_queue = cmd_queue;
 
-    // Create the LED control task
-    BaseType_t task_created = xTaskCreate(led_control_task,
-                                          "led_control_task",   // Task name
-                                          APP_LED_TASK_STACK,   // Stack size from common_defs.h
-                                          (void *)cmd_queue,    // Pass queue handle as parameter
-                                          5,                    // Task priority
-                                          NULL);                // Task handle (optional)
-
-    if (task_created != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create LED control task");
+    const esp_timer_create_args_t timer_args = {
+        .callback = frame_timer_cb,
+        .name = "led_frame",
+    };
+    ret = esp_timer_create(&timer_args, &s_frame_timer);
+    if (ret == ESP_OK) {
+        ret = esp_timer_start_periodic(s_frame_timer, APP_LED_FRAME_MS * 1000);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start LED frame timer (%s)", esp_err_to_name(ret));
         // No GPIO cleanup needed here as gpio_config succeeded
-        return ESP_FAIL;
+        return ret;
     }
 
-    ESP_LOGI(TAG, "LED handler initialized and task started.");
+    ESP_LOGI(TAG, "LED handler initialized (%d ms frames).", APP_LED_FRAME_MS);
     return ESP_OK;
 }
\ No newline at end of file
@@ -6,12 +6,26 @@
 #include "common_defs.h" // For led_command_t and QueueHandle_t extern declaration
 
 /**
- * @brief Initialize the LED GPIO and start the LED control task.
+ * @brief Initialize the LED GPIO and start the LED engine.
  *
- * @param cmd_queue Handle to the queue used to send commands to the LED task.
+ * Patterns are played from a periodic esp_timer (APP_LED_FRAME_MS), which also
+ * drains the command queue without blocking. The queue carries connection
+ * state changes only; activity goes through led_signal_activity().
+ *
+ * @param cmd_queue Handle to the queue used to send commands to the LED engine.
  *                  This queue should be created in the main application.
  * @return esp_err_t ESP_OK on success, or an error code.
  */
-esp_err_t led_init_and_start_task(QueueHandle_t cmd_queue);
+esp_err_t led_init_and_start(QueueHandle_t cmd_queue);
+
+/**
+ * @brief Signals data activity for a blink; callable from any task at any rate.
+ *
+ * Only sets a bit with one relaxed atomic OR; the LED engine takes the bits
+ * each frame, so any number of signals within a blink shows as one more blink.
+ *
+ * @param activity One or more led_activity_t bits.
+ */
+void led_signal_activity(led_activity_t activity);
 
 #endif // LED_HANDLER_H
\ No newline at end of file
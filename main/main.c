@@ -13,16 +13,21 @@
 #include "esp_event.h"
 #include "esp_system.h"
 #include "esp_wifi.h" // Needed for MAC address
-#include "cJSON.h"    // For parsing UART data
 
 // Include component headers
 #include "uart_comm.h"
 #include "wifi_conn.h"
 #include "mqtt_comm.h"
+#include "conn_timing.h"
+#include "metrics.h"
+#include "dlog.h"
 
 // Include local headers
 #include "common_defs.h"
 #include "led_handler.h"
+#include "downlink_sched.h"
+#include "bridge_pipeline.h"
+#include "latency_bench.h"
 
 static const char *TAG = "MAIN_APP";
 
@@ -31,67 +36,20 @@ QueueHandle_t led_command_queue = NULL;
 
 // Buffer for device-specific MQTT subscription topic
 static char mqtt_sub_topic_str[64];
+static char bench_topic_str[64];
+static char metrics_topic_str[64];
+static char log_topic_str[64];
+static char nack_topic_str[64];
+static char metrics_buf[1024];
 static char mac_address_str[18] = {0};
 
 // --- Callback Implementations ---
 
-// Callback for UART data reception
+// Callback for UART data reception, runs in the UART RX task
 void app_uart_rx_callback(const uint8_t *data, size_t len) {
-    ESP_LOGI(TAG, "UART RX Callback: Received %d bytes", len);
-    led_command_t led_cmd = LED_CMD_UART_RX_RECEIVED;
-    xQueueSend(led_command_queue, &led_cmd, pdMS_TO_TICKS(10));
-
-    // Need mutable buffer for cJSON if it modifies input (it shouldn't for parse)
-    // Add null terminator for string parsing
-    char *json_string = malloc(len + 1);
-    if (!json_string) {
-        ESP_LOGE(TAG, "Failed to allocate buffer for JSON string");
-        return;
-    }
-    memcpy(json_string, data, len);
-    json_string[len] = '\0';
-
-    // --- Parse JSON ---
-    cJSON *root = cJSON_Parse((const char *)json_string);
-    if (root == NULL) {
-        ESP_LOGE(TAG, "Failed to parse JSON: %s", cJSON_GetErrorPtr());
-        const char *err_msg = "Error: Invalid JSON\r\n";
-        uart_comm_transmit((const uint8_t *)err_msg, strlen(err_msg));
-        free(json_string);
-        return;
-    }
-
-    cJSON *topic_item = cJSON_GetObjectItem(root, "topic");
-    cJSON *payload_item = cJSON_GetObjectItem(root, "payload");
-
-    if (!cJSON_IsString(topic_item) || !topic_item->valuestring ||
-        !cJSON_IsString(payload_item) || !payload_item->valuestring)
-    {
-        ESP_LOGE(TAG, "JSON format error: 'topic' or 'payload' missing/invalid.");
-        const char *err_msg = "Error: Missing/Invalid 'topic' or 'payload'\r\n";
-        uart_comm_transmit((const uint8_t *)err_msg, strlen(err_msg));
-    } else {
-        // Construct the full topic including the base
-        char full_topic[128]; // Adjust size as needed
-        snprintf(full_topic, sizeof(full_topic), "%s%s", APP_MQTT_PUB_BASE_TOPIC, topic_item->valuestring);
-
-        ESP_LOGI(TAG, "Parsed UART JSON - Topic: '%s', Payload: '%s'", full_topic, payload_item->valuestring);
-
-        // Publish using MQTT component's function
-        esp_err_t pub_ret = mqtt_comm_publish(full_topic, payload_item->valuestring, -1, 1, 0); // len=-1 for strlen
-        if (pub_ret == ESP_OK) {
-            ESP_LOGI(TAG, "Message queued for MQTT publish.");
-            const char *ok_msg = "OK: Sent to MQTT Queue\r\n";
-             uart_comm_transmit((const uint8_t *)ok_msg, strlen(ok_msg));
-        } else {
-             ESP_LOGE(TAG, "Failed to queue message for MQTT publish (Error: %s)", esp_err_to_name(pub_ret));
-            const char *fail_msg = "Error: Failed to send to MQTT\r\n";
-             uart_comm_transmit((const uint8_t *)fail_msg, strlen(fail_msg));
-        }
-    }
-
-    cJSON_Delete(root);
-    free(json_string);
+    ESP_LOGD(TAG, "UART RX Callback: Received %d bytes", len);
+    led_signal_activity(LED_ACTIVITY_UART_RX);
+    bridge_pipeline_on_uart_rx(data, len); // Parsed and published by the pipeline stages
 }
 
 // Callback for WiFi status changes
@@ -112,7 +70,7 @@ void app_wifi_status_callback(wifi_conn_status_t status, const esp_netif_ip_info
             ESP_LOGI(TAG, "WiFi Connected. IP: " IPSTR, IP2STR(&ip_info->ip));
             led_cmd = LED_CMD_WIFI_CONNECTED; // Indicate WiFi OK, MQTT state pending
             xQueueSend(led_command_queue, &led_cmd, pdMS_TO_TICKS(10));
-            // Note: MQTT client will start connecting automatically now
+            mqtt_comm_notify_network_up(); // Skip any pending reconnect backoff
             break;
         case WIFI_CONN_STATUS_CONNECTION_FAILED:
              ESP_LOGE(TAG, "WiFi Connection Failed Permanently (or max retries).");
@@ -145,17 +103,7 @@ void app_mqtt_status_callback(mqtt_conn_status_t status) {
             ESP_LOGI(TAG, "MQTT Connected.");
             led_cmd = LED_CMD_MQTT_CONNECTED;
             xQueueSend(led_command_queue, &led_cmd, pdMS_TO_TICKS(10));
-            // Subscribe to the device-specific topic
-             if (strlen(mqtt_sub_topic_str) > 0) {
-                 ESP_LOGI(TAG, "Subscribing to: %s", mqtt_sub_topic_str);
-                 esp_err_t sub_ret = mqtt_comm_subscribe(mqtt_sub_topic_str, 1);
-                 if (sub_ret != ESP_OK) {
-                     ESP_LOGE(TAG, "Failed to queue subscribe request for %s (Error: %s)", mqtt_sub_topic_str, esp_err_to_name(sub_ret));
-                 }
-             } else {
-                  ESP_LOGE(TAG, "Subscription topic not generated!");
-             }
-
+            // Subscriptions are restored by the mqtt_comm router on every connect
             break;
         case MQTT_CONN_STATUS_ERROR:
             ESP_LOGE(TAG, "MQTT Connection Error.");
@@ -170,34 +118,89 @@ void app_mqtt_status_callback(mqtt_conn_status_t status) {
     }
 }
 
-// Callback for MQTT received data
+// Route handler for the device-specific command topic: queues the payload for UART.
+// Runs in the MQTT task, so it never waits for the UART itself; only a QoS 1 message
+// over budget waits briefly for room, which delays its PUBACK (see downlink_sched.c).
+static void app_mqtt_command_handler(const mqtt_comm_message_t *msg, void *ctx) {
+    DLOGI(TAG, "Received data on subscribed topic (%d bytes, QoS %d).", (int)msg->data_len, msg->qos);
+    led_signal_activity(LED_ACTIVITY_MQTT_RX);
+
+    esp_err_t ret = downlink_sched_submit(msg);
+    if (ret != ESP_OK) {
+         ESP_LOGW(TAG, "MQTT data not forwarded to UART (Error: %s).", esp_err_to_name(ret));
+    }
+}
+
+// Callback for MQTT received data that matched no route
 void app_mqtt_data_callback(const char *topic, size_t topic_len, const char *data, size_t data_len) {
-    ESP_LOGI(TAG, "MQTT RX Callback: Topic='%.*s', Data='%.*s'", topic_len, topic, data_len, data);
-
-    led_command_t led_cmd = LED_CMD_MQTT_RX_RECEIVED;
-    xQueueSend(led_command_queue, &led_cmd, pdMS_TO_TICKS(10));
-
-    // Check if the topic matches our subscription
-    if (topic_len == strlen(mqtt_sub_topic_str) &&
-        strncmp(topic, mqtt_sub_topic_str, topic_len) == 0)
-    {
-        ESP_LOGI(TAG, "Received data on subscribed topic.");
-        // Format and send to UART
-        char tx_buffer[data_len + 32]; // Adjust buffer size as needed
-        int len = snprintf(tx_buffer, sizeof(tx_buffer), "MQTT Data: %.*s\r\n", data_len, data);
-        if (len > 0) {
-            esp_err_t uart_ret = uart_comm_transmit((const uint8_t *)tx_buffer, len);
-            if (uart_ret == ESP_OK) {
-                 ESP_LOGI(TAG, "Sent MQTT data to UART.");
-            } else {
-                 ESP_LOGE(TAG, "Failed to send MQTT data to UART.");
-            }
-        } else {
-             ESP_LOGE(TAG, "Failed to format MQTT data for UART TX");
+    ESP_LOGW(TAG, "Received data on unexpected topic: %.*s (%d bytes)", topic_len, topic, (int)data_len);
+}
+
+
+// --- Runtime Metrics ---
+
+// Heap levels, read at snapshot time. The uplink, downlink and rate limiter
+// counters are registered by their modules and counted where the events happen.
+static int32_t read_heap_free(void *ctx) {
+    return (int32_t)esp_get_free_heap_size();
+}
+
+static int32_t read_heap_min(void *ctx) {
+    return (int32_t)esp_get_minimum_free_heap_size();
+}
+
+static void app_metrics_register(void) {
+    metrics_gauge_fn("sys.heap_free", read_heap_free, NULL);
+    metrics_gauge_fn("sys.heap_min", read_heap_min, NULL);
+}
+
+// Publishes the metrics that changed since the last snapshot. A full snapshot
+// goes out periodically and after a reconnect or failed publish, so a consumer
+// that missed messages catches up. A snapshot larger than metrics_buf goes out
+// in several messages, back to back.
+static void app_metrics_publish(void) {
+    static uint32_t since_full = APP_METRICS_FULL_EVERY; // First snapshot is full
+    static bool was_connected = false;
+    bool connected = mqtt_comm_is_connected();
+    if (!connected) {
+        was_connected = false;
+        return; // Changes accumulate until the next connection
+    }
+    bool full = !was_connected || since_full >= APP_METRICS_FULL_EVERY;
+    was_connected = true;
+    since_full = full ? 1 : since_full + 1;
+    bool more;
+    do {
+        size_t len = metrics_serialize(metrics_buf, sizeof(metrics_buf), full, &more);
+        if (len == 0) {
+            return; // Nothing changed
         }
-    } else {
-        ESP_LOGW(TAG, "Received data on unexpected topic: %.*s", topic_len, topic);
+        full = false; // Further parts continue this snapshot
+        esp_err_t ret = mqtt_comm_publish_ex(metrics_topic_str, metrics_buf, (int)len, 0, 0,
+                                             MQTT_COMM_PUB_FLAG_NO_BATCH | MQTT_COMM_PUB_FLAG_NO_RATE_LIMIT);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Metrics publish failed (%s), next snapshot is full", esp_err_to_name(ret));
+            since_full = APP_METRICS_FULL_EVERY;
+            return;
+        }
+    } while (more);
+}
+
+// Deferred log sink for APP_DLOG_TO_MQTT: one QoS 0 message per line, the
+// console while MQTT is down
+static void app_dlog_mqtt_sink(const dlog_record_t *rec, void *ctx) {
+    char line[192];
+    if (!mqtt_comm_is_connected()) {
+        dlog_console_sink(rec, ctx);
+        return;
     }
+    int n = snprintf(line, sizeof(line), "%c %" PRIu32 " %s: ", "NEWIDV"[rec->level < 6 ? rec->level : 0],
+                     (uint32_t)(rec->time_us / 1000), rec->tag);
+    if (n < 0 || (size_t)n >= sizeof(line)) {
+        return;
+    }
+    size_t len = (size_t)n + dlog_format(rec, line + n, sizeof(line) - (size_t)n);
+    mqtt_comm_publish_ex(log_topic_str, line, (int)len, 0, 0, MQTT_COMM_PUB_FLAG_NO_RATE_LIMIT | MQTT_COMM_PUB_FLAG_NO_DEDUP);
 }
 
 
@@ -218,14 +221,9 @@ void app_main(void)
     ESP_LOGI(TAG, "[APP] Free memory: %" PRIu32 " bytes", esp_get_free_heap_size());
     ESP_LOGI(TAG, "[APP] IDF version: %s", esp_get_idf_version());
 
-    // Set log levels (optional)
+    // Set log levels. What is compiled in per component is chosen in menuconfig
+    // (CONFIG_*_LOG_LEVEL); hot paths log through the deferred logger (dlog.h).
     esp_log_level_set("*", ESP_LOG_INFO);
-    esp_log_level_set("MQTT_CLIENT", ESP_LOG_VERBOSE); // Log ESP-IDF MQTT client
-    esp_log_level_set("MQTT_COMM", ESP_LOG_VERBOSE);   // Log our MQTT component
-    esp_log_level_set("WIFI_CONN", ESP_LOG_VERBOSE);   // Log our WiFi component
-    esp_log_level_set("UART_COMM", ESP_LOG_VERBOSE);   // Log our UART component
-    esp_log_level_set("LED_HANDLER", ESP_LOG_VERBOSE); // Log LED handler
-    esp_log_level_set("MAIN_APP", ESP_LOG_INFO);
 
     // --- Initialize NVS ---
     esp_err_t ret = nvs_flash_init();
@@ -235,6 +233,18 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
 
+    // --- Start Deferred Logger, before any hot path runs ---
+    dlog_config_t dlog_config = {
+        .slots = APP_DLOG_SLOTS,
+        .task_priority = APP_DLOG_TASK_PRIO,
+        .task_core = APP_DLOG_TASK_CORE,
+        .flush_interval_ms = APP_DLOG_FLUSH_MS,
+        .sink = APP_DLOG_TO_MQTT ? app_dlog_mqtt_sink : NULL, // NULL: console
+    };
+    if (dlog_init(&dlog_config) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start deferred logger! Hot-path log messages are dropped.");
+    }
+
     // --- Initialize TCP/IP stack and default event loop ---
     // These are prerequisites for WiFi and MQTT components
     ESP_ERROR_CHECK(esp_netif_init());
@@ -251,7 +261,7 @@ void app_main(void)
 
     // --- Initialize LED Handler ---
     ESP_LOGI(TAG, "Initializing LED Handler...");
-    ret = led_init_and_start_task(led_command_queue);
+    ret = led_init_and_start(led_command_queue);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize LED handler! Continuing without LED indication.");
         // Continue execution if LED is non-critical
@@ -260,7 +270,22 @@ void app_main(void)
     // --- Initialize WiFi Component ---
     ESP_LOGI(TAG, "Initializing WiFi Component...");
     // WiFi init needs to happen before MQTT init and before getting MAC address
-    ret = wifi_conn_init_sta(APP_WIFI_SSID, APP_WIFI_PASS, app_wifi_status_callback);
+    static const wifi_conn_ap_t wifi_aps[] = {
+        { APP_WIFI_SSID, APP_WIFI_PASS, 0, WIFI_AUTH_WPA2_PSK },
+        APP_WIFI_EXTRA_APS
+    };
+    wifi_conn_config_t wifi_config = {
+        .aps = wifi_aps,
+        .ap_count = sizeof(wifi_aps) / sizeof(wifi_aps[0]),
+        .roam_rssi = APP_WIFI_ROAM_RSSI,
+        .roam_hysteresis_db = APP_WIFI_ROAM_HYSTERESIS_DB,
+        .fast_reconnect = APP_WIFI_FAST_RECONNECT,
+        .reuse_ip_lease = APP_WIFI_REUSE_IP_LEASE,
+        .ps_profile = APP_WIFI_PS_PROFILE,
+        .listen_interval = APP_WIFI_LISTEN_INTERVAL,
+        // .static_ip = { .ip.addr = ESP_IP4TOADDR(192, 168, 1, 50), ... } // Skips DHCP entirely
+    };
+    ret = wifi_conn_init_sta(&wifi_config, app_wifi_status_callback);
      if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize WiFi component! Halting.");
         // Cannot proceed without WiFi for MQTT
@@ -270,15 +295,71 @@ void app_main(void)
     // --- Prepare MQTT Subscription Topic ---
     get_mac_address_str(); // Get MAC after WiFi stack is initialized
     snprintf(mqtt_sub_topic_str, sizeof(mqtt_sub_topic_str), "%s%s", APP_MQTT_SUB_BASE_TOPIC, mac_address_str);
+    snprintf(bench_topic_str, sizeof(bench_topic_str), "%s%s", APP_LATENCY_BENCH_BASE_TOPIC, mac_address_str);
+    snprintf(metrics_topic_str, sizeof(metrics_topic_str), "%s/%s/stats", APP_METRICS_BASE_TOPIC, mac_address_str);
+    snprintf(log_topic_str, sizeof(log_topic_str), "%s/%s/log", APP_METRICS_BASE_TOPIC, mac_address_str);
+    snprintf(nack_topic_str, sizeof(nack_topic_str), "%s/%s/nack", APP_METRICS_BASE_TOPIC, mac_address_str);
 
 
+    // --- Initialize Downlink Scheduler (MQTT -> UART), before messages can arrive ---
+    downlink_sched_config_t downlink_config = {
+        .baud_rate = APP_UART_BAUD_RATE,
+        .max_latency_ms = APP_DOWNLINK_MAX_LATENCY_MS,
+        .policy = APP_DOWNLINK_POLICY,
+        .qos1_wait_ms = APP_DOWNLINK_QOS1_WAIT_MS,
+        .nack_topic = nack_topic_str,
+        .prefix = "MQTT Data: ",
+        .suffix = "\r\n",
+        .task_priority = APP_DOWNLINK_TASK_PRIO,
+        .task_core = APP_DOWNLINK_TASK_CORE,
+    };
+    ret = downlink_sched_init(&downlink_config);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize downlink scheduler! MQTT data will not reach UART.");
+    }
+
     // --- Initialize MQTT Component ---
     ESP_LOGI(TAG, "Initializing MQTT Component...");
+    const mqtt_comm_route_t mqtt_routes[] = {
+        { .filter = mqtt_sub_topic_str, .qos = 1, .handler = app_mqtt_command_handler }, // Device command topic
+#if APP_LATENCY_BENCH_PROBES > 0
+        { .filter = bench_topic_str, .qos = 0, .handler = latency_bench_route_handler }, // Probes echoed by the broker
+#endif
+    };
     mqtt_comm_config_t mqtt_config = {
         .broker_uri = APP_MQTT_BROKER_URI,
         // .client_id = APP_MQTT_CLIENT_ID,   // NULL uses default
         // .username = APP_MQTT_USERNAME,     // NULL for none
         // .password = APP_MQTT_PASSWORD      // NULL for none
+        .ca_cert_pem = APP_MQTT_CA_CERT_PEM,
+        .broker_discovery = APP_MQTT_BROKER_DISCOVERY,
+        .broker_cache_ttl_s = APP_MQTT_BROKER_CACHE_TTL_S,
+        .dedup = APP_MQTT_DEDUP,
+        .dedup_max_quiet_ms = APP_MQTT_DEDUP_MAX_QUIET_MS,
+        .rate_limit = {
+            .topic_rate = APP_MQTT_RATE_TOPIC,
+            .topic_burst = APP_MQTT_RATE_TOPIC_BURST,
+            .global_rate = APP_MQTT_RATE_GLOBAL,
+            .policy = APP_MQTT_RATE_POLICY,
+            .max_delay_ms = APP_MQTT_RATE_MAX_DELAY_MS,
+        },
+        .batch = {
+            .window_ms = APP_MQTT_BATCH_WINDOW_MS,
+            .max_bytes = APP_MQTT_BATCH_MAX_BYTES,
+            .format = MQTT_COMM_BATCH_FORMAT_NDJSON,
+        },
+        .compress_min_len = APP_MQTT_COMPRESS_MIN_LEN,
+        .protocol = APP_MQTT_PROTOCOL,
+        .topic_alias_max = APP_MQTT_TOPIC_ALIAS_MAX,
+        .message_expiry_s = APP_MQTT_MESSAGE_EXPIRY_S,
+        .routes = mqtt_routes,
+        .route_count = sizeof(mqtt_routes) / sizeof(mqtt_routes[0]),
+        .rx_mode = APP_MQTT_RX_MODE,
+        .receive_maximum = APP_MQTT_RECEIVE_MAXIMUM,
+        .persistent_session = APP_MQTT_PERSISTENT_SESSION,
+        .reconnect_base_ms = APP_MQTT_RECONNECT_BASE_MS,
+        .reconnect_max_ms = APP_MQTT_RECONNECT_MAX_MS,
+        .session_expiry_s = APP_MQTT_SESSION_EXPIRY_S,
     };
     ret = mqtt_comm_init(&mqtt_config, app_mqtt_status_callback, app_mqtt_data_callback);
      if (ret != ESP_OK) {
@@ -286,6 +367,20 @@ void app_main(void)
         // Decide if the application can continue without MQTT
     }
 
+    // --- Initialize Uplink Pipeline (UART -> MQTT), before UART data can arrive ---
+    bridge_pipeline_config_t pipeline_config = {
+        .pub_base_topic = APP_MQTT_PUB_BASE_TOPIC,
+        .max_chunk = APP_UART_RX_BUF_SIZE,
+        .ring_size = APP_PIPELINE_RING_SIZE,
+        .synchronous = APP_PIPELINE_SYNCHRONOUS,
+        .parse = { .priority = APP_PARSE_TASK_PRIO, .core = APP_PARSE_TASK_CORE },
+        .publish = { .priority = APP_PUBLISH_TASK_PRIO, .core = APP_PUBLISH_TASK_CORE },
+    };
+    ret = bridge_pipeline_init(&pipeline_config);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize uplink pipeline! UART data will not reach MQTT.");
+    }
+
     // --- Initialize UART Component ---
     ESP_LOGI(TAG, "Initializing UART Component...");
     uart_comm_config_t uart_config = {
@@ -295,7 +390,10 @@ void app_main(void)
         .baud_rate = APP_UART_BAUD_RATE,
         .rx_buffer_size = APP_UART_RX_BUF_SIZE,
         .tx_buffer_size = APP_UART_TX_BUF_SIZE,
-        .queue_size = APP_UART_QUEUE_SIZE
+        .queue_size = APP_UART_QUEUE_SIZE,
+        .tx_defer_size = APP_UART_TX_DEFER_SIZE,
+        .task_priority = APP_UART_TASK_PRIO,
+        .task_core = APP_UART_TASK_CORE,
     };
     ret = uart_comm_init(&uart_config, app_uart_rx_callback);
      if (ret != ESP_OK) {
@@ -303,13 +401,26 @@ void app_main(void)
         // Decide if the application can continue without UART
     }
 
+#if APP_LATENCY_BENCH_PROBES > 0
+    // Waits for MQTT by itself, then cycles through the power-save profiles
+    if (latency_bench_start(bench_topic_str, APP_LATENCY_BENCH_PROBES, APP_WIFI_PS_PROFILE) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start latency benchmark");
+    }
+#endif
+
     ESP_LOGI(TAG, "Main task finished initialization. Components running.");
 
     // Main task can now idle or perform other duties
+     int64_t last_attempt_us = -1;
+     app_metrics_register(); // Components registered theirs during init
      while(1) {
-         vTaskDelay(pdMS_TO_TICKS(30000)); // Check every 30 seconds
-         ESP_LOGI(TAG, "[APP] Free memory: %" PRIu32 " bytes", esp_get_free_heap_size());
-         ESP_LOGI(TAG, "[APP] MQTT Connected: %s", mqtt_comm_is_connected() ? "Yes" : "No");
-         ESP_LOGI(TAG, "[APP] WiFi Connected: %s", wifi_conn_is_connected() ? "Yes" : "No");
+         vTaskDelay(pdMS_TO_TICKS(APP_METRICS_INTERVAL_S * 1000));
+         app_metrics_publish(); // Replaces the periodic stats log lines
+         conn_timing_attempt_t attempt;
+         if (conn_timing_get(0, &attempt) == ESP_OK && attempt.start_us != last_attempt_us &&
+             CONN_TIMING_REACHED(&attempt, CONN_TIMING_MQTT_SUBACK)) {
+             last_attempt_us = attempt.start_us; // Only after a new (re)connect completed
+             conn_timing_log_summary();
+         }
      }
 }
\ No newline at end of file